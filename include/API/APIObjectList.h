@@ -123,6 +123,20 @@ class APIObjectList
 			
 			return object;
 		}
+		
+		// Single lookup, returns false instead of throwing when the object does not exist
+		bool Get(const std::string &name, APIObjectType *object)
+		{
+			std::unique_lock<std::mutex> llock(lock);
+			
+			auto it = objects_name.find(name);
+			if(it==objects_name.end())
+				return false;
+			
+			*object = *it->second;
+			
+			return true;
+		}
 };
 
 #endif
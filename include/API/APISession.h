@@ -60,6 +60,8 @@ class APISession
 		
 		std::queue<QueryResponse> responses;
 		
+		XMLMessage::en_encoding encoding = XMLMessage::ENCODING_XML;
+		
 		int s;
 		struct lws *wsi;
 		
@@ -22,6 +22,8 @@
 
 #include <DOM/DOMElement.h>
 #include <DOM/DOMDocument.h>
+#include <API/QueryResponseWriter.h>
+#include <API/XMLMessage.h>
 
 #include <string>
 
@@ -29,6 +31,8 @@
 
 class QueryResponse
 {
+	friend class QueryResponseWriter;
+	
 	int socket;
 	struct lws *wsi;
 	
@@ -39,8 +43,18 @@ class QueryResponse
 	bool status_ok;
 	std::string error;
 	std::string error_code;
+	
+	XMLMessage::en_encoding encoding = XMLMessage::ENCODING_XML;
+	
+	QueryResponseWriter *writer = 0;
+	bool streaming_enabled = false;
+	bool streaming_started = false;
 	 
 	 void init(const std::string &root_node_name);
+	 std::string stream_header();
+	 std::string stream_footer();
+	 void stream_chunk();
+	 bool send_all(const char *buf, size_t len);
 	
 	public:
 		QueryResponse(const std::string &root_node_name = "response");
@@ -52,6 +66,8 @@ class QueryResponse
 		
 		void SetSocket(int s) { this->socket = s; }
 		void SetWebsocket(struct lws *wsi) { this->wsi = wsi; }
+		void EnableStreaming(bool enable) { streaming_enabled = enable; }
+		void SetEncoding(XMLMessage::en_encoding encoding) { this->encoding = encoding; }
 		
 		DOMDocument *GetDOM() { return xmldoc; }
 		void SetError(const std::string &error);
@@ -62,6 +78,9 @@ class QueryResponse
 		DOMNode AppendText(const std::string &text);
 		DOMNode AppendXML(const std::string &xml, DOMElement node);
 		
+		QueryResponseWriter *Stream();
+		void Materialize();
+		
 		void Empty();
 		
 		void SendResponse();
@@ -0,0 +1,64 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _QUERYRESPONSEWRITER_H_
+#define _QUERYRESPONSEWRITER_H_
+
+#include <string>
+#include <vector>
+
+#define QUERYRESPONSEWRITER_CHUNK_SIZE 65536
+
+class QueryResponse;
+
+// Streams response elements straight to the output buffer, without building a DOM
+// Buffer is handed to the QueryResponse each time it grows over QUERYRESPONSEWRITER_CHUNK_SIZE
+class QueryResponseWriter
+{
+	friend class QueryResponse;
+	
+	QueryResponse *response;
+	
+	std::string buffer;
+	std::vector<std::string> elements;
+	bool tag_open = false;
+	bool attributes_open = false;
+	bool json;
+	
+	QueryResponseWriter(QueryResponse *response);
+	
+	public:
+		QueryResponseWriter(const QueryResponseWriter &w) = delete;
+		
+		void StartElement(const std::string &name);
+		void SetAttribute(const std::string &name, const std::string &value);
+		void AppendText(const std::string &text);
+		void EndElement();
+		
+		static void Escape(const std::string &str, std::string &out);
+	
+	private:
+		void close_tag();
+		void end_element();
+		void end_all();
+		void flush();
+};
+
+#endif
@@ -25,11 +25,23 @@
 
 #include <API/SocketSAX2Handler.h>
 
+#define XMLMESSAGE_JSON_MAXSIZE 67108864
+#define XMLMESSAGE_JSON_MAXSIZE_UNAUTHENTICATED 65536 // Challenge response is read before authentication
+
 class XMLMessage
 {
+	public:
+		enum en_encoding
+		{
+			ENCODING_XML,
+			ENCODING_JSON
+		};
+	
 	protected:
 		std::string context;
 		
+		en_encoding encoding = ENCODING_XML;
+		
 		std::map<std::string,std::string> root_attributes;
 		
 		DOMDocument *xmldoc;
@@ -38,11 +50,12 @@ class XMLMessage
 		void init();
 	
 	public:
-		XMLMessage(const std::string &context, int s);
+		XMLMessage(const std::string &context, int s, size_t max_size = XMLMESSAGE_JSON_MAXSIZE);
 		XMLMessage(const std::string &context, const std::string &xml);
 		~XMLMessage();
 		
 		DOMDocument *GetDOM() { return xmldoc; }
+		en_encoding GetEncoding() { return encoding; }
 		
 		const std::map<std::string,std::string> &GetRootAttributes() { return root_attributes; }
 		
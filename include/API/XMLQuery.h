@@ -30,7 +30,7 @@ class XMLQuery:public XMLMessage
 	WorkflowParameters *parameters = 0;
 	
 	public:
-		XMLQuery(const std::string &context, int s);
+		XMLQuery(const std::string &context, int s, size_t max_size = XMLMESSAGE_JSON_MAXSIZE);
 		XMLQuery(const std::string &context, const std::string &xml);
 		~XMLQuery();
 		
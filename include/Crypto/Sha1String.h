@@ -32,6 +32,8 @@ class Sha1String
 		Sha1String();
 		Sha1String(const std::string &str);
 		
+		void Reset();
+		
 		void ProcessBytes(const std::string &str);
 		void ProcessBytes(void *bytes, int length);
 		
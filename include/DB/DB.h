@@ -61,9 +61,19 @@ class DB
 		std::string table;
 		std::string columns;
 		int ncolumns;
+		std::string on_duplicate;
 		std::vector<st_bulk_value> values;
 	};
 	
+	// Rows of a bulk query being streamed to LOAD DATA LOCAL INFILE
+	struct st_bulk_load
+	{
+		const st_bulk_query *query;
+		size_t value;
+		std::string buf;
+		size_t buf_pos;
+	};
+	
 	std::map<int, st_bulk_query> bulk_queries;
 	
 	MYSQL *mysql;
@@ -73,6 +83,7 @@ class DB
 	
 	bool transaction_started;
 	bool auto_rollback = true;
+	bool local_infile = false;
 	
 	bool is_connected;
 	bool is_copy;
@@ -106,12 +117,14 @@ public:
 	int InsertID(void);
 	long long InsertIDLong(void);
 	
-	void BulkStart(int bulk_id, const std::string &table, const std::string &columns, int ncolumns);
+	void BulkStart(int bulk_id, const std::string &table, const std::string &columns, int ncolumns, const std::string &on_duplicate = "");
 	void BulkDataNULL(int bulk_id);
 	void BulkDataInt(int bulk_id, int i);
 	void BulkDataLong(int bulk_id, long long ll);
 	void BulkDataString(int bulk_id, const std::string &s);
 	void BulkExec(int bulk_id);
+	void EnableLocalInfile(void);
+	void BulkLoad(int bulk_id);
 	
 	bool FetchRow(void);
 	void Seek(int offset);
@@ -138,6 +151,11 @@ public:
 private:
 	void connect();
 	std::string get_query_value(char type, int idx, const std::vector<const void *> &args); 
+	
+	static int infile_init(void **ptr, const char *filename, void *userdata);
+	static int infile_read(void *ptr, char *buf, unsigned int buf_len);
+	static void infile_end(void *ptr);
+	static int infile_error(void *ptr, char *error_msg, unsigned int error_msg_len);
 };
 
 #endif
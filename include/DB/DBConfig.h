@@ -47,6 +47,7 @@ class DBConfig
 		std::vector<t_db_handler_init> init;
 		std::map<std::string, std::map<std::string, std::string>> tables;
 		std::map<std::string, std::map<std::string, std::string>> tables_init;
+		std::map<std::string, std::map<std::string, std::string>> indexes;
 		
 		static DBConfig *instance;
 	
@@ -66,6 +67,7 @@ class DBConfig
 		bool RegisterInit(t_db_handler_init init);
 		bool RegisterTables(const std::string &name, std::map<std::string, std::string> &tables_def);
 		bool RegisterTablesInit(const std::string &name, std::map<std::string, std::string> &tables_query);
+		bool RegisterIndexes(const std::string &name, std::map<std::string, std::string> &indexes_def);
 		void InitTables();
 };
 
@@ -0,0 +1,50 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _DOMBACKEND_H_
+#define _DOMBACKEND_H_
+
+// DOM implementation used by the wrapper classes, selected at build time (USENATIVEDOM)
+
+#ifdef USE_NATIVE_DOM
+
+#include <DOM/NativeDOM.h>
+
+typedef NativeNode dom_node_t;
+typedef NativeElement dom_element_t;
+typedef NativeAttr dom_attr_t;
+typedef NativeText dom_text_t;
+typedef NativeDocument dom_document_t;
+typedef NativeElement dom_named_node_map_t;
+
+#else
+
+#include <xercesc/dom/DOM.hpp>
+
+typedef xercesc::DOMNode dom_node_t;
+typedef xercesc::DOMElement dom_element_t;
+typedef xercesc::DOMAttr dom_attr_t;
+typedef xercesc::DOMText dom_text_t;
+typedef xercesc::DOMDocument dom_document_t;
+typedef xercesc::DOMNamedNodeMap dom_named_node_map_t;
+
+#endif
+
+#endif
@@ -20,9 +20,7 @@
 #ifndef _DOMDOCUMENT_H_
 #define _DOMDOCUMENT_H_
 
-#include <xercesc/dom/DOM.hpp>
-#include <xercesc/dom/DOMErrorHandler.hpp>
-#include <xercesc/dom/DOMError.hpp>
+#include <DOM/DOMBackend.h>
 
 #include <DOM/DOMXPathResult.h>
 #include <DOM/DOMElement.h>
@@ -31,26 +29,57 @@
 
 #include <string>
 #include <map>
+#include <set>
+#include <vector>
+#include <unordered_map>
+#include <memory>
 
 class DOMDocument:public DOMNode
 {
+	friend class DOMNode;
+	friend class DOMElement;
+	
+	// Secondary index on (element name, attribute name), values are mapped to elements
+	// Built on first lookup, then attribute updates and inserted or removed subtrees are applied to it
+	struct st_index
+	{
+		bool built = false;
+		std::unordered_map<std::string,std::set<dom_element_t *>> values;
+	};
+	
+	// Attribute template segment, literal text or XPath expression (between braces)
+	struct st_attribute_segment
+	{
+		std::string text;
+		std::shared_ptr<TokenExpr> expr;
+	};
+	
 private:
-	xercesc::DOMDocument *xmldoc;
+	dom_document_t *xmldoc;
+#ifndef USE_NATIVE_DOM
 	xercesc::DOMLSParser *parser;
-	xercesc::DOMLSSerializer *serializer;
+#endif
 	DOMXPath *xpath;
 	
 	std::map<int,DOMElement> id_node;
 	int current_id = -1;
 	
+	mutable size_t serialize_size_hint = 0;
+	
+	std::map<std::string,std::vector<st_attribute_segment>> attribute_templates;
+	
+	std::map<std::pair<std::string,std::string>,st_index> indexes;
+	std::multimap<std::string,std::string> indexed_attributes;
+	
 public:
 	DOMDocument(void);
-	DOMDocument(xercesc::DOMDocument *xmldoc);
+	DOMDocument(dom_document_t *xmldoc);
 	~DOMDocument(void);
 	
 	static DOMDocument *Parse(const std::string &xml_str);
 	static DOMDocument *ParseFile(const std::string &filename);
 	std::string Serialize(DOMNode node) const;
+	void Serialize(DOMNode node,std::string &output) const;
 	std::string ExpandXPathAttribute(const std::string &attribute,DOMNode context_node);
 	
 	DOMElement getDocumentElement() const;
@@ -66,8 +95,21 @@ public:
 	
 	void ImportXPathResult(DOMXPathResult *res, DOMNode node);
 	
+	void RegisterIndex(const std::string &element_name,const std::string &attribute_name);
+	bool HasIndex(const std::string &element_name,const std::string &attribute_name) const;
+	bool LookupIndex(const std::string &element_name,const std::string &attribute_name,const std::string &value,std::vector<DOMElement> &result);
+	
 private:
 	void initialize_evqid();
+	
+	std::vector<st_attribute_segment> compile_attribute(const std::string &attribute);
+	DOMXPathResult *evaluate(const st_attribute_segment &segment,DOMNode node,DOMXPathResult::ResultType result_type);
+	
+	static DOMDocument *get_document(dom_node_t *node);
+	bool is_attached(dom_node_t *node) const;
+	void build_index(const std::string &element_name,const std::string &attribute_name,st_index &index);
+	void index_attribute(dom_element_t *element,const std::string &name,const std::string *value);
+	void index_subtree(dom_node_t *parent,dom_node_t *child,bool add);
 };
 
 #endif
@@ -20,18 +20,18 @@
 #ifndef _DOMELEMENT_H_
 #define _DOMELEMENT_H_
 
-#include <xercesc/dom/DOM.hpp>
+#include <DOM/DOMBackend.h>
 #include <DOM/DOMNode.h>
 
 #include <string>
 
 class DOMElement:public DOMNode
 {
-	xercesc::DOMElement *element;
+	dom_element_t *element;
 	
 public:
 	DOMElement();
-	DOMElement(xercesc::DOMElement *element);
+	DOMElement(dom_element_t *element);
 	DOMElement(DOMNode node);
 	
 	bool hasAttribute(const std::string &name) const;
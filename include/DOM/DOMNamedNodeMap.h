@@ -20,7 +20,7 @@
 #ifndef _DOMNAMEDNODEMAP_H_
 #define _DOMNAMEDNODEMAP_H_
 
-#include <xercesc/dom/DOM.hpp>
+#include <DOM/DOMBackend.h>
 
 #include <string>
 
@@ -28,10 +28,10 @@ class DOMNode;
 
 class DOMNamedNodeMap
 {
-	xercesc::DOMNamedNodeMap *map;
+	dom_named_node_map_t *map;
 	
 public:
-	DOMNamedNodeMap(xercesc::DOMNamedNodeMap *map);
+	DOMNamedNodeMap(dom_named_node_map_t *map);
 	
 	int getLength() const;
 	DOMNode item(int index);
@@ -20,7 +20,7 @@
 #ifndef _DOMNODE_H_
 #define _DOMNODE_H_
 
-#include <xercesc/dom/DOM.hpp>
+#include <DOM/DOMBackend.h>
 
 #include <string>
 
@@ -32,7 +32,7 @@ class DOMNode
 	friend class DOMDocument;
 	friend class DOMElement;
 	
-	xercesc::DOMNode *node;
+	dom_node_t *node;
 	
 public:
 	enum NodeType {
@@ -51,7 +51,7 @@ public:
 	};
 	
 	DOMNode();
-	DOMNode(xercesc::DOMNode *node);
+	DOMNode(dom_node_t *node);
 	
 	DOMNode cloneNode(bool deep);
 	
@@ -73,6 +73,9 @@ public:
 	DOMNamedNodeMap getAttributes();
 	DOMElement getOwnerElement();
 	
+	bool isSameNode(DOMNode other) const;
+	bool operator<(const DOMNode &other) const { return node<other.node; } // Arbitrary order, to use nodes as map keys
+	
 	operator bool() const;
 };
 
@@ -0,0 +1,39 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _DOMSERIALIZER_H_
+#define _DOMSERIALIZER_H_
+
+#include <DOM/DOMNode.h>
+
+#include <string>
+
+// Direct UTF-8 serializer, output is the same as xerces DOMLSSerializer (without XML declaration)
+class DOMSerializer
+{
+	static size_t find_escape(const char *str,size_t length,bool attribute);
+	static void escape(const std::string &str,bool attribute,std::string &output);
+	static void serialize(DOMNode node,std::string &output);
+	
+	public:
+		static void Serialize(DOMNode node,std::string &output);
+};
+
+#endif
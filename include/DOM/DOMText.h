@@ -20,18 +20,18 @@
 #ifndef _DOMTEXT_H_
 #define _DOMTEXT_H_
 
-#include <xercesc/dom/DOM.hpp>
+#include <DOM/DOMBackend.h>
 #include <DOM/DOMNode.h>
 
 #include <string>
 
 class DOMText:public DOMNode
 {
-	xercesc::DOMText *text;
+	dom_text_t *text;
 	
 public:
 	DOMText();
-	DOMText(xercesc::DOMText *text);
+	DOMText(dom_text_t *text);
 	
 	void appendData(const std::string str);
 };
@@ -32,12 +32,16 @@ class DOMXPath
 	DOMDocument *xmldoc;
 	XPathEval eval;
 	
+	DOMXPathResult *make_result(Token *result,DOMXPathResult::ResultType result_type);
+	
 public:
 	DOMXPath(DOMDocument *xmldoc);
 	
-	void RegisterFunction(std::string name,XPathEval::func_desc f);
+	void SetCustomContext(void *custom_context);
 	
+	TokenExpr *compile(const std::string &xpath);
 	DOMXPathResult *evaluate(const std::string &xpath,DOMNode node,DOMXPathResult::ResultType result_type);
+	DOMXPathResult *evaluate(const TokenExpr *expr,DOMNode node,DOMXPathResult::ResultType result_type);
 };
 
 #endif
\ No newline at end of file
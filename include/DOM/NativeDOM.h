@@ -0,0 +1,164 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _NATIVEDOM_H_
+#define _NATIVEDOM_H_
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+class DOMDocument;
+class NativeDocument;
+class NativeElement;
+
+// Compact UTF-8 DOM, used instead of xerces DOM when built with USENATIVEDOM
+// Navigation methods use xerces names so that backend independent code can be shared
+class NativeNode
+{
+	friend class NativeDocument;
+	friend class NativeElement;
+	
+	protected:
+		short type;
+		NativeDocument *doc;
+		NativeNode *parent = 0;
+		NativeNode *first_child = 0;
+		NativeNode *last_child = 0;
+		NativeNode *prev = 0;
+		NativeNode *next = 0;
+		
+		NativeNode(short type,NativeDocument *doc);
+		
+		void unlink();
+		void link(NativeNode *child,NativeNode *ref);
+		
+	public:
+		NativeNode(const NativeNode &node) = delete;
+		virtual ~NativeNode();
+		
+		short getNodeType() const { return type; }
+		NativeDocument *getOwnerDocument() const;
+		NativeNode *getParentNode() const { return parent; }
+		NativeNode *getFirstChild() const { return first_child; }
+		NativeNode *getLastChild() const { return last_child; }
+		NativeNode *getPreviousSibling() const { return prev; }
+		NativeNode *getNextSibling() const { return next; }
+		
+		const std::string &getNodeName() const;
+		std::string getNodeValue() const;
+		std::string getTextContent() const;
+		void setTextContent(const std::string &text);
+		
+		NativeNode *appendChild(NativeNode *child);
+		NativeNode *insertBefore(NativeNode *child,NativeNode *ref);
+		NativeNode *removeChild(NativeNode *child);
+		NativeNode *replaceChild(NativeNode *child,NativeNode *old_child);
+		NativeNode *cloneNode(bool deep) const;
+		
+		void release();
+};
+
+class NativeAttr:public NativeNode
+{
+	friend class NativeNode;
+	friend class NativeElement;
+	friend class NativeDocument;
+	
+	const std::string *name;
+	std::string value;
+	NativeElement *owner;
+	
+	NativeAttr(NativeDocument *doc,const std::string *name,const std::string &value,NativeElement *owner);
+	
+	public:
+		NativeElement *getOwnerElement() const { return owner; }
+};
+
+class NativeElement:public NativeNode
+{
+	friend class NativeNode;
+	friend class NativeDocument;
+	
+	const std::string *name;
+	std::vector<NativeAttr *> attributes;
+	
+	NativeElement(NativeDocument *doc,const std::string *name);
+	
+	NativeAttr *find_attribute(const std::string &name) const;
+	
+	public:
+		~NativeElement();
+		
+		bool hasAttribute(const std::string &name) const;
+		const std::string &getAttribute(const std::string &name) const;
+		NativeAttr *getAttributeNode(const std::string &name) const;
+		void setAttribute(const std::string &name,const std::string &value);
+		void removeAttribute(const std::string &name);
+		
+		// Named node map interface
+		int getLength() const { return attributes.size(); }
+		NativeAttr *item(int index) const { return index<attributes.size()?attributes[index]:0; }
+};
+
+// Text, CDATA section or comment
+class NativeText:public NativeNode
+{
+	friend class NativeNode;
+	friend class NativeDocument;
+	
+	std::string data;
+	
+	NativeText(NativeDocument *doc,short type,const std::string &data);
+	
+	public:
+		const std::string &getData() const { return data; }
+		void appendData(const std::string &str) { data += str; }
+};
+
+class NativeDocument:public NativeNode
+{
+	friend class NativeNode;
+	friend class NativeElement;
+	
+	std::unordered_set<std::string> names;
+	std::unordered_set<NativeNode *> detached;
+	
+	void adopt(NativeNode *node);
+	
+	public:
+		DOMDocument *wrapper = 0;
+		
+		NativeDocument();
+		~NativeDocument();
+		
+		static NativeDocument *Parse(const std::string &xml_str);
+		static NativeDocument *ParseFile(const std::string &filename);
+		
+		const std::string *Intern(const std::string &name);
+		
+		NativeElement *getDocumentElement() const;
+		NativeElement *createElement(const std::string &name);
+		NativeText *createTextNode(const std::string &data);
+		NativeText *createNode(short type,const std::string &data);
+		NativeNode *importNode(const NativeNode *node,bool deep);
+};
+
+#endif
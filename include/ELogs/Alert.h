@@ -22,6 +22,7 @@
 
 #include <string>
 #include <vector>
+#include <map>
 
 #include <nlohmann/json.hpp>
 
@@ -60,6 +61,7 @@ class Alert
 		unsigned int GetPeriod() const { return period; }
 		const std::string &GetFilters() const { return filters; }
 		const nlohmann::json &GetJsonFilters() const { return json_filters; }
+		std::map<std::string, std::string> GetFiltersMap() const;
 		std::vector<unsigned int> GetNotifications() const { return notifications; }
 		bool GetIsGroupped() const { return is_groupped; }
 		std::string GetGroupby() const { return groupby; }
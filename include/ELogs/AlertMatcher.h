@@ -0,0 +1,97 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _ALERTMATCHER_H_
+#define _ALERTMATCHER_H_
+
+#include <ELogs/Alert.h>
+#include <ELogs/Field.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <mutex>
+
+#include <nlohmann/json.hpp>
+
+#define ALERTMATCHER_MAX_LOGS  1000
+
+namespace ELogs
+{
+
+class Channel;
+
+// Compiled form of an alert, evaluated by log storage on each stored log line
+class AlertMatcher
+{
+	struct st_filter
+	{
+		bool is_group;
+		Field field;
+		std::string value_str;
+		int value_int;
+		bool is_prefix;
+	};
+	
+	// Sliding window of matched logs, one per groupby value
+	struct st_window
+	{
+		std::deque<std::pair<time_t, unsigned int>> minutes; // Non empty minutes, oldest first
+		unsigned int count = 0;
+		std::deque<std::pair<time_t, nlohmann::json>> logs; // Only filled for non groupped alerts
+		time_t muted_until = 0;
+	};
+	
+	Alert alert;
+	
+	int filter_crit = -1;
+	unsigned int filter_group = 0;
+	unsigned int filter_channel = 0;
+	std::vector<st_filter> filters;
+	std::string groupby;
+	
+	std::mutex windows_lock; // Filters are immutable, only windows are guarded
+	std::map<std::string, st_window> windows;
+	
+	public:
+		AlertMatcher(const Alert &alert);
+		
+		const Alert &GetAlert() const { return alert; }
+		bool IsSameDefinition(const Alert &alert) const;
+		
+		bool Match(unsigned long long log_id, const Channel &channel, const std::map<std::string, std::string> &group_fields, const std::map<std::string, std::string> &channel_fields, time_t now, nlohmann::json &j_logs);
+		void Mute(const std::string &key, time_t until);
+		void Expire(time_t now);
+	
+	private:
+		bool match_value(const st_filter &filter, const std::string &value) const;
+		std::string get_groupby_value(const Channel &channel, const std::map<std::string, std::string> &group_fields, const std::map<std::string, std::string> &channel_fields) const;
+		nlohmann::json get_log(unsigned long long log_id, const Channel &channel, const std::map<std::string, std::string> &group_fields, const std::map<std::string, std::string> &channel_fields) const;
+		void expire_window(st_window &window, time_t minute) const;
+		
+		static std::string normalize(const Field &field, const std::string &value);
+		static bool iequals(const std::string &a, const std::string &b, size_t len = std::string::npos);
+		static time_t parse_date(const std::string &date);
+};
+
+}
+
+#endif
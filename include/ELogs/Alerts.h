@@ -27,8 +27,12 @@
 
 #include <map>
 #include <string>
+#include <vector>
 #include <condition_variable>
 #include <thread>
+#include <memory>
+
+#include <nlohmann/json.hpp>
 
 class User;
 class XMLQuery;
@@ -37,10 +41,31 @@ class QueryResponse;
 namespace ELogs
 {
 
+class AlertMatcher;
+class Channel;
+
 class Alerts:public APIObjectList<Alert>, public APIAutoInit, public WaiterThread
 {
 	static Alerts *instance;
 	
+	struct st_trigger
+	{
+		Alert alert;
+		std::string key;
+		nlohmann::json logs;
+	};
+	
+	typedef std::map<unsigned int, std::shared_ptr<AlertMatcher>> t_matchers;
+	
+	bool is_streaming;
+	
+	// Matchers are read by every log storage worker, so they are published as an immutable snapshot swapped on reload
+	std::mutex matchers_lock;
+	std::shared_ptr<const t_matchers> matchers;
+	
+	std::mutex triggers_lock;
+	std::vector<st_trigger> triggers;
+	
 	public:
 		
 		Alerts();
@@ -56,9 +81,19 @@ class Alerts:public APIObjectList<Alert>, public APIAutoInit, public WaiterThrea
 		static void HandleReload(bool notify);
 		
 		static void HandleNotificationTypeDelete(unsigned int id);
+		
+		void Match(unsigned long long log_id, const Channel &channel, const std::map<std::string, std::string> &group_fields, const std::map<std::string, std::string> &channel_fields);
 	
 	private:
 		void main();
+		
+		std::shared_ptr<const t_matchers> get_matchers();
+		void reload_matchers(const std::vector<Alert> &alert_objs);
+		void process_triggers();
+		void check_sql_alerts(unsigned int timer);
+		void trigger(const Alert &alert, const nlohmann::json &j_logs);
+		
+		static std::string get_trigger_action(const Alert &alert, const std::string &key);
 };
 
 }
@@ -23,8 +23,6 @@
 class XMLQuery;
 class QueryResponse;
 class User;
-class DOMElement;
-class DB;
 
 #include <string>
 
@@ -35,9 +33,6 @@ class Fields;
 
 class ELog
 {
-	private:
-		static void query_fields(DB *db, unsigned long long id, const Fields &fields, DOMElement &node);
-	
 	public:
 		static bool HandleQuery(const User &user, XMLQuery *query, QueryResponse *response);
 		
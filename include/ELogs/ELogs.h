@@ -32,15 +32,21 @@ namespace ELogs
 {
 
 class Fields;
+struct LogQuery;
 
 class ELogs
 {
 	static std::string get_filter(const std::map<std::string, std::string> &filters, const std::string &name, const std::string &default_val);
 	static int get_filter(const std::map<std::string, std::string> &filters, const std::string &name,int default_val);
-	static void add_auto_filters(const std::map<std::string, std::string> filters, const Fields &fields, const std::string &prefix, std::string &query_where, std::vector<const void *> &values, int *val_int, std::string *val_str);
+	static void get_field_filters(const std::map<std::string, std::string> &filters, const Fields &fields, const std::string &prefix, std::map<std::string, std::string> &field_filters);
+	
+	static LogQuery build_query(const std::map<std::string, std::string> &filters);
+	static std::vector<std::map<std::string, std::string>> query_logs(const LogQuery &query, unsigned int limit, unsigned int offset);
+	static std::vector<std::map<std::string, std::string>> query_logs_cached(const std::map<std::string, std::string> &filters, unsigned int limit, unsigned int offset);
 	
 	public:
 		static std::vector<std::map<std::string, std::string>> QueryLogs(std::map<std::string, std::string> filters, unsigned int limit, unsigned int offset = 0);
+		static unsigned long long CountLogs(std::map<std::string, std::string> filters);
 		
 		static bool HandleQuery(const User &user, XMLQuery *query, QueryResponse *response);
 };
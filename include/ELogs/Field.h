@@ -54,6 +54,7 @@ class Field
 	public:
 		Field();
 		Field(unsigned int id);
+		Field(unsigned int id, const std::string &name, en_type type);
 		Field(const Field &f);
 		
 		unsigned int GetID() const { return id; }
@@ -22,6 +22,7 @@
 
 #include <string>
 #include <map>
+#include <memory>
 
 #include <ELogs/Field.h>
 
@@ -36,6 +37,8 @@ class DOMElement;
 namespace ELogs
 {
 
+class FieldsPlan;
+
 class Fields
 {
 	public:
@@ -54,11 +57,15 @@ class Fields
 		std::map<unsigned int, Field> id_fields;
 		std::map<std::string, Field> name_fields;
 		
+		// Shared by copies, a reload builds new Fields and so a new plan
+		std::shared_ptr<const FieldsPlan> plan;
+		
 	public:
 		Fields(en_type type, unsigned int id);
 		
 		const std::map<unsigned int, Field> &GetIDMap() const { return id_fields; }
 		const std::map<std::string, Field> &GetNameMap() const { return name_fields; }
+		const FieldsPlan &GetPlan() const { return *plan; }
 		
 		const Field &Get(const std::string &name) const;
 		bool Exists(const std::string &name) const;
@@ -0,0 +1,91 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#ifndef _FIELDSPLAN_H_
+#define _FIELDSPLAN_H_
+
+#include <ELogs/Field.h>
+#include <Crypto/Sha1String.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace ELogs
+{
+
+// Fields compiled when channels are loaded, so logs are packed and filtered without dispatching on types for each value
+class FieldsPlan
+{
+	public:
+		// Packing state reused across values by a storage worker
+		struct st_context
+		{
+			Sha1String sha1;
+		};
+		
+		struct st_packed
+		{
+			int val_int;
+			std::string val_str;
+			std::string sha1; // ITEXT only, hash of the whole value
+		};
+		
+		struct st_field
+		{
+			Field field;
+			unsigned int id;
+			std::string name;
+			Field::en_type type;
+			
+			int bulk_id; // Bulk buffer of the values table
+			bool is_int; // Packed value is val_int, val_str otherwise
+			
+			// Prepared WHERE fragments on the values table joined as v<id>
+			std::string filter_equal;
+			std::string filter_prefix; // CHAR only
+			
+			void (*pack)(const std::string &value, st_context &context, st_packed &packed);
+		};
+	
+	private:
+		std::vector<st_field> fields;
+		std::map<std::string, size_t> names;
+		std::vector<const st_field *> pack_fields;
+	
+	public:
+		FieldsPlan(const std::map<unsigned int, Field> &id_fields);
+		FieldsPlan(const FieldsPlan &plan) = delete; // pack_fields points into fields
+		
+		const std::vector<st_field> &GetFields() const { return fields; }
+		const std::vector<const st_field *> &GetPackFields() const { return pack_fields; }
+		const st_field *Get(const std::string &name) const;
+	
+	private:
+		static void pack_char(const std::string &value, st_context &context, st_packed &packed);
+		static void pack_text(const std::string &value, st_context &context, st_packed &packed);
+		static void pack_itext(const std::string &value, st_context &context, st_packed &packed);
+		static void pack_int(const std::string &value, st_context &context, st_packed &packed);
+		static void pack_ip(const std::string &value, st_context &context, st_packed &packed);
+		static void pack_pack(const std::string &value, st_context &context, st_packed &packed);
+};
+
+}
+
+#endif
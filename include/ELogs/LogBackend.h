@@ -0,0 +1,92 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _LOGBACKEND_H_
+#define _LOGBACKEND_H_
+
+#include <ELogs/Channel.h>
+#include <ELogs/ChannelGroup.h>
+#include <ELogs/Rollups.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <time.h>
+
+namespace ELogs
+{
+
+// Logs search criteria, parsed from API filters
+struct LogQuery
+{
+	int crit = -1;
+	std::string emitted_from;
+	std::string emitted_until;
+	
+	unsigned int group_id = 0;
+	ChannelGroup group;
+	std::map<std::string, std::string> group_filters; // Field name => filter value
+	
+	unsigned int channel_id = 0;
+	Channel channel;
+	std::map<std::string, std::string> channel_filters; // Field name => filter value
+	
+	std::string groupby;
+};
+
+// Storage of log lines, LogStorage writes through it and ELogs queries read through it
+class LogBackend
+{
+	public:
+		virtual ~LogBackend() {}
+		
+		// Ingestion state of one storage worker, workers never share a writer
+		class Writer
+		{
+			public:
+				virtual ~Writer() {}
+				
+				virtual void StartBatch() = 0;
+				virtual void Store(unsigned long long log_id, const Channel &channel, const std::string &date, int crit, const std::map<std::string, std::string> &group_fields, const std::map<std::string, std::string> &channel_fields) = 0;
+				
+				// Rollups of the batch are stored with it, throws when logs of the batch are not stored
+				virtual void CommitBatch(Rollups::t_counters &rollup_counters) = 0;
+				
+				// Called regularly when no logs are received
+				virtual void Idle() {}
+		};
+		
+		static LogBackend *Create();
+		
+		virtual Writer *CreateWriter() = 0;
+		
+		// Search
+		virtual std::vector<std::map<std::string, std::string>> Query(const LogQuery &query, unsigned int limit, unsigned int offset) = 0;
+		virtual bool Get(unsigned long long log_id, unsigned int *channel_id, std::map<std::string, std::string> &group_values, std::map<std::string, std::string> &channel_values) = 0;
+		virtual std::vector<std::map<std::string, std::string>> GetStatistics() = 0;
+		
+		// Retention, returns the number of days removed
+		virtual int Purge(time_t now, int retention) = 0;
+};
+
+}
+
+#endif
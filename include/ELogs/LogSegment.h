@@ -0,0 +1,121 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _LOGSEGMENT_H_
+#define _LOGSEGMENT_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+#define LOGSEGMENT_MAGIC        "EVQLSEG1"
+#define LOGSEGMENT_DICT_MAX     256
+#define LOGSEGMENT_CHUNK_ROWS   1024
+
+// Built-in columns, fields columns use the field ID
+#define LOGSEGMENT_COL_LOG_ID   0xFFFFFFFF
+#define LOGSEGMENT_COL_TIME     0xFFFFFFFE
+#define LOGSEGMENT_COL_CRIT     0xFFFFFFFD
+
+namespace ELogs
+{
+
+// Immutable columnar block of log lines of one channel and one day
+class LogSegment
+{
+	public:
+		struct st_column
+		{
+			bool is_int = false;
+			std::vector<bool> nulls;
+			std::vector<long long> ints;
+			std::vector<std::string> strs;
+			
+			bool IsNull(unsigned int row) const { return nulls[row]; }
+			std::string GetString(unsigned int row) const;
+		};
+		
+		struct st_column_desc
+		{
+			bool is_int = false;
+			bool has_nulls = false;
+			long long min_int = 0;
+			long long max_int = 0;
+			bool is_dict = false;
+			std::vector<std::string> dict;
+			unsigned long long offset = 0;
+			unsigned int length = 0;
+			unsigned int raw_length = 0;
+		};
+		
+		// Rows being appended by log storage, written to disk as a segment once complete
+		class Builder
+		{
+			unsigned int nrows = 0;
+			std::map<unsigned int, bool> types; // Column ID => is_int, for all chunks
+			std::vector<std::shared_ptr<const LogSegment>> chunks; // Sealed rows, shared with queries
+			unsigned int chunk_rows = 0;
+			std::map<unsigned int, st_column> columns; // Rows not yet sealed
+			
+			public:
+				unsigned int GetRows() const { return nrows; }
+				void AddRow(const std::map<unsigned int, long long> &ints, const std::map<unsigned int, std::string> &strs);
+				std::vector<std::shared_ptr<const LogSegment>> Snapshot();
+				void Write(const std::string &filename) const;
+			
+			private:
+				void seal();
+		};
+	
+	private:
+		std::string filename;
+		unsigned int nrows;
+		unsigned int header_length;
+		std::map<unsigned int, st_column_desc> columns;
+		std::shared_ptr<std::map<unsigned int, st_column>> data; // In memory segments only
+	
+	public:
+		LogSegment(const std::string &filename);
+		
+		unsigned int GetRows() const { return nrows; }
+		unsigned int GetHeaderLength() const { return header_length; }
+		const st_column_desc *GetColumn(unsigned int id) const;
+		
+		void ReadColumn(unsigned int id, st_column &column) const;
+	
+	private:
+		LogSegment(std::shared_ptr<std::map<unsigned int, st_column>> data, unsigned int nrows);
+		
+		static st_column_desc describe(const st_column &column, unsigned int nrows);
+		static void encode(const st_column &column, const st_column_desc &desc, std::string &buf);
+		static void decode(const std::string &buf, const st_column_desc &desc, unsigned int nrows, st_column &column);
+		
+		static void write_varint(std::string &buf, unsigned long long v);
+		static unsigned long long read_varint(const std::string &buf, size_t &pos);
+		static void write_string(std::string &buf, const std::string &str);
+		static std::string read_string(const std::string &buf, size_t &pos);
+		static unsigned long long zigzag(long long v) { return ((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63); }
+		static long long unzigzag(unsigned long long v) { return (long long)(v >> 1) ^ -(long long)(v & 1); }
+};
+
+}
+
+#endif
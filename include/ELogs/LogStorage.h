@@ -21,42 +21,42 @@
 #define _LOGSTORAGE_H_
 
 #include <API/APIAutoInit.h>
-#include <Thread/ConsumerThread.h>
-#include <Thread/ProducerThread.h>
 
 #include <string>
-#include <map>
 #include <vector>
-#include <queue>
-#include <regex>
+#include <mutex>
+#include <atomic>
 
 class DB;
 
 namespace ELogs
 {
 
-class Channel;
-class Field;
+class LogBackend;
+class LogStorageWorker;
+class StreamIngest;
+class Rollups;
+class PackDictionary;
 
-class LogStorage: public APIAutoInit, public ConsumerThread, public ProducerThread
+class LogStorage: public APIAutoInit
 {
-	std::map<std::string, unsigned int> pack_str_id;
-	std::map<unsigned int, std::string> pack_id_str;
-	
-	int bulk_size;
-	std::regex channel_regex;
-	std::queue<std::string> logs;
-	std::vector<std::string> to_insert_logs;
-	size_t max_queue_size;
+	std::vector<LogStorageWorker *> workers;
 	
 	static LogStorage *instance;
 	
-	bool is_shutting_down = false;
+	// Log IDs reserved from t_seq and not yet handed out to workers
+	std::mutex ids_lock;
+	unsigned long long next_log_id = 0;
+	unsigned long long end_log_id = 0;
+	int ids_block;
 	
-	unsigned long long next_log_id;
-	unsigned int last_partition_days;
+	// Number of batches stored so far, results computed before a newer batch may be incomplete
+	std::atomic<unsigned long long> watermark;
 	
-	DB *storage_db;
+	LogBackend *backend;
+	Rollups *rollups;
+	PackDictionary *dictionary;
+	StreamIngest *stream;
 	
 	public:
 		LogStorage();
@@ -64,23 +64,20 @@ class LogStorage: public APIAutoInit, public ConsumerThread, public ProducerThre
 		
 		static LogStorage *GetInstance() { return instance; }
 		
-		void Log(const std::string &str);
+		LogBackend *GetBackend() { return backend; }
+		Rollups *GetRollups() { return rollups; }
+		StreamIngest *GetStreamIngest() { return stream; }
 		
-		unsigned int PackString(const std::string &str);
-		std::string UnpackString(int i);
-	
-	protected:
-		bool data_available();
-		void init_thread();
-		void release_thread();
-		void get();
-		void process();
+		// Returns false if the queue is still full after wait_ms
+		bool Log(const std::string &str, int wait_ms = 0);
+		
+		unsigned long long AllocateLogIDs(DB *db, int n);
+		
+		void BatchStored() { watermark++; }
+		unsigned long long GetWatermark() const { return watermark; }
 	
 	private:
-		void log(const std::vector<std::string> &logs);
-		void store_log(const Channel &channel, const std::map<std::string, std::string> &group_fields, const std::map<std::string, std::string> &channel_fields);
-		void log_value(unsigned long long log_id, const Field &field, const std::string &date, const std::string &value);
-		void create_partition(const std::string &date);
+		static std::string get_channel_name(const std::string &str);
 };
 
 }
@@ -0,0 +1,93 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#ifndef _LOGSTORAGEWORKER_H_
+#define _LOGSTORAGEWORKER_H_
+
+#include <Thread/ConsumerThread.h>
+#include <Thread/ProducerThread.h>
+#include <ELogs/Channel.h>
+#include <ELogs/LogBackend.h>
+#include <ELogs/Rollups.h>
+
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <queue>
+#include <regex>
+#include <condition_variable>
+
+class DB;
+
+namespace ELogs
+{
+
+class LogStorage;
+class Fields;
+
+// Stores the logs of a subset of channels, on its own connection and with its own bulk buffers
+class LogStorageWorker: public ConsumerThread, public ProducerThread
+{
+	struct st_log
+	{
+		Channel channel;
+		std::string log_str;
+		std::map<std::string, std::string> group_fields;
+		std::map<std::string, std::string> channel_fields;
+	};
+	
+	LogStorage *storage;
+	
+	int bulk_size;
+	std::regex channel_regex;
+	std::queue<std::string> logs;
+	std::vector<std::string> to_insert_logs;
+	size_t max_queue_size;
+	std::condition_variable space_cond; // Signaled when logs leave the queue
+	
+	unsigned long long next_log_id;
+	
+	DB *storage_db;
+	LogBackend::Writer *writer;
+	Rollups::t_counters rollup_counters;
+	
+	public:
+		LogStorageWorker(LogStorage *storage);
+		virtual ~LogStorageWorker();
+		
+		bool Log(const std::string &str, int wait_ms = 0);
+	
+	protected:
+		bool data_available();
+		void idle();
+		void init_thread();
+		void release_thread();
+		void get();
+		void process();
+	
+	private:
+		void log(const std::vector<std::string> &logs);
+		unsigned long long store_log(const Channel &channel, const std::map<std::string, std::string> &group_fields, const std::map<std::string, std::string> &channel_fields);
+		static void get_pack_strings(const Fields &fields, const std::map<std::string, std::string> &values, std::set<std::string> &pack_strings);
+};
+
+}
+
+#endif
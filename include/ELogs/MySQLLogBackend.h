@@ -0,0 +1,83 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _MYSQLLOGBACKEND_H_
+#define _MYSQLLOGBACKEND_H_
+
+#include <ELogs/LogBackend.h>
+#include <ELogs/FieldsPlan.h>
+
+class DB;
+
+namespace ELogs
+{
+
+class Field;
+class Fields;
+class Partitions;
+
+// Historical storage, one t_log row per line and one row per field value in the t_value_* tables
+class MySQLLogBackend: public LogBackend
+{
+	// Bulk inserts of one storage worker, on its own connection
+	class Writer: public LogBackend::Writer
+	{
+		DB *storage_db;
+		const Partitions *partitions;
+		bool bulk_load;
+		
+		FieldsPlan::st_context context;
+		std::vector<FieldsPlan::st_packed> packed;
+		
+		public:
+			Writer(const Partitions *partitions);
+			virtual ~Writer();
+			
+			void StartBatch();
+			void Store(unsigned long long log_id, const Channel &channel, const std::string &date, int crit, const std::map<std::string, std::string> &group_fields, const std::map<std::string, std::string> &channel_fields);
+			void CommitBatch(Rollups::t_counters &rollup_counters);
+		
+		private:
+			void pack_values(const FieldsPlan &plan, const std::map<std::string, std::string> &values, std::vector<const FieldsPlan::st_field *> &fields);
+			void log_value(unsigned long long log_id, const FieldsPlan::st_field &field, const std::string &date, const FieldsPlan::st_packed &value);
+	};
+	
+	Partitions *partitions;
+	
+	public:
+		MySQLLogBackend();
+		virtual ~MySQLLogBackend();
+		
+		LogBackend::Writer *CreateWriter();
+		
+		std::vector<std::map<std::string, std::string>> Query(const LogQuery &query, unsigned int limit, unsigned int offset);
+		bool Get(unsigned long long log_id, unsigned int *channel_id, std::map<std::string, std::string> &group_values, std::map<std::string, std::string> &channel_values);
+		std::vector<std::map<std::string, std::string>> GetStatistics();
+		
+		int Purge(time_t now, int retention);
+	
+	private:
+		static void add_auto_filters(const std::map<std::string, std::string> &filters, const Fields &fields, std::string &query_where, std::vector<const void *> &values, std::vector<FieldsPlan::st_packed> &packed);
+		static void query_fields(DB *db, unsigned long long id, const Fields &fields, std::map<std::string, std::string> &values);
+};
+
+}
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _PACKDICTIONARY_H_
+#define _PACKDICTIONARY_H_
+
+#include <string>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+
+#define PACKDICTIONARY_SHARDS    16
+
+namespace ELogs
+{
+
+// Bidirectional cache of t_pack, shared by log storage and logs queries
+class PackDictionary
+{
+	struct st_str_shard
+	{
+		std::mutex lock;
+		std::unordered_map<std::string, unsigned int> ids;
+	};
+	
+	struct st_id_shard
+	{
+		std::mutex lock;
+		std::unordered_map<unsigned int, std::string> strs;
+	};
+	
+	st_str_shard str_shards[PACKDICTIONARY_SHARDS];
+	st_id_shard id_shards[PACKDICTIONARY_SHARDS];
+	
+	static PackDictionary *instance;
+	
+	public:
+		PackDictionary();
+		~PackDictionary();
+		
+		static PackDictionary *GetInstance() { return instance; }
+		
+		unsigned int Pack(const std::string &str);
+		std::string Unpack(unsigned int id);
+		bool Lookup(const std::string &str, unsigned int *id);
+		
+		// Bulk variants, one query for all unknown values
+		void PackBatch(const std::set<std::string> &strs);
+		void Prefetch(const std::set<unsigned int> &ids);
+	
+	private:
+		void add(unsigned int id, const std::string &str);
+		bool lookup_id(unsigned int id, std::string *str);
+		
+		st_str_shard &str_shard(const std::string &str) { return str_shards[std::hash<std::string>()(str) % PACKDICTIONARY_SHARDS]; }
+		st_id_shard &id_shard(unsigned int id) { return id_shards[id % PACKDICTIONARY_SHARDS]; }
+};
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _PARTITIONS_H_
+#define _PARTITIONS_H_
+
+#include <Thread/WaiterThread.h>
+
+#include <string>
+#include <vector>
+#include <atomic>
+
+class DB;
+
+namespace ELogs
+{
+
+// Maintenance of the daily partitions of logs tables, created ahead of time so log storage never runs DDL
+class Partitions: public WaiterThread
+{
+	int days_ahead;
+	std::atomic<int> last_partition_days;
+	
+	public:
+		Partitions();
+		virtual ~Partitions();
+		
+		static const std::vector<std::string> &GetTables();
+		
+		// Logs with TO_DAYS(date) lower than this value can be stored
+		int GetLastPartitionDays() const { return last_partition_days; }
+	
+	private:
+		void main();
+		
+		void maintain(DB *db);
+};
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#ifndef _QUERYCACHE_H_
+#define _QUERYCACHE_H_
+
+#include <API/APIAutoInit.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include <time.h>
+
+namespace ELogs
+{
+
+struct LogQuery;
+
+// Short lived cache of logs queries results, identical concurrent queries share one execution
+// The invalidation watermark is node-local : logs stored by other cluster nodes are only seen once the entry TTL has expired
+class QueryCache: public APIAutoInit
+{
+	struct st_entry
+	{
+		bool ready = false;
+		bool failed = false;
+		
+		time_t computed;
+		bool is_open; // Range is not closed, newer logs may enter the results
+		unsigned long long watermark;
+		
+		std::vector<std::map<std::string, std::string>> results;
+		
+		std::string error_context;
+		std::string error;
+		std::string error_code;
+		int error_codeno;
+	};
+	
+	int ttl;
+	unsigned int max_entries;
+	
+	std::mutex lock;
+	std::condition_variable cond;
+	std::map<std::string, std::shared_ptr<st_entry>> entries;
+	
+	unsigned long long hits = 0;
+	unsigned long long misses = 0;
+	
+	static QueryCache *instance;
+	
+	public:
+		QueryCache();
+		
+		static QueryCache *GetInstance() { return instance; }
+		
+		std::vector<std::map<std::string, std::string>> Get(const LogQuery &query, unsigned int limit, unsigned int offset, const std::function<std::vector<std::map<std::string, std::string>>()> &execute);
+		
+		std::map<std::string, std::string> GetStatistics();
+	
+	private:
+		bool is_fresh(const st_entry &entry, time_t now, unsigned long long watermark) const;
+		void evict(time_t now, unsigned long long watermark);
+		void failed(const std::string &key, const std::shared_ptr<st_entry> &entry); // Called with lock held
+		
+		static std::string get_key(const LogQuery &query, unsigned int limit, unsigned int offset);
+		static void add_key(std::string &key, const std::string &value);
+		static bool is_open(const LogQuery &query);
+};
+
+}
+
+#endif
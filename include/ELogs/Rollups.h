@@ -0,0 +1,82 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _ROLLUPS_H_
+#define _ROLLUPS_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <tuple>
+#include <mutex>
+
+#define ROLLUPS_DISABLED_START "9999-12-31 23:59:59"
+
+class DB;
+
+namespace ELogs
+{
+
+class Channel;
+class Field;
+struct LogQuery;
+
+// Per minute logs counters, maintained by log storage to answer counting queries without reading logs
+class Rollups
+{
+	public:
+		// minute, channel, crit, field (0 for all logs), value
+		typedef std::tuple<std::string, unsigned int, int, unsigned int, int> t_key;
+		typedef std::map<t_key, unsigned long long> t_counters;
+	
+	private:
+		std::string node_name;
+		std::set<std::string> fields;
+		
+		// Date from which this node counts its logs, per field
+		std::mutex starts_lock;
+		std::map<unsigned int, std::string> starts;
+	
+	public:
+		Rollups();
+		~Rollups();
+		
+		static void Reset();
+		
+		// Ingestion, each storage worker accumulates its own counters and its backend commits them with the batch
+		void Add(t_counters &counters, const Channel &channel, const std::string &date, int crit, const std::map<std::string, std::string> &group_fields);
+		static void Commit(DB *db, t_counters &counters); // Counters are cleared once stored
+		
+		// Counters of stored logs were lost, counting starts over so earlier minutes are read from logs
+		void Restart();
+		
+		bool Query(const LogQuery &query, unsigned int limit, unsigned int offset, std::vector<std::map<std::string, std::string>> &results);
+	
+	private:
+		void start(unsigned int field_id);
+		static std::string get_cluster_start(DB *db, unsigned int field_id);
+		static bool is_rolled_up(const Field &field);
+		static std::string normalize_date(const std::string &date);
+};
+
+}
+
+#endif
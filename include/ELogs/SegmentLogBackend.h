@@ -0,0 +1,153 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _SEGMENTLOGBACKEND_H_
+#define _SEGMENTLOGBACKEND_H_
+
+#include <ELogs/LogBackend.h>
+#include <ELogs/LogSegment.h>
+#include <ELogs/Field.h>
+
+#include <mutex>
+#include <memory>
+#include <set>
+
+class DB;
+
+namespace ELogs
+{
+
+class Fields;
+
+// Append only storage in compressed columnar segments, one directory per day and per channel
+class SegmentLogBackend: public LogBackend
+{
+	struct st_filter
+	{
+		unsigned int column;
+		Field::en_type type; // NONE for built-in columns
+		long long min_int;
+		long long max_int;
+		std::string value_str;
+		bool is_prefix = false;
+	};
+	
+	struct st_segment
+	{
+		std::string day;
+		unsigned int channel_id;
+		unsigned long long first_log_id;
+		std::string filename;
+		std::shared_ptr<const LogSegment> segment; // Loaded on demand for on disk segments
+	};
+	
+	struct st_indexed_segment
+	{
+		unsigned long long last_log_id;
+		st_segment segment;
+	};
+	
+	// Rows are accumulated across batches until a segment is full
+	class Writer: public LogBackend::Writer
+	{
+		SegmentLogBackend *backend;
+		DB *rollups_db;
+		
+		public:
+			Writer(SegmentLogBackend *backend);
+			virtual ~Writer();
+			
+			void StartBatch() {}
+			void Store(unsigned long long log_id, const Channel &channel, const std::string &date, int crit, const std::map<std::string, std::string> &group_fields, const std::map<std::string, std::string> &channel_fields) { backend->store(this, log_id, channel, date, crit, group_fields, channel_fields); }
+			void CommitBatch(Rollups::t_counters &rollup_counters);
+			void Idle() { backend->flush(this, false); }
+	};
+	
+	struct st_pending
+	{
+		const Writer *writer; // A channel is always stored by the same worker, which owns its pending segments
+		unsigned long long first_log_id;
+		time_t created;
+		LogSegment::Builder builder;
+	};
+	
+	std::string directory;
+	unsigned int segment_rows;
+	int segment_flush;
+	
+	std::mutex pending_lock;
+	std::map<std::pair<std::string, unsigned int>, st_pending> pending;
+	std::map<std::string, std::vector<st_segment>> flushing; // Segment filename => rows being written, visible until renamed
+	
+	// Log IDs ranges of on disk segments for Get(), built on first use then maintained by flush and purge
+	std::mutex index_lock;
+	bool index_built = false;
+	std::map<unsigned long long, st_indexed_segment> index; // First log ID => segment
+	unsigned long long index_max_span = 0;
+	
+	public:
+		SegmentLogBackend();
+		virtual ~SegmentLogBackend();
+		
+		LogBackend::Writer *CreateWriter();
+		
+		std::vector<std::map<std::string, std::string>> Query(const LogQuery &query, unsigned int limit, unsigned int offset);
+		bool Get(unsigned long long log_id, unsigned int *channel_id, std::map<std::string, std::string> &group_values, std::map<std::string, std::string> &channel_values);
+		std::vector<std::map<std::string, std::string>> GetStatistics();
+		
+		int Purge(time_t now, int retention);
+	
+	private:
+		void store(const Writer *writer, unsigned long long log_id, const Channel &channel, const std::string &date, int crit, const std::map<std::string, std::string> &group_fields, const std::map<std::string, std::string> &channel_fields);
+		bool flush(const Writer *writer, bool all); // False when segments could not be written and their logs are lost
+		static void restart_rollups();
+		
+		std::vector<st_segment> list_segments(const std::string &from_day, const std::string &until_day, const LogQuery &query, unsigned long long max_first_log_id = -1, bool list_files = true);
+		static void add_memory_segments(const std::string &day, unsigned int channel_id, const std::vector<std::shared_ptr<const LogSegment>> &chunks, unsigned long long max_first_log_id, std::vector<st_segment> &segments);
+		static bool load_segment(st_segment &segment);
+		
+		std::vector<st_segment> lookup_index(unsigned long long log_id);
+		void build_index();
+		void index_segment(const st_segment &segment, unsigned long long last_log_id);
+		
+		std::vector<std::map<std::string, std::string>> query_logs(const LogQuery &query, std::vector<st_segment> &segments, const std::vector<st_filter> &filters, const std::string &from, const std::string &until, unsigned int limit, unsigned int offset);
+		std::vector<std::map<std::string, std::string>> query_groupby(const LogQuery &query, std::vector<st_segment> &segments, const std::vector<st_filter> &filters, const std::string &from, const std::string &until, unsigned int limit, unsigned int offset);
+		
+		static std::vector<st_filter> compile_filters(const LogQuery &query);
+		static void compile_field_filters(const Fields &fields, const std::map<std::string, std::string> &values, std::vector<st_filter> &filters);
+		static std::vector<st_filter> segment_filters(const st_segment &segment, const std::vector<st_filter> &filters, const std::string &from, const std::string &until);
+		static bool may_match(const LogSegment &segment, const std::vector<st_filter> &filters);
+		static std::vector<unsigned int> match_rows(const LogSegment &segment, const std::vector<st_filter> &filters, std::map<unsigned int, LogSegment::st_column> &columns);
+		static bool match_string(const st_filter &filter, const std::string &value);
+		static const LogSegment::st_column &get_column(const LogSegment &segment, unsigned int id, std::map<unsigned int, LogSegment::st_column> &columns);
+		static void get_pack_ids(const LogSegment &segment, unsigned int row, const std::map<unsigned int, Field> &fields, std::map<unsigned int, LogSegment::st_column> &columns, std::set<unsigned int> &pack_ids);
+		
+		static void add_value(const Field &field, const std::string &value, std::map<unsigned int, long long> &ints, std::map<unsigned int, std::string> &strs);
+		static std::string normalize_date(const std::string &date);
+		static int parse_time(const std::string &date);
+		static long long date_key(const std::string &day, long long time);
+		static std::string format_time(int t);
+		static std::vector<std::string> list_directory(const std::string &path);
+		static void create_directory(const std::string &path);
+};
+
+}
+
+#endif
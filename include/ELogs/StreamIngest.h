@@ -0,0 +1,92 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#ifndef _ELOGS_STREAMINGEST_H_
+#define _ELOGS_STREAMINGEST_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+
+namespace ELogs
+{
+
+class LogStorage;
+
+// Receives logs on TCP/UNIX stream sockets, one thread per connection.
+// When the storage queues are full, reading from the socket is paused so senders are slowed down
+// instead of losing logs. Accepted logs are acknowledged with "ACK <count>\n" lines.
+// ACK means accepted, not committed : logs are in the storage queues, workers store them asynchronously
+// and store what is left in their queues before exiting. Logs failing to parse or store are only logged.
+class StreamIngest
+{
+	public:
+		enum t_framing
+		{
+			NEWLINE,
+			LENGTH
+		};
+	
+	private:
+		struct st_connection
+		{
+			std::thread th;
+			std::string peer;
+			time_t connected;
+			unsigned long long bytes = 0;
+			unsigned long long logs = 0;
+			unsigned long long acked = 0;
+			unsigned long long waits = 0;
+			double wait_time = 0;
+			bool waiting = false;
+		};
+		
+		LogStorage *storage;
+		
+		t_framing framing;
+		size_t max_size;
+		unsigned int ack_every;
+		unsigned int max_connections;
+		
+		bool is_shutting_down;
+		std::map<int, st_connection> connections;
+		std::mutex lock;
+		
+		static std::string get_peer(int s);
+		
+		void handle_connection(int s);
+		void end_connection(int s);
+		bool next_message(const std::string &buf, size_t &pos, size_t &scan, std::string &msg, std::string &error);
+		bool store(int s, const std::string &msg);
+		bool send_ack(int s, unsigned long long logs);
+	
+	public:
+		StreamIngest(LogStorage *storage);
+		~StreamIngest();
+		
+		void Accept(int s);
+		
+		std::vector<std::map<std::string, std::string>> GetStatistics();
+};
+
+}
+
+#endif
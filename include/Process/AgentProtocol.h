@@ -0,0 +1,117 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#ifndef _AGENTPROTOCOL_H_
+#define _AGENTPROTOCOL_H_
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <zlib.h>
+
+// Streams multiplexed by the agent (stdout, stderr, log)
+#define AGENT_MAXFD            4
+
+// Binary protocol (version 2)
+#define AGENT_PROTOCOL_MAGIC   0xEA
+#define AGENT_PROTOCOL_VERSION 2
+#define AGENT_HEADER_SIZE      6
+#define AGENT_MIN_FRAME_SIZE   4096
+#define AGENT_MAX_FRAME_SIZE   1048576
+#define AGENT_FLAG_DEFLATE     0x01
+
+// Legacy ASCII protocol (version 1)
+#define AGENT_LEGACY_HEADER_SIZE 11
+#define AGENT_LEGACY_FRAME_SIZE  4096
+
+/*
+ * Version 2 stream :
+ *   handshake : MAGIC VERSION
+ *   frame     : fd (1 byte) flags (1 byte) length (4 bytes, big endian) payload
+ *
+ * Version 1 stream (legacy, used when the monitor did not request version 2) :
+ *   frame     : "%02d%09d" fd length, payload (at most 4096 bytes)
+ */
+
+class AgentProtocolWriter
+{
+	int fd;
+	int version;
+	bool use_splice = true;
+	
+	z_stream *zstreams[AGENT_MAXFD] = {0};
+	
+	std::vector<char> buf;
+	std::vector<char> zbuf;
+	
+	void write_header(int stream_fd, unsigned char flags, size_t len);
+	void write_frame(int stream_fd, unsigned char flags, const char *data, size_t len);
+	void write_legacy(int stream_fd, const char *data, size_t len);
+	void write_all(const char *data, size_t len);
+	void splice_all(int in_fd, size_t len);
+	
+	public:
+		AgentProtocolWriter(int fd, int version);
+		~AgentProtocolWriter();
+		
+		void EnableCompression(int stream_fd, int level = Z_DEFAULT_COMPRESSION);
+		
+		void Handshake();
+		bool Forward(int stream_fd, int in_fd);
+		
+		static void GrowPipe(int fd);
+};
+
+class AgentProtocolReader
+{
+	int fd;
+	int version = 0;
+	int pending_byte = -1;
+	
+	int splice_targets[AGENT_MAXFD];
+	z_stream *zstreams[AGENT_MAXFD] = {0};
+	
+	std::vector<char> buf;
+	std::vector<char> zbuf;
+	
+	int handshake();
+	bool read_all(char *data, size_t len);
+	bool splice_all(int out_fd, size_t len);
+	bool inflate_frame(int stream_fd, size_t len);
+	
+	public:
+		enum en_status
+		{
+			FRAME_OK,
+			FRAME_EOF,
+			FRAME_ERROR
+		};
+		
+		AgentProtocolReader(int fd);
+		~AgentProtocolReader();
+		
+		int GetVersion() const { return version; }
+		
+		void SetSpliceTarget(int stream_fd, int out_fd);
+		
+		en_status ReadFrame(int *stream_fd, const char **data, size_t *len);
+};
+
+#endif
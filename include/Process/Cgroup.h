@@ -0,0 +1,49 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#ifndef _CGROUP_H_
+#define _CGROUP_H_
+
+#include <string>
+#include <map>
+
+// cgroup v2 child used to limit and account a single task
+class Cgroup
+{
+	std::string base;
+	std::string path;
+	
+	static bool write_file(const std::string &filename, const std::string &value);
+	static bool read_file(const std::string &filename, std::string &value);
+	static void enable_controllers(const std::string &path);
+	
+	public:
+		Cgroup(const std::string &base, const std::string &name);
+		
+		const std::string &GetPath() const { return path; }
+		
+		void Create();
+		void SetLimit(const std::string &name, const std::string &value);
+		void GetAccounting(std::map<std::string,std::string> &accounting);
+		void Destroy();
+		
+		static void Join(const std::string &path);
+};
+
+#endif
@@ -1,3 +1,22 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
 #ifndef _DATASERIALIZER_H_
 #define _DATASERIALIZER_H_
 
@@ -5,9 +24,47 @@
 #include <vector>
 #include <string>
 
+#include <stdint.h>
+
+// Binary items start with a tag that cannot be mistaken for a legacy ASCII length
+#define DATASERIALIZER_TAG_STRING 0xD1
+#define DATASERIALIZER_TAG_VECTOR 0xD2
+#define DATASERIALIZER_TAG_MAP    0xD3
+#define DATASERIALIZER_TAG_INT    0xD4
+
+// Upper bound of a single string, guards allocations against corrupted streams
+#define DATASERIALIZER_MAX_LEN    (1024*1024*1024)
+
+// Strings are grown by this step while reading, so a bogus length cannot allocate memory before data is received
+#define DATASERIALIZER_READ_CHUNK (64*1024)
+
+// Legacy format stores the entries count on 3 digits and lengths on 9 digits
+#define DATASERIALIZER_LEGACY_MAX_ENTRIES 999
+#define DATASERIALIZER_LEGACY_MAX_LEN     999999999
+
+/*
+ * Binary format (integers are 32 bits little endian) :
+ *   string : TAG_STRING len data
+ *   vector : TAG_VECTOR count (len data)*
+ *   map    : TAG_MAP count (name_len value_len name value)*
+ *   int    : TAG_INT value
+ *
+ * Unserialize() also reads the legacy ASCII format, which is still produced by SerializeLegacy() for remote agents.
+ */
+
 class DataSerializer
 {
 	static int readlen(int fd, char *value, int value_len);
+	static bool read_tag(int fd, unsigned char *tag);
+	static bool read_u32(int fd, uint32_t *n);
+	static bool read_string(int fd, uint32_t len, std::string &str);
+	
+	static void append_u32(std::string &data, uint32_t n);
+	static uint32_t get_u32(const char *buf);
+	
+	static bool unserialize_legacy(int fd, char first, std::map<std::string,std::string> &map);
+	static bool unserialize_legacy(int fd, char first, std::vector<std::string> &vector);
+	static bool unserialize_legacy(int fd, char first, std::string &str);
 	
 	public:
 		static std::string Serialize(const std::map<std::string,std::string> &map);
@@ -15,6 +72,9 @@ class DataSerializer
 		static std::string Serialize(const std::string &str);
 		static std::string Serialize(int n);
 		
+		static std::string SerializeLegacy(const std::map<std::string,std::string> &map);
+		static std::string SerializeLegacy(const std::string &str);
+		
 		static bool Unserialize(int fd, std::map<std::string,std::string> &map);
 		static bool Unserialize(int fd, std::vector<std::string> &vector);
 		static bool Unserialize(int fd, std::string &str);
@@ -34,6 +34,7 @@ class ProcessExec
 	
 	std::string path;
 	std::string wd;
+	std::string cgroup;
 	std::vector<std::string> arguments;
 	std::map<std::string,std::string> env;
 	
@@ -54,6 +55,7 @@ class ProcessExec
 		void SetScript(const std::string &path, const std::string &script);
 		
 		void SetWorkingDirectory(const std::string &wd) { this->wd = wd; }
+		void SetCgroup(const std::string &cgroup) { this->cgroup = cgroup; }
 		
 		void AddArgument(const std::string &value, bool escape=false);
 		
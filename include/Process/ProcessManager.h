@@ -26,7 +26,11 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 class XMLQuery;
 class QueryResponse;
@@ -45,6 +49,14 @@ class ProcessManager
 		
 		std::thread forker_thread_handle;
 		std::thread gatherer_thread_handle;
+		std::thread progress_timer_thread_handle;
+		
+		// Wakes up the gatherer when pending progress updates must be flushed
+		std::mutex progress_timer_lock;
+		std::condition_variable progress_timer_cond;
+		bool progress_timer_armed = false;
+		bool progress_timer_stop = false;
+		std::chrono::steady_clock::time_point progress_timer_deadline;
 		
 	public:
 		ProcessManager();
@@ -52,6 +64,7 @@ class ProcessManager
 		
 		static void *Fork(ProcessManager *pm);
 		static void *Gather(ProcessManager *pm);
+		static void *ProgressTimer(ProcessManager *pm);
 		
 		void Shutdown(void);
 		void WaitForShutdown(void);
@@ -66,6 +79,9 @@ class ProcessManager
 	private:
 		static char *read_log_file(pid_t pid,pid_t tid,int log_fileno);
 		static std::string tail_log_file(pid_t tid,int log_fileno);
+		static void read_resources_file(pid_t tid,std::map<std::string,std::string> &resources);
+		static void flush_progress(std::map<pid_t,int> &pending_progress);
+		void arm_progress_timer(std::chrono::steady_clock::time_point deadline);
 };
 
 #endif
@@ -0,0 +1,48 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#ifndef _PROGRESSTHROTTLE_H_
+#define _PROGRESSTHROTTLE_H_
+
+#include <sys/types.h>
+
+#include <chrono>
+
+// Coalesces progress lines of a task, only the latest value is sent to the engine at most once per interval
+class ProgressThrottle
+{
+	int msgqid;
+	pid_t tid;
+	std::chrono::milliseconds interval;
+	
+	int last_sent = -1;
+	int pending = -1;
+	std::chrono::steady_clock::time_point last_send_time;
+	
+	void send(int prct);
+	
+	public:
+		ProgressThrottle(int msgqid, pid_t tid, int interval_ms);
+		
+		bool Handle(const char *line);
+		int GetTimeout() const;
+		void Flush();
+};
+
+#endif
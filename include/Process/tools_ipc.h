@@ -28,6 +28,7 @@ int ipc_openq(const char *qid_str);
 int ipc_queue_destroy(const char *qid_str);
 int ipc_queue_stats(const char *qid_str);
 int ipc_send_exit_msg(const char *qid_str,int type,int tid,char retcode);
-bool ipc_send_progress_message(int msgqid,const char* buf,pid_t tid);
+int ipc_parse_progress(const char *buf);
+int ipc_send_progress(int msgqid,pid_t tid,int prct);
 
 #endif
@@ -31,6 +31,7 @@
 
 #define QUEUE_SCHEDULER_FIFO 1
 #define QUEUE_SCHEDULER_PRIO 2
+#define QUEUE_SCHEDULER_WEIGHTED 3
 
 class WorkflowInstance;
 class XMLQuery;
@@ -49,6 +50,9 @@ class Queue
 			
 			WorkflowInstance *workflow_instance;
 			DOMElement task;
+			
+			long long enqueue_time; // ms, monotonic clock
+			long long weight_key; // Virtual deadline (ms, wall clock as explicit deadlines) used by weighted scheduler
 		};
 		
 		unsigned int id;
@@ -60,13 +64,23 @@ class Queue
 		unsigned int running_tasks;
 		
 		std::multimap<unsigned int,Task *> prio_queue;
+		std::multimap<long long,Task *> weighted_queue;
 		std::deque<Task *> queue;
 		
+		// Wait time statistics (ms)
+		unsigned long long wait_count = 0;
+		unsigned long long wait_total = 0;
+		unsigned long long wait_max = 0;
+		
 		std::queue<Task *>cancelled_tasks;
 		
 		std::string wanted_scheduler;
 		int scheduler;
 		
+		// Weighted scheduler parameters (ms)
+		long long weighted_horizon;
+		long long weighted_priority_step;
+		
 		bool removed;
 		
 	public:
@@ -87,6 +101,8 @@ class Queue
 		inline unsigned int GetSize(void) { return size; }
 		inline unsigned int GetRunningTasks(void) { return running_tasks; }
 		
+		void GetWaitStatistics(unsigned long long *count, unsigned long long *avg, unsigned long long *max, unsigned long long *oldest);
+		
 		void SetConcurrency(unsigned int concurrency);
 		inline unsigned int GetConcurrency(void) { return concurrency; }
 		
@@ -110,6 +126,8 @@ class Queue
 		static bool HandleQuery(const User &user, XMLQuery *query, QueryResponse *response);
 	
 	private:
+		static long long now();
+		
 		void enqueue_task(WorkflowInstance *workflow_instance,DOMElement task);
 		void dequeue_task(WorkflowInstance **p_workflow_instance,DOMElement *p_task);
 		
@@ -34,10 +34,12 @@ class ConsumerThread
 		std::thread th;
 		
 		bool is_shutting_down = 0;
+		int idle_timeout = 0; // Seconds without data before idle() is called, 0 to wait forever
 		
 		void start();
 		virtual void get() = 0;
 		virtual void process() = 0;
+		virtual void idle() {}
 		virtual void init_thread() {}
 		virtual void release_thread() {}
 		
@@ -32,10 +32,12 @@ class WaiterThread
 	std::condition_variable shutdown_requested;
 	
 	bool is_shutting_down = false;
+	bool is_woken_up = false;
 	
 	protected:
 		void start();
 		bool wait(int seconds);
+		void wakeup();
 		
 		static void thread_main(WaiterThread *ptr);
 		virtual void main(void) = 0;
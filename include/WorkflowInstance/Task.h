@@ -66,6 +66,8 @@ class Task
 		
 		std::string GetUser() const;
 		std::string GetHost() const;
+		std::string GetQueue() const;
+		std::string GetCgroupLimit(const std::string &name) const;
 		
 		task_type::task_type GetType() const  { return type; }
 		std::string GetTypeStr() const;
@@ -21,14 +21,22 @@
 #define _WORKFLOWINSTANCE_H_
 
 #include <DOM/DOMDocument.h>
+#include <XPath/WorkflowXPathFunctions.h>
 
 #include <string>
 #include <vector>
+#include <map>
 #include <mutex>
 
+// Bulk queries used to write per instance index rows in one statement
+#define WORKFLOWINSTANCE_BULK_FILTERS     1
+#define WORKFLOWINSTANCE_BULK_TAGS        2
+#define WORKFLOWINSTANCE_BULK_PARAMETERS  3
+
 class WorkflowParameters;
 class WorkflowSchedule;
 class QueryResponse;
+class DB;
 
 class WorkflowInstance
 {
@@ -46,7 +54,7 @@ class WorkflowInstance
 		bool is_cancelling;
 		
 		DOMDocument *xmldoc;
-		DOMElement context_job, context_parent_job;
+		WorkflowXPathFunctions::workflow_context xpath_context;
 		
 		const std::string &logs_directory;
 		
@@ -83,9 +91,10 @@ class WorkflowInstance
 		
 		// task_job.cpp
 		void TaskRestart(DOMElement task, bool *workflow_terminated);
-		bool TaskStop(DOMElement task,int retval,const char *stdout_output,const char * stderr_output,const char *log_output,bool *workflow_terminated);
+		bool TaskStop(DOMElement task,int retval,const char *stdout_output,const char * stderr_output,const char *log_output,bool *workflow_terminated,const std::map<std::string,std::string> &resources = std::map<std::string,std::string>());
 		pid_t TaskExecute(DOMElement task,pid_t tid,bool *workflow_terminated);
 		void TaskUpdateProgression(DOMElement task, int prct);
+		void GetSchedulingHints(DOMElement task, int *priority, long long *deadline);
 		bool KillTask(pid_t pid);
 		
 		// savepoint.cpp
@@ -116,6 +125,7 @@ class WorkflowInstance
 		
 		// savepoint
 		void record_savepoint(bool force=false);
+		void record_filters_and_tags(DB *db);
 		
 		// value
 		void replace_values(DOMElement task,DOMElement context_node);
@@ -126,13 +136,14 @@ class WorkflowInstance
 		std::string format_datetime();
 		void update_job_statistics(const std::string &name,int delta,DOMElement node);
 		void clear_statistics();
+		void register_indexes();
 		bool workflow_ended(void);
 		
 		// custom_filters
-		void fill_custom_filters();
+		void fill_custom_filters(DB *db);
 		
 		// automatic_tags
-		void fill_automatic_tags();
+		int fill_automatic_tags(DB *db);
 };
 
 #endif
@@ -24,6 +24,8 @@
 #include <mutex>
 #include <condition_variable>
 
+#define WORKFLOWINSTANCES_COUNT_LIMIT 10000
+
 class WorkflowInstance;
 class QueryResponse;
 class XMLQuery;
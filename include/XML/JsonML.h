@@ -0,0 +1,40 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _JSONML_H_
+#define _JSONML_H_
+
+#include <DOM/DOMDocument.h>
+
+#include <string>
+
+#define JSONML_MAX_DEPTH 256
+
+// JsonML mapping of XML documents, used by the JSON wire protocol
+// An element is an array : ["name", {"attribute":"value", ...}, child, ...], text nodes are strings
+class JsonML
+{
+	public:
+		static DOMDocument *Parse(const std::string &json_str);
+		static void Serialize(DOMNode node, std::string &out);
+		static void Escape(const std::string &str, std::string &out);
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include <XPath/XPathEval.h>
 
 #include <vector>
+#include <string>
 
 class TokenNodeList;
 class Token;
@@ -30,6 +31,16 @@ class Token;
 class WorkflowXPathFunctions
 {
 public:
+	// Set once by the workflow instance as the XPath custom context, then updated in place as jobs are run
+	struct workflow_context
+	{
+		DOMNode current_job;
+		DOMNode parent_job;
+		bool needs_wait;
+		
+		workflow_context() { needs_wait = false; }
+	};
+	
 	static Token *evqGetWorkflowParameter(XPathEval::func_context context,const std::vector<Token *> &args);
 	static Token *evqGetJob(XPathEval::func_context context,const std::vector<Token *> &args);
 	static Token *evqGetCurrentJob(XPathEval::func_context context,const std::vector<Token *> &args);
@@ -38,6 +49,11 @@ public:
 	static Token *evqGetInput(XPathEval::func_context context,const std::vector<Token *> &args);
 	static Token *evqGetContext(XPathEval::func_context context,const std::vector<Token *> &args);
 	static Token *evqWait(XPathEval::func_context context,const std::vector<Token *> &args);
+
+private:
+	static workflow_context *get_workflow_context(XPathEval::func_context context,const std::string &function);
+	static DOMNode get_current_job(XPathEval::func_context context,const std::string &function);
+	static DOMNode get_parent_job(XPathEval::func_context context,const std::string &function);
 };
 
 #endif
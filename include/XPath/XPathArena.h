@@ -0,0 +1,82 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#ifndef _XPATHARENA_H_
+#define _XPATHARENA_H_
+
+#include <vector>
+
+#include <stddef.h>
+
+#define XPATHARENA_BLOCK_SIZE 16384
+
+// Bump allocator for XPath tokens
+// While a scope is active, tokens are allocated in the arena and delete is a no-op. Memory is reclaimed when the scope ends
+class XPathArena
+{
+	struct st_block
+	{
+		char *data;
+		size_t size;
+	};
+	
+	std::vector<st_block> blocks;
+	size_t current_block = 0;
+	size_t current_offset = 0;
+	int depth = 0;
+	
+	static thread_local XPathArena *active;
+	
+	void *allocate(size_t size);
+	void release(size_t block, size_t offset);
+	
+	public:
+		// Activate arena for current thread, scopes can be nested
+		class Scope
+		{
+			XPathArena *arena;
+			XPathArena *previous;
+			size_t block;
+			size_t offset;
+			
+			public:
+				Scope(XPathArena *arena);
+				~Scope();
+		};
+		
+		// Temporarily allocate on heap (for tokens that outlive the scope)
+		class Suspend
+		{
+			XPathArena *previous;
+			
+			public:
+				Suspend();
+				~Suspend();
+		};
+		
+		XPathArena() {}
+		XPathArena(const XPathArena &arena) = delete;
+		~XPathArena();
+		
+		static void *Allocate(size_t size);
+		static void Free(void *ptr);
+};
+
+#endif
@@ -27,9 +27,11 @@
 #include <map>
 
 #include <XPath/XPathTokens.h>
+#include <XPath/XPathArena.h>
 
 class TokenSeq;
 class TokenExpr;
+class TokenFilter;
 class Token;
 class DOMDocument;
 
@@ -59,25 +61,32 @@ public:
 	{
 		eval_context current_context;
 		TokenSeq *left_context;
+		const TokenSeq *current_node;
 		void *custom_context;
 		XPathEval *eval;
 	};
 	
 	struct func_desc
 	{
+		std::string name;
 		Token * (*impl)(func_context context,const std::vector<Token *> &args);
-		void *custom_context;
 	};
 	
 private:
 	
 	std::vector<op_desc> ops_desc;
-	std::map<std::string,func_desc> funcs_desc;
 	
 	DOMDocument *xmldoc;
+	void *custom_context;
+	const TokenSeq *current_node;
+	
+	static const std::vector<func_desc> &get_functions();
+	
+	XPathArena arena;
 	
 	TokenSeq *get_child_nodes(const std::string &name,const eval_context &context,TokenSeq *node_list,bool depth);
 	TokenSeq *get_child_attributes(const std::string &name,const eval_context &context,TokenSeq *node_list,bool depth);
+	bool get_indexed_nodes(const std::string &name,TokenFilter *filter,const eval_context &context,TokenSeq *node_list,bool depth);
 	TokenSeq *get_axis(const std::string &axis_name,const std::string &node_name,const eval_context &context,TokenSeq *node_list,bool depth);
 	
 	void filter_token_node_list(TokenSeq *list,TokenExpr *filter);
@@ -89,15 +98,20 @@ private:
 	Token *evaluate_attribute(const std::vector<Token *> &expr_tokens, int i,const eval_context &context,bool depth);
 	
 	Token *evaluate_expr(Token *token,const eval_context &context);
+	Token *evaluate(TokenExpr *parsed_expr,DOMNode context);
 	
 public:
 	XPathEval(DOMDocument *xmldoc);
 	
 	DOMDocument *GetXMLDoc() { return xmldoc; }
 	
-	void RegisterFunction(std::string name,func_desc f);
+	static int LookupFunction(const std::string &name);
+	
+	void SetCustomContext(void *custom_context) { this->custom_context = custom_context; }
 	
 	Token *Evaluate(const std::string &xpath,DOMNode context);
+	Token *Evaluate(const TokenExpr *expr,DOMNode context);
+	TokenExpr *Compile(const std::string &xpath);
 	void Parse(const std::string &xpath);
 };
 
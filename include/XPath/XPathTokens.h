@@ -21,6 +21,7 @@
 #define _XPATHTOKENS_H_
 
 #include <DOM/DOMNode.h>
+#include <XPath/XPathArena.h>
 
 #include <string>
 #include <vector>
@@ -83,6 +84,10 @@ public:
 	Token(const Token &t);
 	virtual ~Token() {};
 	
+	// Tokens are allocated in the evaluation arena when one is active
+	static void *operator new(size_t size) { return XPathArena::Allocate(size); }
+	static void operator delete(void *ptr) { XPathArena::Free(ptr); }
+	
 	Token *SetInitialPosition(int pos);
 	int GetInitialPosition() { return initial_position; }
 	std::string LogInitialPosition() const;
@@ -262,9 +267,10 @@ class TokenFunc:public Token
 {
 public:
 	std::string name;
+	int id; // Index in the XPathEval functions table, resolved at parse time (-1 if unknown)
 	std::vector<TokenExpr *> args;
 	
-	TokenFunc(const std::string &name) { this->name = name; }
+	TokenFunc(const std::string &name, int id) { this->name = name; this->id = id; }
 	TokenFunc(const TokenFunc &f);
 	~TokenFunc();
 	
@@ -131,6 +131,9 @@ void APISession::ChallengeReceived(XMLQuery *query)
 {
 	user = ah.HandleChallenge(query);
 	
+	// Greeting is sent in the same encoding as the challenge response
+	encoding = query->GetEncoding();
+	
 	status = AUTHENTICATED;
 	
 	Logger::Log(LOG_INFO,"Successful authentication of user '%s'",user.GetName().c_str());
@@ -153,11 +156,13 @@ void APISession::SendGreeting()
 		ready_response.SetWebsocket(wsi);
 	else
 		ready_response.SetSocket(s);
+	ready_response.SetEncoding(encoding);
 	
 	ready_response.SetAttribute("profile",user.GetProfile());
 	ready_response.SetAttribute("version",EVQUEUE_VERSION);
 	ready_response.SetAttribute("node",ConfigurationEvQueue::GetInstance()->Get("cluster.node.name"));
 	ready_response.SetAttribute("time",time_str);
+	ready_response.SetAttribute("encodings","xml,json");
 	
 	// Send list of registered modules and their versions
 	auto node_modules = ready_response.AppendXML("<modules />");
@@ -186,6 +191,7 @@ bool APISession::QueryReceived(XMLQuery *query, int external_id, const string &o
 		response.SetWebsocket(wsi);
 	else if(s!=-1)
 		response.SetSocket(s);
+	response.SetEncoding(query->GetEncoding()); // Responses are sent in the encoding of the query
 	
 	if(query->GetQueryGroup()=="quit")
 	{
@@ -193,6 +199,12 @@ bool APISession::QueryReceived(XMLQuery *query, int external_id, const string &o
 		return true;
 	}
 	
+	// Large responses can be streamed on plain sockets as they are sent right after the query
+	// XPath filters need the whole DOM
+	string xpath = query->GetRootAttribute("xpathfilter","");
+	if(wsi==0 && s!=-1 && xpath=="")
+		response.EnableStreaming(true);
+	
 	try
 	{
 		if(!QueryHandlers::GetInstance()->HandleQuery(user, query->GetQueryGroup(),query, &response))
@@ -213,12 +225,14 @@ bool APISession::QueryReceived(XMLQuery *query, int external_id, const string &o
 	// Apply XPath filter if requested and store response
 	unique_lock<mutex> llock(lock);
 	
-	string xpath = query->GetRootAttribute("xpathfilter","");
 	if(xpath!="")
 	{
+		response.Materialize();
+		
 		unique_ptr<DOMXPathResult> res(response.GetDOM()->evaluate(xpath,response.GetDOM()->getDocumentElement(),DOMXPathResult::FIRST_RESULT_TYPE));
 		
 		QueryResponse xpath_response;
+		xpath_response.SetEncoding(query->GetEncoding());
 		xpath_response.GetDOM()->ImportXPathResult(res.get(),xpath_response.GetDOM()->getDocumentElement());
 		
 		responses.push(move(xpath_response));
@@ -19,12 +19,17 @@
 
 #include <API/QueryResponse.h>
 #include <XML/XMLUtils.h>
+#include <XML/JsonML.h>
 #include <Logger/Logger.h>
 #include <DOM/DOMDocument.h>
+#include <DOM/DOMNamedNodeMap.h>
 #include <Configuration/ConfigurationEvQueue.h>
+#include <Exception/Exception.h>
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <errno.h>
+#include <string.h>
 
 #include <memory>
 
@@ -73,15 +78,27 @@ QueryResponse::QueryResponse(QueryResponse &&qr)
 	status_ok = qr.status_ok;
 	error = qr.error;
 	error_code = qr.error_code;
+	encoding = qr.encoding;
 	
 	xmldoc = qr.xmldoc;
 	qr.xmldoc = 0;
+	
+	writer = qr.writer;
+	if(writer)
+		writer->response = this;
+	qr.writer = 0;
+	
+	streaming_enabled = qr.streaming_enabled;
+	streaming_started = qr.streaming_started;
 }
 
 QueryResponse::~QueryResponse()
 {
 	if(xmldoc)
 		delete xmldoc;
+	
+	if(writer)
+		delete writer;
 }
 
 void QueryResponse::SetError(const string &error)
@@ -98,26 +115,79 @@ void QueryResponse::SetErrorCode(const string &code)
 
 void QueryResponse::SetAttribute(const std::string &name, const std::string &value)
 {
+	if(streaming_started)
+		throw Exception("QueryResponse","Response header has already been sent");
+	
 	xmldoc->getDocumentElement().setAttribute(name,value);
 }
 
 DOMNode QueryResponse::AppendXML(const string &xml)
 {
+	if(writer)
+		throw Exception("QueryResponse","Response is streamed, use the writer");
+	
 	return XMLUtils::AppendXML(xmldoc, xmldoc->getDocumentElement(), xml);
 }
 
 DOMNode QueryResponse::AppendText(const string &text)
 {
+	if(writer)
+		throw Exception("QueryResponse","Response is streamed, use the writer");
+	
 	return XMLUtils::AppendText(xmldoc, xmldoc->getDocumentElement(), text);
 }
 
 DOMNode QueryResponse::AppendXML(const string &xml, DOMElement node)
 {
+	if(writer)
+		throw Exception("QueryResponse","Response is streamed, use the writer");
+	
 	return XMLUtils::AppendXML(xmldoc, node, xml);
 }
 
+QueryResponseWriter *QueryResponse::Stream()
+{
+	// Elements already in the DOM are sent first, streamed elements are appended after them
+	// Root attributes can still be set until the first chunk is sent
+	if(!writer)
+		writer = new QueryResponseWriter(this);
+	
+	return writer;
+}
+
+void QueryResponse::Materialize()
+{
+	// Convert streamed content back to DOM (used by XPath filters)
+	if(!writer)
+		return;
+	
+	if(streaming_started)
+		throw Exception("QueryResponse","Response has already been sent");
+	
+	writer->end_all();
+	
+	string content = stream_header();
+	content += writer->buffer;
+	content += stream_footer();
+	
+	DOMDocument *new_xmldoc = writer->json?JsonML::Parse(content):DOMDocument::Parse(content);
+	if(!new_xmldoc)
+		throw Exception("QueryResponse","Invalid XML document");
+	
+	delete xmldoc;
+	xmldoc = new_xmldoc;
+	
+	delete writer;
+	writer = 0;
+}
+
 void QueryResponse::Empty()
 {
+	if(writer)
+		delete writer;
+	writer = 0;
+	streaming_started = false;
+	
 	delete xmldoc;
 	xmldoc = new DOMDocument();
 	
@@ -133,6 +203,29 @@ void QueryResponse::Empty()
 
 void QueryResponse::SendResponse()
 {
+	if(streaming_started)
+	{
+		if(!status_ok)
+		{
+			// Response header has been sent with an OK status, we can only break the connection
+			Logger::Log(LOG_WARNING, "Error after response streaming has started, closing connection : "+error);
+			shutdown(socket, SHUT_RDWR);
+			return;
+		}
+		
+		writer->end_all();
+		writer->buffer += stream_footer()+"\n";
+		send_all(writer->buffer.c_str(), writer->buffer.length());
+		return;
+	}
+	
+	if(writer && !status_ok)
+	{
+		// Nothing has been sent yet, discard streamed content and send error
+		delete writer;
+		writer = 0;
+	}
+	
 	DOMElement response_node = xmldoc->getDocumentElement();
 	
 	if(status_ok)
@@ -148,12 +241,24 @@ void QueryResponse::SendResponse()
 			response_node.setAttribute("error-code",error_code);
 	}
 	
-	string response = xmldoc->Serialize(xmldoc->getDocumentElement());
+	string response;
+	if(writer)
+	{
+		writer->end_all();
+		
+		response = stream_header();
+		response += writer->buffer;
+		response += stream_footer();
+	}
+	else if(encoding==XMLMessage::ENCODING_JSON)
+		JsonML::Serialize(xmldoc->getDocumentElement(), response);
+	else
+		response = xmldoc->Serialize(xmldoc->getDocumentElement());
 	
 	if(socket!=-1)
 	{
-		send(socket,response.c_str(),response.length(),0);
-		send(socket,"\n",1,0);
+		response += "\n";
+		send_all(response.c_str(),response.length());
 	}
 	
 	if(wsi)
@@ -163,11 +268,96 @@ void QueryResponse::SendResponse()
 	}
 }
 
+string QueryResponse::stream_header()
+{
+	DOMElement response_node = xmldoc->getDocumentElement();
+	
+	if(writer->json)
+	{
+		// JSON array of root element is left open, streamed elements are appended to it
+		string header;
+		JsonML::Serialize(response_node, header);
+		header.pop_back();
+		return header;
+	}
+	
+	string header = "<"+root_node_name;
+	
+	DOMNamedNodeMap attributes = response_node.getAttributes();
+	for(int i=0;i<attributes.getLength();i++)
+	{
+		DOMNode attribute = attributes.item(i);
+		header += " "+attribute.getNodeName()+"=\"";
+		QueryResponseWriter::Escape(attribute.getNodeValue(), header);
+		header += "\"";
+	}
+	
+	header += ">";
+	
+	for(DOMNode child = response_node.getFirstChild();child;child = child.getNextSibling())
+		xmldoc->Serialize(child,header);
+	
+	return header;
+}
+
+string QueryResponse::stream_footer()
+{
+	if(writer->json)
+		return "]";
+	
+	return "</"+root_node_name+">";
+}
+
+void QueryResponse::stream_chunk()
+{
+	if(!streaming_enabled || socket==-1)
+		return; // Keep everything in memory, response will be sent at once
+	
+	if(!streaming_started)
+	{
+		DOMElement response_node = xmldoc->getDocumentElement();
+		response_node.setAttribute("status","OK");
+		
+		string header = stream_header();
+		if(!send_all(header.c_str(), header.length()))
+			throw Exception("QueryResponse","Unable to send response");
+		
+		streaming_started = true;
+	}
+	
+	if(!send_all(writer->buffer.c_str(), writer->buffer.length()))
+		throw Exception("QueryResponse","Unable to send response");
+	
+	writer->buffer.clear();
+}
+
+bool QueryResponse::send_all(const char *buf, size_t len)
+{
+	size_t written = 0;
+	while(written<len)
+	{
+		ssize_t re = send(socket, buf+written, len-written, MSG_NOSIGNAL);
+		if(re<0)
+		{
+			if(errno==EINTR)
+				continue;
+			
+			Logger::Log(LOG_NOTICE, "Unable to send response : "+string(strerror(errno)));
+			return false;
+		}
+		
+		written += re;
+	}
+	
+	return true;
+}
+
 bool QueryResponse::Ping()
 {
 	Logger::Log(LOG_DEBUG, "Checking for dead peer");
-	int re = send(socket,"<ping />\n",9,0);
-	if(re!=9)
+	const char *ping = encoding==XMLMessage::ENCODING_JSON?"[\"ping\"]\n":"<ping />\n";
+	int re = send(socket,ping,strlen(ping),0);
+	if(re!=strlen(ping))
 		return false;
 	return true;
 }
@@ -0,0 +1,183 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#include <API/QueryResponseWriter.h>
+#include <API/QueryResponse.h>
+#include <Exception/Exception.h>
+#include <XML/JsonML.h>
+
+using namespace std;
+
+QueryResponseWriter::QueryResponseWriter(QueryResponse *response)
+{
+	this->response = response;
+	json = response->encoding==XMLMessage::ENCODING_JSON;
+	buffer.reserve(QUERYRESPONSEWRITER_CHUNK_SIZE+4096);
+}
+
+void QueryResponseWriter::StartElement(const string &name)
+{
+	close_tag();
+	
+	if(json)
+	{
+		buffer += ",[\"";
+		JsonML::Escape(name, buffer);
+		buffer += '"';
+	}
+	else
+	{
+		buffer += '<';
+		buffer += name;
+	}
+	tag_open = true;
+	
+	elements.push_back(name);
+}
+
+void QueryResponseWriter::SetAttribute(const string &name, const string &value)
+{
+	if(!tag_open)
+		throw Exception("QueryResponseWriter","Attributes must be set right after StartElement()");
+	
+	if(json)
+	{
+		buffer += attributes_open?",\"":",{\"";
+		attributes_open = true;
+		JsonML::Escape(name, buffer);
+		buffer += "\":\"";
+		JsonML::Escape(value, buffer);
+		buffer += '"';
+		return;
+	}
+	
+	buffer += ' ';
+	buffer += name;
+	buffer += "=\"";
+	Escape(value, buffer);
+	buffer += '"';
+}
+
+void QueryResponseWriter::AppendText(const string &text)
+{
+	if(elements.size()==0)
+		throw Exception("QueryResponseWriter","Text must be appended within an element");
+	
+	close_tag();
+	if(json)
+	{
+		buffer += ",\"";
+		JsonML::Escape(text, buffer);
+		buffer += '"';
+	}
+	else
+		Escape(text, buffer);
+	
+	flush();
+}
+
+void QueryResponseWriter::EndElement()
+{
+	if(elements.size()==0)
+		throw Exception("QueryResponseWriter","No element to end");
+	
+	end_element();
+	flush();
+}
+
+void QueryResponseWriter::end_element()
+{
+	if(json)
+	{
+		close_tag();
+		buffer += ']';
+	}
+	else if(tag_open)
+	{
+		buffer += "/>";
+		tag_open = false;
+	}
+	else
+	{
+		buffer += "</";
+		buffer += elements.back();
+		buffer += '>';
+	}
+	
+	elements.pop_back();
+}
+
+void QueryResponseWriter::Escape(const string &str, string &out)
+{
+	const char *s = str.c_str();
+	size_t len = str.length();
+	size_t start = 0;
+	
+	for(size_t i=0;i<len;i++)
+	{
+		const char *entity;
+		switch(s[i])
+		{
+			case '&': entity = "&amp;"; break;
+			case '<': entity = "&lt;"; break;
+			case '>': entity = "&gt;"; break;
+			case '"': entity = "&quot;"; break;
+			case '\n': entity = "&#10;"; break;
+			case '\r': entity = "&#13;"; break;
+			case '\t': entity = "&#9;"; break;
+			default: continue;
+		}
+		
+		out.append(s+start, i-start);
+		out += entity;
+		start = i+1;
+	}
+	
+	out.append(s+start, len-start);
+}
+
+void QueryResponseWriter::close_tag()
+{
+	if(tag_open)
+	{
+		if(json)
+		{
+			if(attributes_open)
+				buffer += '}';
+			attributes_open = false;
+		}
+		else
+			buffer += '>';
+		tag_open = false;
+	}
+}
+
+void QueryResponseWriter::end_all()
+{
+	// Remaining output is sent by QueryResponse, do not flush here
+	while(elements.size())
+		end_element();
+}
+
+void QueryResponseWriter::flush()
+{
+	if(buffer.length()>=QUERYRESPONSEWRITER_CHUNK_SIZE && !tag_open)
+		response->stream_chunk();
+}
@@ -20,16 +20,79 @@
 #include <API/XMLMessage.h>
 #include <Exception/Exception.h>
 #include <DOM/DOMNamedNodeMap.h>
+#include <XML/JsonML.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <string.h>
 
 using namespace std;
 
+// Skip leading blanks and return next byte without consuming it, 0 on error
+static char peek_char(int s)
+{
+	char c;
+	while(true)
+	{
+		int re = recv(s,&c,1,MSG_PEEK);
+		if(re<0 && errno==EINTR)
+			continue;
+		if(re!=1)
+			return 0;
+		
+		if(c!=' ' && c!='\n' && c!='\r' && c!='\t')
+			return c;
+		
+		recv(s,&c,1,0);
+	}
+}
+
+// JSON messages are terminated by a new line, read exactly one message
+static string read_line(const string &context, int s, size_t max_size)
+{
+	string line;
+	char buf[16384];
+	
+	while(true)
+	{
+		int re = recv(s,buf,sizeof(buf),MSG_PEEK);
+		if(re<0 && errno==EINTR)
+			continue;
+		if(re<=0)
+			throw Exception(context,"Error reading socket","INVALID_JSON");
+		
+		char *end = (char *)memchr(buf,'\n',re);
+		int len = end?end-buf+1:re;
+		
+		re = recv(s,buf,len,0);
+		if(re!=len)
+			throw Exception(context,"Error reading socket","INVALID_JSON");
+		
+		line.append(buf,end?len-1:len);
+		if(end)
+			return line;
+		
+		if(line.length()>max_size)
+			throw Exception(context,"JSON message is too big","INVALID_JSON");
+	}
+}
+
 // Build XML message from socket
-XMLMessage::XMLMessage(const string &context, int s)
+XMLMessage::XMLMessage(const string &context, int s, size_t max_size)
 {
 	this->context = context;
 	
-	xmldoc = new DOMDocument();
-	saxh.HandleQuery(s,xmldoc);
+	if(peek_char(s)=='[')
+	{
+		xmldoc = JsonML::Parse(read_line(context,s,max_size));
+		encoding = ENCODING_JSON;
+	}
+	else
+	{
+		xmldoc = new DOMDocument();
+		saxh.HandleQuery(s,xmldoc);
+	}
 	
 	init();
 }
@@ -39,9 +102,18 @@ XMLMessage::XMLMessage(const string &context, const string &xml)
 {
 	this->context = context;
 	
-	xmldoc = DOMDocument::Parse(xml);
-	if(!xmldoc)
-		throw Exception(context,"Invalid XML document","INVALID_XML");
+	size_t start = xml.find_first_not_of(" \n\r\t");
+	if(start!=string::npos && xml[start]=='[')
+	{
+		xmldoc = JsonML::Parse(xml);
+		encoding = ENCODING_JSON;
+	}
+	else
+	{
+		xmldoc = DOMDocument::Parse(xml);
+		if(!xmldoc)
+			throw Exception(context,"Invalid XML document","INVALID_XML");
+	}
 	
 	init();
 }
@@ -23,7 +23,7 @@
 
 using namespace std;
 
-XMLQuery::XMLQuery(const std::string &context, int s):XMLMessage(context,s)
+XMLQuery::XMLQuery(const std::string &context, int s, size_t max_size):XMLMessage(context,s,max_size)
 {
 }
 
@@ -99,7 +99,7 @@ void handle_connection(int s)
 		session.SendChallenge();
 		if(session.GetStatus()==APISession::en_status::WAITING_CHALLENGE_RESPONSE)
 		{
-			XMLQuery query("Authentication Handler",s);
+			XMLQuery query("Authentication Handler",s,XMLMESSAGE_JSON_MAXSIZE_UNAUTHENTICATED);
 			session.ChallengeReceived(&query);
 		}
 		
@@ -46,6 +46,8 @@ ConfigurationEvQueue::ConfigurationEvQueue(void)
 	entries["forker.pidfile"] = "/tmp/evqueue-forker.pid";
 	entries["dpd.interval"] = "10";
 	entries["queuepool.scheduler"] = "fifo";
+	entries["queuepool.weighted.horizon"] = "3600";
+	entries["queuepool.weighted.priority_step"] = "60";
 	entries["gc.delay"] = "2";
 	entries["gc.enable"] = "yes";
 	entries["gc.interval"] = "43200";
@@ -83,6 +85,13 @@ ConfigurationEvQueue::ConfigurationEvQueue(void)
 	entries["processmanager.monitor.ssh_key"] = "";
 	entries["processmanager.monitor.ssh_path"] = "/usr/bin/ssh";
 	entries["processmanager.agent.path"] = "/usr/bin/evqueue_agent";
+	entries["processmanager.agent.compress"] = "no";
+	entries["processmanager.progress.interval"] = "1000";
+	entries["processmanager.cgroup.enable"] = "no";
+	entries["processmanager.cgroup.path"] = "/sys/fs/cgroup/evqueue";
+	entries["processmanager.cgroup.memory.max"] = "";
+	entries["processmanager.cgroup.cpu.max"] = "";
+	entries["processmanager.cgroup.pids.max"] = "";
 	entries["processmanager.tasks.directory"] = ".";
 	entries["processmanager.scripts.directory"] = "/tmp";
 	entries["processmanager.scripts.delete"] = "yes";
@@ -124,6 +133,8 @@ void ConfigurationEvQueue::Check(void)
 	check_bool_entry("loggerapi.enable");
 	check_bool_entry("processmanager.logs.delete");
 	check_bool_entry("processmanager.scripts.delete");
+	check_bool_entry("processmanager.agent.compress");
+	check_bool_entry("processmanager.cgroup.enable");
 	check_bool_entry("notifications.logs.delete");
 	check_bool_entry("datastore.gzip.enable");
 	check_bool_entry("workflowinstance.saveparameters");
@@ -131,6 +142,9 @@ void ConfigurationEvQueue::Check(void)
 	check_bool_entry("cluster.notify");
 
 	check_int_entry("dpd.interval");
+	check_int_entry("processmanager.progress.interval");
+	check_int_entry("queuepool.weighted.horizon");
+	check_int_entry("queuepool.weighted.priority_step");
 	check_int_entry("gc.delay");
 	check_int_entry("gc.interval");
 	check_int_entry("gc.limit");
@@ -165,8 +179,8 @@ void ConfigurationEvQueue::Check(void)
 	if(GetInt("workflowinstance.savepoint.level")<0 || GetInt("workflowinstance.savepoint.level")>3)
 		throw Exception("Configuration","workflowinstance.savepoint.level: invalid value '"+entries["workflowinstance.savepoint.level"]+"'. Value must be between O and 3");
 
-	if(Get("queuepool.scheduler")!="fifo" && Get("queuepool.scheduler")!="prio")
-		throw Exception("Configuration","queuepool.scheduler: invalid value '"+entries["queuepool.scheduler"]+"'. Value muse be 'fifo' or 'prio'");
+	if(Get("queuepool.scheduler")!="fifo" && Get("queuepool.scheduler")!="prio" && Get("queuepool.scheduler")!="weighted")
+		throw Exception("Configuration","queuepool.scheduler: invalid value '"+entries["queuepool.scheduler"]+"'. Value muse be 'fifo', 'prio' or 'weighted'");
 }
 
 void ConfigurationEvQueue::SendConfiguration(QueryResponse *response)
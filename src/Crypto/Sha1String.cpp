@@ -35,6 +35,11 @@ Sha1String::Sha1String(const std::string &str)
 	ProcessBytes(str);
 }
 
+void Sha1String::Reset()
+{
+	sha1_init_ctx(&ctx);
+}
+
 void Sha1String::ProcessBytes(const std::string &str)
 {
 	sha1_process_bytes(str.c_str(),str.length(),&ctx);
@@ -60,6 +60,7 @@ DB::DB(DB *db)
 	transaction_started = 0;
 	is_connected = db->is_connected;
 	is_copy = true;
+	local_infile = db->local_infile;
 }
 
 DB::DB(const string &name, bool nodbselect)
@@ -253,9 +254,9 @@ long long DB::InsertIDLong(void)
 	return mysql_insert_id(mysql);
 }
 
-void DB::BulkStart(int bulk_id, const std::string &table, const std::string &columns, int ncolumns)
+void DB::BulkStart(int bulk_id, const std::string &table, const std::string &columns, int ncolumns, const std::string &on_duplicate)
 {
-	bulk_queries[bulk_id] = {table, columns, ncolumns};
+	bulk_queries[bulk_id] = {table, columns, ncolumns, on_duplicate};
 }
 
 void DB::BulkDataNULL(int bulk_id)
@@ -322,6 +323,9 @@ void DB::BulkExec(int bulk_id)
 		query += ")";
 	}
 	
+	if(bulk_query.on_duplicate!="")
+		query += " ON DUPLICATE KEY UPDATE "+bulk_query.on_duplicate;
+	
 	bulk_queries.erase(bulk_id);
 	if(nrows==0)
 		return;
@@ -329,6 +333,81 @@ void DB::BulkExec(int bulk_id)
 	Query(query.c_str());
 }
 
+void DB::EnableLocalInfile(void)
+{
+	if(is_connected)
+		throw Exception("DB","Local infile must be enabled before connecting");
+	
+	// Local infile is only served from memory by BulkLoad(), the server can never read client files
+	unsigned int enable = 1;
+	mysql_options(mysql, MYSQL_OPT_LOCAL_INFILE, &enable);
+	mysql_set_local_infile_handler(mysql, infile_init, infile_read, infile_end, infile_error, 0);
+	
+	local_infile = true;
+}
+
+void DB::BulkLoad(int bulk_id)
+{
+	const st_bulk_query &bulk_query = bulk_queries[bulk_id];
+	
+	if(!local_infile)
+	{
+		bulk_queries.erase(bulk_id);
+		throw Exception("DB","Local infile is not enabled on this connection");
+	}
+	
+	if(bulk_query.on_duplicate!="")
+	{
+		bulk_queries.erase(bulk_id);
+		throw Exception("DB","Bulk load does not support ON DUPLICATE KEY UPDATE");
+	}
+	
+	if(bulk_query.values.size()==0)
+	{
+		bulk_queries.erase(bulk_id);
+		return;
+	}
+	
+	connect();
+	
+	// Rows are serialized as the server reads them, no SQL statement is built
+	st_bulk_load load = {&bulk_query, 0, "", 0};
+	mysql_set_local_infile_handler(mysql, infile_init, infile_read, infile_end, infile_error, &load);
+	
+	try
+	{
+		// Bytes are stored as sent, like string values of INSERT queries, so binary columns are loaded unchanged
+		Query("LOAD DATA LOCAL INFILE 'bulk' INTO TABLE "+bulk_query.table+" CHARACTER SET binary ("+bulk_query.columns+")");
+	}
+	catch(Exception &e)
+	{
+		mysql_set_local_infile_handler(mysql, infile_init, infile_read, infile_end, infile_error, 0);
+		bulk_queries.erase(bulk_id);
+		throw e;
+	}
+	
+	mysql_set_local_infile_handler(mysql, infile_init, infile_read, infile_end, infile_error, 0);
+	
+	string table = bulk_query.table;
+	bulk_queries.erase(bulk_id);
+	
+	// LOAD DATA LOCAL turns conversion errors into warnings, fail as an INSERT would
+	unsigned int nwarnings = mysql_warning_count(mysql);
+	if(nwarnings>0)
+	{
+		string warning;
+		Query("SHOW WARNINGS LIMIT 1");
+		if(FetchRow())
+			warning = GetField(2);
+		Free();
+		
+		if(auto_rollback && transaction_started)
+			RollbackTransaction();
+		
+		throw Exception("DB","Bulk load into "+table+" raised "+to_string(nwarnings)+" warning(s) : "+warning,"SQL_ERROR");
+	}
+}
+
 bool DB::FetchRow(void)
 {
 	if(res==0)
@@ -488,6 +567,90 @@ int DB::TO_DAYS(const string &t)
 	return (long long)(difftime(end, start) / 86400);
 }
 
+int DB::infile_init(void **ptr, const char *filename, void *userdata)
+{
+	*ptr = userdata;
+	
+	// Only BulkLoad() provides data, any other LOAD DATA LOCAL request is refused
+	return userdata?0:1;
+}
+
+int DB::infile_read(void *ptr, char *buf, unsigned int buf_len)
+{
+	st_bulk_load *load = (st_bulk_load *)ptr;
+	const st_bulk_query *bulk_query = load->query;
+	const vector<st_bulk_value> &values = bulk_query->values;
+	
+	unsigned int len = 0;
+	while(len<buf_len)
+	{
+		if(load->buf_pos==load->buf.length())
+		{
+			if(load->value>=values.size())
+				break;
+			
+			// Serialize next row with the default LOAD DATA escaping
+			load->buf.clear();
+			load->buf_pos = 0;
+			for(int j=0;j<bulk_query->ncolumns && load->value<values.size();j++)
+			{
+				const st_bulk_value &v = values[load->value++];
+				
+				if(j>0)
+					load->buf += '\t';
+				
+				if(v.type==st_bulk_value::en_type::N)
+					load->buf += "\\N";
+				else if(v.type==st_bulk_value::en_type::INT)
+					load->buf += to_string(v.val_int);
+				else if(v.type==st_bulk_value::en_type::LONG)
+					load->buf += to_string(v.val_ll);
+				else if(v.type==st_bulk_value::en_type::STRING)
+				{
+					for(size_t k=0;k<v.val_str.length();k++)
+					{
+						char c = v.val_str[k];
+						if(c=='\\')
+							load->buf += "\\\\";
+						else if(c=='\t')
+							load->buf += "\\t";
+						else if(c=='\n')
+							load->buf += "\\n";
+						else if(c=='\r')
+							load->buf += "\\r";
+						else if(c=='\0')
+							load->buf += "\\0";
+						else
+							load->buf += c;
+					}
+				}
+			}
+			
+			load->buf += '\n';
+		}
+		
+		size_t n = load->buf.length()-load->buf_pos;
+		if(n>buf_len-len)
+			n = buf_len-len;
+		
+		memcpy(buf+len, load->buf.data()+load->buf_pos, n);
+		load->buf_pos += n;
+		len += n;
+	}
+	
+	return len;
+}
+
+void DB::infile_end(void *ptr)
+{
+}
+
+int DB::infile_error(void *ptr, char *error_msg, unsigned int error_msg_len)
+{
+	snprintf(error_msg, error_msg_len, "LOAD DATA LOCAL INFILE is only allowed for bulk loads");
+	return 2000; // CR_UNKNOWN_ERROR
+}
+
 void DB::connect(void)
 {
 	if(is_connected)
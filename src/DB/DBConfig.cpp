@@ -137,6 +137,15 @@ bool DBConfig::RegisterTablesInit(const string &name, map<string, string> &table
 	return true;
 }
 
+bool DBConfig::RegisterIndexes(const string &name, map<string, string> &indexes_def)
+{
+	// Indexes are named "table.index", definition is the list of columns
+	for(auto it = indexes_def.begin(); it!=indexes_def.end(); ++it)
+		indexes[name][it->first] = it->second;
+	
+	return true;
+}
+
 void DBConfig::InitTables()
 {
 	// Call all init handlers
@@ -173,4 +182,32 @@ void DBConfig::InitTables()
 			}
 		}
 	}
+	
+	// Add indexes missing on tables created by older versions
+	for(auto it_db = indexes.begin(); it_db!=indexes.end(); ++it_db)
+	{
+		DB db(it_db->first);
+		string database = db.GetDatabase();
+		
+		for(auto it_index=it_db->second.begin();it_index!=it_db->second.end();++it_index)
+		{
+			size_t dot = it_index->first.find('.');
+			string table = it_index->first.substr(0, dot);
+			string index = it_index->first.substr(dot+1);
+			
+			db.QueryPrintf(
+				"SELECT 1 FROM INFORMATION_SCHEMA.STATISTICS WHERE table_schema=%s AND table_name=%s AND index_name=%s", {
+				&database,
+				&table,
+				&index
+			});
+			
+			if(!db.FetchRow())
+			{
+				Logger::Log(LOG_NOTICE,it_db->first + " table " + table + " has no index " + index + ", creating it...");
+				
+				db.QueryPrintf("ALTER TABLE %c ADD KEY %c ("+it_index->second+")", {&table, &index});
+			}
+		}
+	}
 }
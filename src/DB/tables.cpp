@@ -148,7 +148,8 @@ map<string,string> evqueue_tables = {
   KEY `workflow_instance_date_end` (`workflow_instance_end`), \
   KEY `t_workflow_instance_errors` (`workflow_instance_errors`), \
   KEY `workflow_instance_date_start` (`workflow_instance_start`), \
-  KEY `workflow_schedule_id` (`workflow_schedule_id`) \
+  KEY `workflow_schedule_id` (`workflow_schedule_id`), \
+  KEY `workflow_instance_status_end_id` (`workflow_instance_status`,`workflow_instance_end`,`workflow_instance_id`) \
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8 COLLATE=utf8_unicode_ci COMMENT='v3.3'; \
 "},
 {"t_workflow_instance_parameters",
@@ -156,7 +157,8 @@ map<string,string> evqueue_tables = {
   `workflow_instance_id` int(10) unsigned NOT NULL, \
   `workflow_instance_parameter` varchar(64) COLLATE utf8_unicode_ci NOT NULL, \
   `workflow_instance_parameter_value` text COLLATE utf8_unicode_ci NOT NULL, \
-  KEY `param_and_value` (`workflow_instance_parameter`,`workflow_instance_parameter_value`(255)) \
+  KEY `param_and_value` (`workflow_instance_parameter`,`workflow_instance_parameter_value`(255)), \
+  KEY `workflow_instance_id` (`workflow_instance_id`,`workflow_instance_parameter`) \
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8 COLLATE=utf8_unicode_ci COMMENT='v3.3'; \
 "},
 {"t_workflow_notification",
@@ -251,10 +253,20 @@ map<string,string> evqueue_tables = {
   `workflow_instance_id` int(10) unsigned NOT NULL, \
   `workflow_instance_filter` varchar(64) CHARACTER SET utf8 NOT NULL, \
   `workflow_instance_filter_value` varchar(255) CHARACTER SET utf8 NOT NULL, \
-  KEY `workflow_instance_filter` (`workflow_instance_filter`,`workflow_instance_filter_value`) \
+  KEY `workflow_instance_filter` (`workflow_instance_filter`,`workflow_instance_filter_value`), \
+  KEY `workflow_instance_id` (`workflow_instance_id`,`workflow_instance_filter`) \
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8 COLLATE=utf8_unicode_ci COMMENT='v3.3'; \
 "},
 };
 
 static auto init = DBConfig::GetInstance()->RegisterTables("evqueue", evqueue_tables);
 static auto initq = DBConfig::GetInstance()->RegisterTablesInit("evqueue", evqueue_query);
+
+// Indexes added after tables creation, they are created on existing databases
+static map<string, string> evqueue_indexes = {
+	{"t_workflow_instance.workflow_instance_status_end_id", "`workflow_instance_status`,`workflow_instance_end`,`workflow_instance_id`"},
+	{"t_workflow_instance_parameters.workflow_instance_id", "`workflow_instance_id`,`workflow_instance_parameter`"},
+	{"t_workflow_instance_filters.workflow_instance_id", "`workflow_instance_id`,`workflow_instance_filter`"}
+};
+
+static auto initi = DBConfig::GetInstance()->RegisterIndexes("evqueue", evqueue_indexes);
@@ -22,33 +22,83 @@
 #include <DOM/DOMXPathResult.h>
 #include <DOM/DOMElement.h>
 #include <DOM/DOMText.h>
+#include <DOM/DOMSerializer.h>
 #include <Exception/Exception.h>
 #include <XML/XMLString.h>
-#include <Logger/Logger.h>
 
-#include <regex>
 #include <memory>
 
 using namespace std;
 
+#ifdef USE_NATIVE_DOM
+
+DOMDocument::DOMDocument(void)
+{
+	xmldoc = new NativeDocument();
+	xmldoc->wrapper = this;
+	xpath = new DOMXPath(this);
+	
+	this->node = xmldoc;
+}
+
+DOMDocument::DOMDocument(NativeDocument *xmldoc):DOMNode(xmldoc)
+{
+	this->xmldoc = xmldoc;
+	if(xmldoc)
+		xmldoc->wrapper = this;
+	xpath = new DOMXPath(this);
+}
+
+DOMDocument::~DOMDocument(void)
+{
+	if(xpath)
+		delete xpath;
+	
+	if(xmldoc)
+		delete xmldoc;
+}
+
+DOMDocument *DOMDocument::Parse(const string &xml_str)
+{
+	NativeDocument *xmldoc = NativeDocument::Parse(xml_str);
+	if(!xmldoc)
+		return 0;
+	
+	return new DOMDocument(xmldoc);
+}
+
+DOMDocument *DOMDocument::ParseFile(const string &filename)
+{
+	NativeDocument *xmldoc = NativeDocument::ParseFile(filename);
+	if(!xmldoc)
+		return 0;
+	
+	return new DOMDocument(xmldoc);
+}
+
+#else
+
+// User data key linking xerces documents to their wrapper
+static const XMLCh DOMDOCUMENT_USERDATA_KEY[] = {'e','v','q','u','e','u','e',0};
+
 DOMDocument::DOMDocument(void)
 {
 	xercesc::DOMImplementation *xercesImplementation = xercesc::DOMImplementationRegistry::getDOMImplementation(XMLString(""));
 	xmldoc = xercesImplementation->createDocument();
+	xmldoc->setUserData(DOMDOCUMENT_USERDATA_KEY,this,0);
 	xpath = new DOMXPath(this);
 	parser = 0;
-	serializer = xercesImplementation->createLSSerializer();
 	
 	this->node = (xercesc::DOMNode *)xmldoc;
 }
 
 DOMDocument::DOMDocument(xercesc::DOMDocument *xmldoc):DOMNode(xmldoc)
 {
-	xercesc::DOMImplementation *xercesImplementation = xercesc::DOMImplementationRegistry::getDOMImplementation(XMLString(""));
 	this->xmldoc = xmldoc;
+	if(xmldoc)
+		xmldoc->setUserData(DOMDOCUMENT_USERDATA_KEY,this,0);
 	xpath = new DOMXPath(this);
 	parser = 0;
-	serializer = xmldoc?xercesImplementation->createLSSerializer():0;
 }
 
 DOMDocument::~DOMDocument(void)
@@ -63,9 +113,6 @@ DOMDocument::~DOMDocument(void)
 	// Releaseing parser will free xmldoc for parsed documents
 	if(parser)
 		parser->release();
-
-	if(serializer)
-		serializer->release();
 }
 
 DOMDocument *DOMDocument::Parse(const string &xml_str)
@@ -74,7 +121,6 @@ DOMDocument *DOMDocument::Parse(const string &xml_str)
 	
 	xercesc::DOMImplementation *xercesImplementation = xercesc::DOMImplementationRegistry::getDOMImplementation(XMLString(""));
 	doc->parser = xercesImplementation->createLSParser(xercesc::DOMImplementationLS::MODE_SYNCHRONOUS,0);
-	doc->serializer = xercesImplementation->createLSSerializer();
 
 	xercesc::DOMLSInput *input = xercesImplementation->createLSInput();
 
@@ -96,6 +142,8 @@ DOMDocument *DOMDocument::Parse(const string &xml_str)
 		return 0;
 	}
 	
+	doc->xmldoc->setUserData(DOMDOCUMENT_USERDATA_KEY,doc,0);
+	
 	return doc;
 }
 
@@ -105,7 +153,6 @@ DOMDocument *DOMDocument::ParseFile(const string &filename)
 	
 	xercesc::DOMImplementation *xercesImplementation = xercesc::DOMImplementationRegistry::getDOMImplementation(XMLString(""));
 	doc->parser = xercesImplementation->createLSParser(xercesc::DOMImplementationLS::MODE_SYNCHRONOUS,0);
-	doc->serializer = xercesImplementation->createLSSerializer();
 	
 	// Load XML from file
 	XMLCh *xfilename = xercesc::XMLString::transcode(filename.c_str());
@@ -127,54 +174,54 @@ DOMDocument *DOMDocument::ParseFile(const string &filename)
 		return 0;
 	}
 	
+	doc->xmldoc->setUserData(DOMDOCUMENT_USERDATA_KEY,doc,0);
+	
 	return doc;
 }
 
+#endif
+
 string DOMDocument::Serialize(DOMNode node) const
 {
-	XMLCh *xml_output = serializer->writeToString(node.node);
-	char *xml_output_c = xercesc::XMLString::transcode(xml_output);
-	
-	if(!xml_output || !xml_output_c)
-	{
-#ifdef BUILD_MODULE_EVQUEUE_CORE
-		Logger::Log(LOG_ERR, "Unable to serialize XML document, document might contain invalid UTF8 character");
-#endif
-		
-		throw Exception("DOMDocument", "Unable to serialize XML document");
-	}
-	
-	string s(xml_output_c);
-	
-	xercesc::XMLString::release(&xml_output);
-	xercesc::XMLString::release(&xml_output_c);
+	// Documents are often serialized several times (savepoints), reuse previous size
+	string s;
+	s.reserve(serialize_size_hint);
+	DOMSerializer::Serialize(node,s);
+	serialize_size_hint = s.length();
 	
 	return s;
 }
 
+void DOMDocument::Serialize(DOMNode node,string &output) const
+{
+	DOMSerializer::Serialize(node,output);
+}
+
 string DOMDocument::ExpandXPathAttribute(const string &attribute,DOMNode context_node)
 {
-	string attribute_expanded = attribute;
+	if(attribute.find('{')==string::npos)
+		return attribute;
 	
-	regex attr_regex("(\\{[^\\}]+\\})");
+	// Templates are tokenized once, then only evaluated
+	auto it = attribute_templates.find(attribute);
+	if(it==attribute_templates.end())
+		it = attribute_templates.insert(pair<string,vector<st_attribute_segment>>(attribute,compile_attribute(attribute))).first;
 	
-	auto words_begin = sregex_iterator(attribute.begin(), attribute.end(), attr_regex);
-	auto words_end = sregex_iterator();
-	for(auto i=words_begin;i!=words_end;++i)
+	string attribute_expanded;
+	const vector<st_attribute_segment> &segments = it->second;
+	for(size_t i=0;i<segments.size();i++)
 	{
-		string xpath_piece_raw = i->str();
-		string xpath_piece =  xpath_piece_raw.substr(1,xpath_piece_raw.length()-2);
-		
-		unique_ptr<DOMXPathResult> value_nodes(evaluate(xpath_piece,context_node,DOMXPathResult::FIRST_RESULT_TYPE));
-		if(value_nodes->isNode())
+		if(!segments[i].expr)
 		{
-			DOMNode value_node = value_nodes->getNodeValue();
-			
-			size_t start_pos = attribute_expanded.find(xpath_piece_raw);
-			
-			string expanded_value = value_node.getTextContent();
-			attribute_expanded.replace(start_pos,xpath_piece_raw.length(),expanded_value);
+			attribute_expanded += segments[i].text;
+			continue;
 		}
+		
+		unique_ptr<DOMXPathResult> value_nodes(evaluate(segments[i],context_node,DOMXPathResult::FIRST_RESULT_TYPE));
+		if(value_nodes->isNode())
+			attribute_expanded += value_nodes->getNodeValue().getTextContent();
+		else
+			attribute_expanded += "{"+segments[i].text+"}";
 	}
 	
 	return attribute_expanded;
@@ -192,12 +239,20 @@ DOMXPath *DOMDocument::getXPath()
 
 DOMElement DOMDocument::createElement(const string &name)
 {
+#ifdef USE_NATIVE_DOM
+	return xmldoc->createElement(name);
+#else
 	return xmldoc->createElement(XMLString(name.c_str()));
+#endif
 }
 
 DOMText DOMDocument::createTextNode(const string &data)
 {
+#ifdef USE_NATIVE_DOM
+	return xmldoc->createTextNode(data);
+#else
 	return xmldoc->createTextNode(XMLString(data.c_str()));
+#endif
 }
 
 DOMNode DOMDocument::importNode(DOMNode importedNode, bool deep)
@@ -318,6 +373,94 @@ void DOMDocument::ImportXPathResult(DOMXPathResult *res, DOMNode node)
 		node.appendChild(createTextNode("unknown"));
 }
 
+void DOMDocument::RegisterIndex(const string &element_name,const string &attribute_name)
+{
+	pair<string,string> key(element_name,attribute_name);
+	if(indexes.find(key)!=indexes.end())
+		return;
+	
+	// Index is built on first lookup
+	indexes[key] = st_index();
+	indexed_attributes.insert(pair<string,string>(attribute_name,element_name));
+}
+
+bool DOMDocument::HasIndex(const string &element_name,const string &attribute_name) const
+{
+	return indexes.find(pair<string,string>(element_name,attribute_name))!=indexes.end();
+}
+
+bool DOMDocument::LookupIndex(const string &element_name,const string &attribute_name,const string &value,vector<DOMElement> &result)
+{
+	auto it = indexes.find(pair<string,string>(element_name,attribute_name));
+	if(it==indexes.end())
+		return false;
+	
+	st_index &index = it->second;
+	if(!index.built)
+		build_index(element_name,attribute_name,index);
+	
+	auto it_value = index.values.find(value);
+	if(it_value!=index.values.end())
+	{
+		for(auto it_element=it_value->second.begin();it_element!=it_value->second.end();++it_element)
+			result.push_back(DOMElement(*it_element));
+	}
+	
+	return true;
+}
+
+vector<DOMDocument::st_attribute_segment> DOMDocument::compile_attribute(const string &attribute)
+{
+	vector<st_attribute_segment> segments;
+	
+	size_t start = 0, pos = 0;
+	while((pos = attribute.find('{',pos))!=string::npos)
+	{
+		size_t end = attribute.find('}',pos+1);
+		if(end==string::npos)
+			break;
+		
+		if(end==pos+1)
+		{
+			// Empty braces are literal text
+			pos++;
+			continue;
+		}
+		
+		if(pos>start)
+			segments.push_back({attribute.substr(start,pos-start),0});
+		
+		string xpath_piece = attribute.substr(pos+1,end-pos-1);
+		try
+		{
+			segments.push_back({xpath_piece,shared_ptr<TokenExpr>(xpath->compile(xpath_piece))});
+		}
+		catch(Exception &e)
+		{
+			throw Exception("DOMDocument","XPath expression error in '"+xpath_piece+"'. XPath returned error : "+e.error+" ("+e.context+")");
+		}
+		
+		start = pos = end+1;
+	}
+	
+	if(start<attribute.length())
+		segments.push_back({attribute.substr(start),0});
+	
+	return segments;
+}
+
+DOMXPathResult *DOMDocument::evaluate(const st_attribute_segment &segment,DOMNode node,DOMXPathResult::ResultType result_type)
+{
+	try
+	{
+		return xpath->evaluate(segment.expr.get(),node,result_type);
+	}
+	catch(Exception &e)
+	{
+		throw Exception("DOMDocument","XPath expression error in '"+segment.text+"'. XPath returned error : "+e.error+" ("+e.context+")");
+	}
+}
+
 void DOMDocument::initialize_evqid()
 {
 	current_id = 0;
@@ -345,3 +488,149 @@ void DOMDocument::initialize_evqid()
 		throw Exception("DOMDocument","Invalid evqid found");
 	}
 }
+
+DOMDocument *DOMDocument::get_document(dom_node_t *node)
+{
+	if(!node)
+		return 0;
+	
+#ifdef USE_NATIVE_DOM
+	NativeDocument *doc = node->getNodeType()==DOCUMENT_NODE?(NativeDocument *)node:node->getOwnerDocument();
+	if(!doc)
+		return 0;
+	
+	return doc->wrapper;
+#else
+	xercesc::DOMNode *doc = node->getNodeType()==DOCUMENT_NODE?node:node->getOwnerDocument();
+	if(!doc)
+		return 0;
+	
+	return (DOMDocument *)doc->getUserData(DOMDOCUMENT_USERDATA_KEY);
+#endif
+}
+
+bool DOMDocument::is_attached(dom_node_t *node) const
+{
+	while(node->getParentNode())
+		node = node->getParentNode();
+	
+	return node==xmldoc;
+}
+
+void DOMDocument::build_index(const string &element_name,const string &attribute_name,st_index &index)
+{
+	index.values.clear();
+	
+	dom_node_t *node = xmldoc->getDocumentElement();
+	while(node)
+	{
+		if(node->getNodeType()==ELEMENT_NODE)
+		{
+			DOMElement element((dom_element_t *)node);
+			if(element.getNodeName()==element_name && element.hasAttribute(attribute_name))
+				index.values[element.getAttribute(attribute_name)].insert((dom_element_t *)node);
+		}
+		
+		// Depth first walk of the document
+		if(node->getFirstChild())
+			node = node->getFirstChild();
+		else
+		{
+			while(node && !node->getNextSibling())
+				node = node->getParentNode();
+			if(node)
+				node = node->getNextSibling();
+		}
+	}
+	
+	index.built = true;
+}
+
+void DOMDocument::index_attribute(dom_element_t *element,const string &name,const string *value)
+{
+	auto range = indexed_attributes.equal_range(name);
+	if(range.first==range.second)
+		return;
+	
+	DOMElement node(element);
+	string element_name = node.getNodeName();
+	for(auto it=range.first;it!=range.second;++it)
+	{
+		if(it->second!=element_name)
+			continue;
+		
+		st_index &index = indexes[pair<string,string>(element_name,name)];
+		if(!index.built || !is_attached(element))
+			continue;
+		
+		if(node.hasAttribute(name))
+		{
+			auto it_value = index.values.find(node.getAttribute(name));
+			if(it_value!=index.values.end())
+			{
+				it_value->second.erase(element);
+				if(it_value->second.size()==0)
+					index.values.erase(it_value);
+			}
+		}
+		
+		if(value)
+			index.values[*value].insert(element);
+	}
+}
+
+void DOMDocument::index_subtree(dom_node_t *parent,dom_node_t *child,bool add)
+{
+	// Only elements are indexed, text nodes can be added or removed freely
+	if(child->getNodeType()!=ELEMENT_NODE)
+		return;
+	
+	// Indexes that are not built yet will see the subtree when they are
+	bool has_built_index = false;
+	for(auto it=indexes.begin();it!=indexes.end() && !has_built_index;++it)
+		has_built_index = it->second.built;
+	
+	if(!has_built_index || !is_attached(parent))
+		return;
+	
+	// Only the inserted or removed subtree is walked, its size is the cost of building or releasing it anyway
+	dom_node_t *node = child;
+	while(node)
+	{
+		if(node->getNodeType()==ELEMENT_NODE)
+		{
+			DOMElement element((dom_element_t *)node);
+			string element_name = element.getNodeName();
+			for(auto it=indexes.lower_bound(pair<string,string>(element_name,""));it!=indexes.end() && it->first.first==element_name;++it)
+			{
+				st_index &index = it->second;
+				if(!index.built || !element.hasAttribute(it->first.second))
+					continue;
+				
+				string value = element.getAttribute(it->first.second);
+				if(add)
+					index.values[value].insert((dom_element_t *)node);
+				else
+				{
+					auto it_value = index.values.find(value);
+					if(it_value!=index.values.end())
+					{
+						it_value->second.erase((dom_element_t *)node);
+						if(it_value->second.size()==0)
+							index.values.erase(it_value);
+					}
+				}
+			}
+		}
+		
+		// Depth first walk of the subtree
+		if(node->getFirstChild())
+			node = node->getFirstChild();
+		else
+		{
+			while(node!=child && !node->getNextSibling())
+				node = node->getParentNode();
+			node = node==child?0:node->getNextSibling();
+		}
+	}
+}
@@ -18,6 +18,7 @@
  */
 
 #include <DOM/DOMElement.h>
+#include <DOM/DOMDocument.h>
 #include <XML/XMLString.h>
 
 using namespace std;
@@ -27,41 +28,69 @@ DOMElement::DOMElement()
 	this->element = 0;
 }
 
-DOMElement::DOMElement(xercesc::DOMElement *element):DOMNode(element)
+DOMElement::DOMElement(dom_element_t *element):DOMNode(element)
 {
 	this->element = element;
 }
 
 DOMElement::DOMElement(DOMNode node):DOMNode(node.node)
 {
-	this->element = (xercesc::DOMElement *)node.node;
+	this->element = (dom_element_t *)node.node;
 }
 
 bool DOMElement::hasAttribute(const string &name) const
 {
+#ifdef USE_NATIVE_DOM
+	return element->hasAttribute(name);
+#else
 	return element->hasAttribute(XMLString(name));
+#endif
 }
 
 string DOMElement::getAttribute(const string &name) const
 {
+#ifdef USE_NATIVE_DOM
+	return element->getAttribute(name);
+#else
 	char *str = xercesc::XMLString::transcode(element->getAttribute(XMLString(name)));
 	string s(str);
 	xercesc::XMLString::release(&str);
 	
 	return s;
+#endif
 }
 
 DOMNode DOMElement::getAttributeNode(const string &name) const
 {
+#ifdef USE_NATIVE_DOM
+	return element->getAttributeNode(name);
+#else
 	return element->getAttributeNode(XMLString(name));
+#endif
 }
 
 void DOMElement::setAttribute(const string &name, const string &value)
 {
+	DOMDocument *doc = DOMDocument::get_document(element);
+	if(doc)
+		doc->index_attribute(element,name,&value);
+	
+#ifdef USE_NATIVE_DOM
+	element->setAttribute(name,value);
+#else
 	element->setAttribute(XMLString(name),XMLString(value));
+#endif
 }
 
 void DOMElement::removeAttribute(const string &name)
 {
+	DOMDocument *doc = DOMDocument::get_document(element);
+	if(doc)
+		doc->index_attribute(element,name,0);
+	
+#ifdef USE_NATIVE_DOM
+	element->removeAttribute(name);
+#else
 	element->removeAttribute(XMLString(name));
+#endif
 }
\ No newline at end of file
@@ -20,7 +20,7 @@
 #include <DOM/DOMNamedNodeMap.h>
 #include <DOM/DOMNode.h>
 
-DOMNamedNodeMap::DOMNamedNodeMap(xercesc::DOMNamedNodeMap *map)
+DOMNamedNodeMap::DOMNamedNodeMap(dom_named_node_map_t *map)
 {
 	this->map = map;
 }
@@ -19,6 +19,7 @@
 
 #include <DOM/DOMNode.h>
 #include <DOM/DOMElement.h>
+#include <DOM/DOMDocument.h>
 #include <DOM/DOMNamedNodeMap.h>
 #include <XML/XMLString.h>
 
@@ -29,7 +30,7 @@ DOMNode::DOMNode()
 	this->node = 0;
 }
 
-DOMNode::DOMNode(xercesc::DOMNode *node)
+DOMNode::DOMNode(dom_node_t *node)
 {
 	this->node = node;
 }
@@ -61,36 +62,66 @@ DOMNode DOMNode::getNextSibling()
 
 DOMNode DOMNode::appendChild(DOMNode newChild)
 {
-	return node->appendChild(newChild.node);
+	DOMNode ret = node->appendChild(newChild.node);
+	
+	DOMDocument *doc = DOMDocument::get_document(node);
+	if(doc)
+		doc->index_subtree(node,newChild.node,true);
+	
+	return ret;
 }
 
 DOMNode DOMNode::removeChild(DOMNode oldChild)
 {
+	DOMDocument *doc = DOMDocument::get_document(node);
+	if(doc)
+		doc->index_subtree(node,oldChild.node,false);
+	
 	return node->removeChild(oldChild.node);
 }
 
 void DOMNode::replaceChild(DOMNode newChild,DOMNode oldChild)
 {
+	DOMDocument *doc = DOMDocument::get_document(node);
+	if(doc)
+		doc->index_subtree(node,oldChild.node,false);
+	
 	node->replaceChild(newChild.node,oldChild.node);
 	oldChild.node->release();
+	
+	if(doc)
+		doc->index_subtree(node,newChild.node,true);
 }
 
 DOMNode DOMNode::insertBefore(DOMNode newChild, DOMNode refChild)
 {
-	return node->insertBefore(newChild.node,refChild.node);
+	DOMNode ret = node->insertBefore(newChild.node,refChild.node);
+	
+	DOMDocument *doc = DOMDocument::get_document(node);
+	if(doc)
+		doc->index_subtree(node,newChild.node,true);
+	
+	return ret;
 }
 
 string DOMNode::getNodeName()
 {
+#ifdef USE_NATIVE_DOM
+	return node->getNodeName();
+#else
 	char *str = xercesc::XMLString::transcode(node->getNodeName());
 	string s(str);
 	xercesc::XMLString::release(&str);
 	
 	return s;
+#endif
 }
 
 string DOMNode::getNodeValue()
 {
+#ifdef USE_NATIVE_DOM
+	return node->getNodeValue();
+#else
 	char *str = xercesc::XMLString::transcode(node->getNodeValue());
 	if(!str)
 		str = xercesc::XMLString::transcode(node->getTextContent());
@@ -102,6 +133,7 @@ string DOMNode::getNodeValue()
 	xercesc::XMLString::release(&str);
 	
 	return s;
+#endif
 }
 
 DOMNode::NodeType DOMNode::getNodeType()
@@ -111,26 +143,51 @@ DOMNode::NodeType DOMNode::getNodeType()
 
 string DOMNode::getTextContent()
 {
+#ifdef USE_NATIVE_DOM
+	return node->getTextContent();
+#else
 	char *str = xercesc::XMLString::transcode(node->getTextContent());
 	string s(str);
 	xercesc::XMLString::release(&str);
 	
 	return s;
+#endif
 }
 
 void DOMNode::setTextContent(const string &textContent)
 {
+	// Child elements are replaced by text
+	DOMDocument *doc = DOMDocument::get_document(node);
+	if(doc)
+	{
+		for(dom_node_t *child = node->getFirstChild();child;child = child->getNextSibling())
+			doc->index_subtree(node,child,false);
+	}
+	
+#ifdef USE_NATIVE_DOM
+	node->setTextContent(textContent);
+#else
 	node->setTextContent(XMLString(textContent));
+#endif
 }
 
 DOMNamedNodeMap DOMNode::getAttributes()
 {
+#ifdef USE_NATIVE_DOM
+	return node->getNodeType()==ELEMENT_NODE?(NativeElement *)node:0;
+#else
 	return node->getAttributes();
+#endif
 }
 
 DOMElement DOMNode::getOwnerElement()
 {
-	return ((xercesc::DOMAttr *)node)->getOwnerElement();
+	return ((dom_attr_t *)node)->getOwnerElement();
+}
+
+bool DOMNode::isSameNode(DOMNode other) const
+{
+	return node==other.node;
 }
 
 DOMNode::operator bool() const
@@ -0,0 +1,175 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#include <DOM/DOMSerializer.h>
+#include <DOM/DOMNamedNodeMap.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Return position of the first character that must be escaped, or length if there is none
+size_t DOMSerializer::find_escape(const char *str,size_t length,bool attribute)
+{
+	size_t i = 0;
+	
+#ifdef __SSE2__
+	// Check 16 bytes at a time, most strings have nothing to escape
+	const __m128i amp = _mm_set1_epi8('&');
+	const __m128i lt = _mm_set1_epi8('<');
+	const __m128i gt = _mm_set1_epi8(attribute?'"':'>');
+	const __m128i lf = _mm_set1_epi8(attribute?'\n':'&');
+	const __m128i cr = _mm_set1_epi8(attribute?'\r':'&');
+	const __m128i tab = _mm_set1_epi8(attribute?'\t':'&');
+	
+	for(;i+16<=length;i+=16)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i *)(str+i));
+		__m128i match = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk,amp),_mm_cmpeq_epi8(chunk,lt)),
+			_mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(chunk,gt),_mm_cmpeq_epi8(chunk,lf)),
+				_mm_or_si128(_mm_cmpeq_epi8(chunk,cr),_mm_cmpeq_epi8(chunk,tab))));
+		
+		int mask = _mm_movemask_epi8(match);
+		if(mask)
+			return i+__builtin_ctz(mask);
+	}
+#endif
+	
+	for(;i<length;i++)
+	{
+		char c = str[i];
+		if(c=='&' || c=='<')
+			return i;
+		
+		if(attribute && (c=='"' || c=='\n' || c=='\r' || c=='\t'))
+			return i;
+		
+		if(!attribute && c=='>')
+			return i;
+	}
+	
+	return length;
+}
+
+// Text uses &, < and > escapes, attributes use &, <, " and character references for new lines and tabs
+void DOMSerializer::escape(const string &str,bool attribute,string &output)
+{
+	const char *data = str.c_str();
+	size_t length = str.length();
+	size_t start = 0;
+	
+	while(start<length)
+	{
+		size_t pos = start+find_escape(data+start,length-start,attribute);
+		output.append(data+start,pos-start);
+		if(pos==length)
+			break;
+		
+		switch(data[pos])
+		{
+			case '&': output.append("&amp;"); break;
+			case '<': output.append("&lt;"); break;
+			case '>': output.append("&gt;"); break;
+			case '"': output.append("&quot;"); break;
+			case '\n': output.append("&#xA;"); break;
+			case '\r': output.append("&#xD;"); break;
+			case '\t': output.append("&#x9;"); break;
+		}
+		
+		start = pos+1;
+	}
+}
+
+void DOMSerializer::serialize(DOMNode node,string &output)
+{
+	switch(node.getNodeType())
+	{
+		case DOMNode::ELEMENT_NODE:
+		{
+			string name = node.getNodeName();
+			
+			output += '<';
+			output += name;
+			
+			DOMNamedNodeMap attributes = node.getAttributes();
+			for(int i=0;i<attributes.getLength();i++)
+			{
+				DOMNode attribute = attributes.item(i);
+				output += ' ';
+				output += attribute.getNodeName();
+				output += "=\"";
+				escape(attribute.getNodeValue(),true,output);
+				output += '"';
+			}
+			
+			DOMNode child = node.getFirstChild();
+			if(!child)
+			{
+				output += "/>";
+				break;
+			}
+			
+			output += '>';
+			for(;child;child=child.getNextSibling())
+				serialize(child,output);
+			output += "</";
+			output += name;
+			output += '>';
+			break;
+		}
+		
+		case DOMNode::ATTRIBUTE_NODE:
+			escape(node.getNodeValue(),true,output);
+			break;
+		
+		case DOMNode::TEXT_NODE:
+			escape(node.getNodeValue(),false,output);
+			break;
+		
+		case DOMNode::CDATA_SECTION_NODE:
+			output += "<![CDATA[";
+			output += node.getNodeValue();
+			output += "]]>";
+			break;
+		
+		case DOMNode::COMMENT_NODE:
+			output += "<!--";
+			output += node.getNodeValue();
+			output += "-->";
+			break;
+		
+		case DOMNode::DOCUMENT_NODE:
+			for(DOMNode child=node.getFirstChild();child;child=child.getNextSibling())
+				serialize(child,output);
+			break;
+		
+		default:
+			break;
+	}
+}
+
+void DOMSerializer::Serialize(DOMNode node,string &output)
+{
+	serialize(node,output);
+}
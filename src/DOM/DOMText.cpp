@@ -25,12 +25,16 @@ DOMText::DOMText()
 	this->text = 0;
 }
 
-DOMText::DOMText(xercesc::DOMText *text):DOMNode(text)
+DOMText::DOMText(dom_text_t *text):DOMNode(text)
 {
 	this->text = text;
 }
 
 void DOMText::appendData(const std::string str)
 {
+#ifdef USE_NATIVE_DOM
+	this->text->appendData(str);
+#else
 	this->text->appendData(XMLString(str));
+#endif
 }
\ No newline at end of file
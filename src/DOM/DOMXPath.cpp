@@ -27,15 +27,28 @@ DOMXPath::DOMXPath(DOMDocument *xmldoc):eval(xmldoc)
 	this->xmldoc = xmldoc;
 }
 
-void DOMXPath::RegisterFunction(std::string name,XPathEval::func_desc f)
+void DOMXPath::SetCustomContext(void *custom_context)
 {
-	eval.RegisterFunction(name,f);
+	eval.SetCustomContext(custom_context);
+}
+
+TokenExpr *DOMXPath::compile(const std::string &xpath)
+{
+	return eval.Compile(xpath);
 }
 
 DOMXPathResult *DOMXPath::evaluate(const std::string &xpath,DOMNode node,DOMXPathResult::ResultType result_type)
 {
-	Token *result = eval.Evaluate(xpath,node);
-	
+	return make_result(eval.Evaluate(xpath,node),result_type);
+}
+
+DOMXPathResult *DOMXPath::evaluate(const TokenExpr *expr,DOMNode node,DOMXPathResult::ResultType result_type)
+{
+	return make_result(eval.Evaluate(expr,node),result_type);
+}
+
+DOMXPathResult *DOMXPath::make_result(Token *result,DOMXPathResult::ResultType result_type)
+{
 	if(result_type==DOMXPathResult::FIRST_RESULT_TYPE)
 	{
 		DOMXPathResult *res = new DOMXPathResult(result);
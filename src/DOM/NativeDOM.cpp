@@ -0,0 +1,516 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#include <DOM/NativeDOM.h>
+#include <DOM/DOMNode.h>
+#include <Exception/Exception.h>
+#include <XML/XMLString.h>
+
+#include <xercesc/sax2/Attributes.hpp>
+#include <xercesc/sax2/SAX2XMLReader.hpp>
+#include <xercesc/sax2/XMLReaderFactory.hpp>
+#include <xercesc/sax2/DefaultHandler.hpp>
+#include <xercesc/framework/MemBufInputSource.hpp>
+#include <xercesc/framework/LocalFileInputSource.hpp>
+
+#include <string.h>
+
+#include <memory>
+
+using namespace std;
+
+static const string name_document = "#document";
+static const string name_text = "#text";
+static const string name_cdata = "#cdata-section";
+static const string name_comment = "#comment";
+static const string empty_string;
+
+// Build a native document from SAX2 events
+class NativeSAX2Handler:public xercesc::DefaultHandler
+{
+	NativeDocument *doc;
+	NativeNode *current;
+	bool in_cdata = false;
+	
+	static string transcode(const XMLCh *const chars, const XMLSize_t length)
+	{
+		XMLCh *chars_nt = new XMLCh[length+1];
+		memcpy(chars_nt,chars,length*sizeof(XMLCh));
+		chars_nt[length] = 0;
+		
+		string str = XMLString(chars_nt);
+		
+		delete[] chars_nt;
+		return str;
+	}
+	
+	void add_text(short type, const string &data)
+	{
+		// Consecutive chunks are merged in the same node
+		NativeNode *last = current->getLastChild();
+		if(type!=DOMNode::COMMENT_NODE && last && last->getNodeType()==type)
+			((NativeText *)last)->appendData(data);
+		else
+			current->appendChild(doc->createNode(type,data));
+	}
+	
+	public:
+		NativeSAX2Handler(NativeDocument *doc)
+		{
+			this->doc = doc;
+			current = doc;
+		}
+		
+		void startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname, const xercesc::Attributes& attrs)
+		{
+			NativeElement *element = doc->createElement(XMLString(qname));
+			
+			for(int i=0;i<attrs.getLength();i++)
+				element->setAttribute(XMLString(attrs.getQName(i)),XMLString(attrs.getValue(i)));
+			
+			current->appendChild(element);
+			current = element;
+		}
+		
+		void endElement(const XMLCh *const uri, const XMLCh *const localname, const XMLCh *const qname)
+		{
+			current = current->getParentNode();
+		}
+		
+		void characters(const XMLCh *const chars, const XMLSize_t length)
+		{
+			if(current!=doc)
+				add_text(in_cdata?DOMNode::CDATA_SECTION_NODE:DOMNode::TEXT_NODE,transcode(chars,length));
+		}
+		
+		void ignorableWhitespace(const XMLCh *const chars, const XMLSize_t length)
+		{
+			characters(chars,length);
+		}
+		
+		void comment(const XMLCh *const chars, const XMLSize_t length)
+		{
+			add_text(DOMNode::COMMENT_NODE,transcode(chars,length));
+		}
+		
+		void startCDATA()
+		{
+			in_cdata = true;
+		}
+		
+		void endCDATA()
+		{
+			in_cdata = false;
+		}
+};
+
+static NativeDocument *parse(const xercesc::InputSource &source)
+{
+	unique_ptr<xercesc::SAX2XMLReader> parser(xercesc::XMLReaderFactory::createXMLReader());
+	parser->setFeature(xercesc::XMLUni::fgSAX2CoreValidation, false);
+	parser->setFeature(xercesc::XMLUni::fgSAX2CoreNameSpaces, true);
+	parser->setFeature(xercesc::XMLUni::fgSAX2CoreNameSpacePrefixes, true);
+	
+	NativeDocument *doc = new NativeDocument();
+	NativeSAX2Handler handler(doc);
+	parser->setContentHandler(&handler);
+	parser->setErrorHandler(&handler);
+	parser->setLexicalHandler(&handler);
+	
+	try
+	{
+		parser->parse(source);
+	}
+	catch(...)
+	{
+		delete doc;
+		return 0;
+	}
+	
+	if(!doc->getDocumentElement())
+	{
+		// Parse error
+		delete doc;
+		return 0;
+	}
+	
+	return doc;
+}
+
+NativeNode::NativeNode(short type,NativeDocument *doc)
+{
+	this->type = type;
+	this->doc = doc;
+}
+
+NativeNode::~NativeNode()
+{
+	NativeNode *child = first_child;
+	while(child)
+	{
+		NativeNode *next_child = child->next;
+		delete child;
+		child = next_child;
+	}
+}
+
+void NativeNode::unlink()
+{
+	if(prev)
+		prev->next = next;
+	else
+		parent->first_child = next;
+	
+	if(next)
+		next->prev = prev;
+	else
+		parent->last_child = prev;
+	
+	parent = prev = next = 0;
+}
+
+void NativeNode::link(NativeNode *child,NativeNode *ref)
+{
+	child->parent = this;
+	child->next = ref;
+	child->prev = ref?ref->prev:last_child;
+	
+	if(child->prev)
+		child->prev->next = child;
+	else
+		first_child = child;
+	
+	if(ref)
+		ref->prev = child;
+	else
+		last_child = child;
+}
+
+NativeDocument *NativeNode::getOwnerDocument() const
+{
+	return type==DOMNode::DOCUMENT_NODE?0:doc;
+}
+
+const string &NativeNode::getNodeName() const
+{
+	switch(type)
+	{
+		case DOMNode::ELEMENT_NODE:
+			return *((NativeElement *)this)->name;
+		
+		case DOMNode::ATTRIBUTE_NODE:
+			return *((NativeAttr *)this)->name;
+		
+		case DOMNode::TEXT_NODE:
+			return name_text;
+		
+		case DOMNode::CDATA_SECTION_NODE:
+			return name_cdata;
+		
+		case DOMNode::COMMENT_NODE:
+			return name_comment;
+	}
+	
+	return name_document;
+}
+
+string NativeNode::getNodeValue() const
+{
+	if(type==DOMNode::ATTRIBUTE_NODE)
+		return ((NativeAttr *)this)->value;
+	
+	if(type==DOMNode::TEXT_NODE || type==DOMNode::CDATA_SECTION_NODE || type==DOMNode::COMMENT_NODE)
+		return ((NativeText *)this)->data;
+	
+	return getTextContent();
+}
+
+string NativeNode::getTextContent() const
+{
+	if(type!=DOMNode::ELEMENT_NODE)
+		return type==DOMNode::DOCUMENT_NODE?"":getNodeValue();
+	
+	// Concatenate descendant text nodes
+	string text;
+	const NativeNode *node = first_child;
+	while(node)
+	{
+		if(node->type==DOMNode::TEXT_NODE || node->type==DOMNode::CDATA_SECTION_NODE)
+			text += ((NativeText *)node)->data;
+		
+		if(node->first_child)
+			node = node->first_child;
+		else
+		{
+			while(node!=this && !node->next)
+				node = node->parent;
+			node = node==this?0:node->next;
+		}
+	}
+	
+	return text;
+}
+
+void NativeNode::setTextContent(const string &text)
+{
+	if(type==DOMNode::ATTRIBUTE_NODE)
+		((NativeAttr *)this)->value = text;
+	else if(type==DOMNode::TEXT_NODE || type==DOMNode::CDATA_SECTION_NODE || type==DOMNode::COMMENT_NODE)
+		((NativeText *)this)->data = text;
+	else
+	{
+		while(first_child)
+			first_child->release();
+		
+		if(text.length())
+			appendChild(doc->createTextNode(text));
+	}
+}
+
+NativeNode *NativeNode::appendChild(NativeNode *child)
+{
+	return insertBefore(child,0);
+}
+
+NativeNode *NativeNode::insertBefore(NativeNode *child,NativeNode *ref)
+{
+	if(child->doc!=doc)
+		throw Exception("NativeDOM","Node is used in a different document than the one that created it");
+	
+	if(child->type==DOMNode::ATTRIBUTE_NODE || child->type==DOMNode::DOCUMENT_NODE)
+		throw Exception("NativeDOM","Node cannot be inserted as a child");
+	
+	if(ref && ref->parent!=this)
+		throw Exception("NativeDOM","Reference node is not a child of this node");
+	
+	for(NativeNode *ancestor=this;ancestor;ancestor=ancestor->parent)
+		if(ancestor==child)
+			throw Exception("NativeDOM","Node cannot be inserted in its own subtree");
+	
+	if(child==ref)
+		return child;
+	
+	if(child->parent)
+		child->unlink();
+	else
+		doc->detached.erase(child);
+	
+	link(child,ref);
+	return child;
+}
+
+NativeNode *NativeNode::removeChild(NativeNode *child)
+{
+	if(child->parent!=this)
+		throw Exception("NativeDOM","Node is not a child of this node");
+	
+	// Node is kept alive until it is released or the document is destroyed
+	child->unlink();
+	doc->adopt(child);
+	return child;
+}
+
+NativeNode *NativeNode::replaceChild(NativeNode *child,NativeNode *old_child)
+{
+	insertBefore(child,old_child);
+	return removeChild(old_child);
+}
+
+NativeNode *NativeNode::cloneNode(bool deep) const
+{
+	return doc->importNode(this,deep);
+}
+
+void NativeNode::release()
+{
+	// Attributes belong to their element and document to its wrapper
+	if(type==DOMNode::ATTRIBUTE_NODE || type==DOMNode::DOCUMENT_NODE)
+		return;
+	
+	if(parent)
+		unlink();
+	else
+		doc->detached.erase(this);
+	
+	delete this;
+}
+
+NativeAttr::NativeAttr(NativeDocument *doc,const string *name,const string &value,NativeElement *owner):NativeNode(DOMNode::ATTRIBUTE_NODE,doc)
+{
+	this->name = name;
+	this->value = value;
+	this->owner = owner;
+}
+
+NativeElement::NativeElement(NativeDocument *doc,const string *name):NativeNode(DOMNode::ELEMENT_NODE,doc)
+{
+	this->name = name;
+}
+
+NativeElement::~NativeElement()
+{
+	for(int i=0;i<attributes.size();i++)
+		delete attributes[i];
+}
+
+NativeAttr *NativeElement::find_attribute(const string &name) const
+{
+	for(int i=0;i<attributes.size();i++)
+		if(*attributes[i]->name==name)
+			return attributes[i];
+	
+	return 0;
+}
+
+bool NativeElement::hasAttribute(const string &name) const
+{
+	return find_attribute(name)!=0;
+}
+
+const string &NativeElement::getAttribute(const string &name) const
+{
+	NativeAttr *attr = find_attribute(name);
+	return attr?attr->value:empty_string;
+}
+
+NativeAttr *NativeElement::getAttributeNode(const string &name) const
+{
+	return find_attribute(name);
+}
+
+void NativeElement::setAttribute(const string &name,const string &value)
+{
+	NativeAttr *attr = find_attribute(name);
+	if(attr)
+		attr->value = value;
+	else
+		attributes.push_back(new NativeAttr(doc,doc->Intern(name),value,this));
+}
+
+void NativeElement::removeAttribute(const string &name)
+{
+	for(int i=0;i<attributes.size();i++)
+	{
+		if(*attributes[i]->name==name)
+		{
+			delete attributes[i];
+			attributes.erase(attributes.begin()+i);
+			return;
+		}
+	}
+}
+
+NativeText::NativeText(NativeDocument *doc,short type,const string &data):NativeNode(type,doc)
+{
+	this->data = data;
+}
+
+NativeDocument::NativeDocument():NativeNode(DOMNode::DOCUMENT_NODE,this)
+{
+}
+
+NativeDocument::~NativeDocument()
+{
+	for(auto it=detached.begin();it!=detached.end();++it)
+		delete *it;
+}
+
+NativeDocument *NativeDocument::Parse(const string &xml_str)
+{
+	xercesc::MemBufInputSource source((const XMLByte *)xml_str.c_str(),xml_str.length(),"NativeDocument");
+	return parse(source);
+}
+
+NativeDocument *NativeDocument::ParseFile(const string &filename)
+{
+	try
+	{
+		XMLString xfilename(filename);
+		xercesc::LocalFileInputSource source(xfilename);
+		return parse(source);
+	}
+	catch(...)
+	{
+		return 0;
+	}
+}
+
+const string *NativeDocument::Intern(const string &name)
+{
+	return &*names.insert(name).first;
+}
+
+NativeElement *NativeDocument::getDocumentElement() const
+{
+	for(NativeNode *child=first_child;child;child=child->next)
+		if(child->type==DOMNode::ELEMENT_NODE)
+			return (NativeElement *)child;
+	
+	return 0;
+}
+
+void NativeDocument::adopt(NativeNode *node)
+{
+	detached.insert(node);
+}
+
+NativeElement *NativeDocument::createElement(const string &name)
+{
+	NativeElement *element = new NativeElement(this,Intern(name));
+	adopt(element);
+	return element;
+}
+
+NativeText *NativeDocument::createTextNode(const string &data)
+{
+	return createNode(DOMNode::TEXT_NODE,data);
+}
+
+NativeText *NativeDocument::createNode(short type,const string &data)
+{
+	NativeText *text = new NativeText(this,type,data);
+	adopt(text);
+	return text;
+}
+
+NativeNode *NativeDocument::importNode(const NativeNode *node,bool deep)
+{
+	NativeNode *copy;
+	if(node->type==DOMNode::ELEMENT_NODE)
+	{
+		const NativeElement *element = (const NativeElement *)node;
+		NativeElement *element_copy = createElement(*element->name);
+		for(int i=0;i<element->attributes.size();i++)
+			element_copy->setAttribute(*element->attributes[i]->name,element->attributes[i]->value);
+		copy = element_copy;
+	}
+	else if(node->type==DOMNode::TEXT_NODE || node->type==DOMNode::CDATA_SECTION_NODE || node->type==DOMNode::COMMENT_NODE)
+		copy = createNode(node->type,((const NativeText *)node)->data);
+	else
+		throw Exception("NativeDOM","Node type cannot be imported");
+	
+	if(deep)
+	{
+		for(const NativeNode *child=node->first_child;child;child=child->next)
+			copy->appendChild(importNode(child,true));
+	}
+	
+	return copy;
+}
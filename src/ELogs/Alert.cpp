@@ -90,6 +90,21 @@ Alert::Alert(DB *db,unsigned int alert_id)
 	}
 }
 
+map<string, string> Alert::GetFiltersMap() const
+{
+	// Convert json filters to the format expected by ELogs queries
+	map<string, string> filters;
+	for(auto it = json_filters.begin(); it!=json_filters.end(); ++it)
+	{
+		if(it.value().type()==nlohmann::json::value_t::number_unsigned)
+			filters[it.key()] = to_string((int)it.value());
+		else if(it.value().type()==nlohmann::json::value_t::string)
+			filters[it.key()] = it.value();
+	}
+	
+	return filters;
+}
+
 bool Alert::CheckName(const string &alert_name)
 {
 	int len;
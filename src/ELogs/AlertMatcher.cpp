@@ -0,0 +1,381 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#include <ELogs/AlertMatcher.h>
+#include <ELogs/Channel.h>
+#include <ELogs/Channels.h>
+#include <ELogs/ChannelGroup.h>
+#include <ELogs/ChannelGroups.h>
+#include <Exception/Exception.h>
+
+#include <string.h>
+
+using namespace std;
+using nlohmann::json;
+
+namespace ELogs
+{
+
+AlertMatcher::AlertMatcher(const Alert &alert)
+{
+	this->alert = alert;
+	
+	map<string, string> alert_filters = alert.GetFiltersMap();
+	
+	if(alert_filters["filter_crit"]!="")
+		filter_crit = Field::PackCrit(alert_filters["filter_crit"]);
+	
+	try
+	{
+		if(alert_filters["filter_group"]!="")
+			filter_group = stoi(alert_filters["filter_group"]);
+		
+		if(alert_filters["filter_channel"]!="")
+			filter_channel = stoi(alert_filters["filter_channel"]);
+	}
+	catch(...)
+	{
+		throw Exception("AlertMatcher","Invalid group or channel filter for alert "+alert.GetName());
+	}
+	
+	// As in SQL evaluation, field filters only apply to the group or channel being filtered
+	vector<pair<bool, const Fields *>> fields_list;
+	
+	ChannelGroup group;
+	if(filter_group!=0)
+	{
+		group = ChannelGroups::GetInstance()->Get(filter_group);
+		fields_list.push_back({true, &group.GetFields()});
+	}
+	
+	Channel channel;
+	if(filter_channel!=0)
+	{
+		channel = Channels::GetInstance()->Get(filter_channel);
+		fields_list.push_back({false, &channel.GetFields()});
+	}
+	
+	for(int i=0;i<fields_list.size();i++)
+	{
+		string prefix = fields_list[i].first?"filter_group_":"filter_channel_";
+		auto fields_map = fields_list[i].second->GetIDMap();
+		for(auto it = fields_map.begin(); it!=fields_map.end(); ++it)
+		{
+			string value = alert_filters[prefix+it->second.GetName()];
+			if(value=="")
+				continue;
+			
+			st_filter filter;
+			filter.is_group = fields_list[i].first;
+			filter.field = it->second;
+			filter.value_int = 0;
+			filter.is_prefix = false;
+			
+			if(filter.field.GetType()==Field::en_type::CHAR && value.back()=='*')
+			{
+				filter.is_prefix = true;
+				value = value.substr(0, value.size()-1);
+			}
+			
+			if(filter.field.GetType()==Field::en_type::INT)
+				filter.value_int = filter.field.PackInteger(value);
+			else if(filter.field.GetType()==Field::en_type::IP)
+				filter.value_str = filter.field.PackIP(value);
+			else
+				filter.value_str = value;
+			
+			filters.push_back(filter);
+		}
+	}
+	
+	groupby = alert_filters["groupby"];
+}
+
+bool AlertMatcher::IsSameDefinition(const Alert &alert) const
+{
+	return alert.GetFilters()==this->alert.GetFilters() && alert.GetPeriod()==this->alert.GetPeriod() && alert.GetOccurrences()==this->alert.GetOccurrences();
+}
+
+bool AlertMatcher::Match(unsigned long long log_id, const Channel &channel, const map<string, string> &group_fields, const map<string, string> &channel_fields, time_t now, json &j_logs)
+{
+	if(filter_channel!=0 && channel.GetID()!=filter_channel)
+		return false;
+	
+	if(filter_group!=0 && channel.GetGroupID()!=filter_group)
+		return false;
+	
+	if(filter_crit>=0)
+	{
+		auto it = group_fields.find("crit");
+		if(it==group_fields.end() || Field::PackCrit(it->second)!=filter_crit)
+			return false;
+	}
+	
+	for(int i=0;i<filters.size();i++)
+	{
+		const map<string, string> &fields = filters[i].is_group?group_fields:channel_fields;
+		auto it = fields.find(filters[i].field.GetName());
+		if(it==fields.end() || !match_value(filters[i], it->second))
+			return false;
+	}
+	
+	// Log is matching, compute everything that does not need the windows before locking
+	time_t head = now/60;
+	time_t minute = head;
+	auto it_date = group_fields.find("date");
+	if(it_date!=group_fields.end())
+		minute = min(parse_date(it_date->second)/60, head);
+	
+	if(minute<=head-alert.GetPeriod())
+		return false; // Log is older than the alert period
+	
+	string key = alert.GetIsGroupped()?get_groupby_value(channel, group_fields, channel_fields):"";
+	
+	json j_log;
+	if(!alert.GetIsGroupped())
+		j_log = get_log(log_id, channel, group_fields, channel_fields);
+	
+	unsigned int count;
+	deque<pair<time_t, json>> logs;
+	
+	{
+		unique_lock<mutex> llock(windows_lock);
+		
+		st_window &window = windows[key];
+		
+		expire_window(window, head);
+		
+		// Logs are mostly received in order, so search from the end
+		auto it_minute = window.minutes.end();
+		while(it_minute!=window.minutes.begin() && prev(it_minute)->first>minute)
+			--it_minute;
+		
+		if(it_minute!=window.minutes.begin() && prev(it_minute)->first==minute)
+			prev(it_minute)->second++;
+		else
+			window.minutes.insert(it_minute, {minute, 1});
+		
+		window.count++;
+		
+		if(!alert.GetIsGroupped())
+		{
+			window.logs.push_back({minute, move(j_log)});
+			if(window.logs.size()>ALERTMATCHER_MAX_LOGS)
+				window.logs.pop_front();
+		}
+		
+		if(window.count<alert.GetOccurrences() || now<window.muted_until)
+			return false;
+		
+		// Start a new window, alert will not be triggered again before its period has elapsed
+		count = window.count;
+		logs.swap(window.logs);
+		window.minutes.clear();
+		window.count = 0;
+		window.muted_until = now + alert.GetPeriod() * 60;
+	}
+	
+	// Build notification data, in the same format as SQL evaluation
+	j_logs = json::array();
+	if(alert.GetIsGroupped())
+	{
+		json j_group;
+		j_group["n"] = to_string(count);
+		j_group[groupby] = key;
+		j_logs.push_back(j_group);
+	}
+	else
+	{
+		for(auto it = logs.rbegin(); it!=logs.rend(); ++it)
+			j_logs.push_back(it->second);
+	}
+	
+	return true;
+}
+
+void AlertMatcher::Mute(const string &key, time_t until)
+{
+	unique_lock<mutex> llock(windows_lock);
+	
+	st_window &window = windows[key];
+	window.minutes.clear();
+	window.logs.clear();
+	window.count = 0;
+	window.muted_until = until;
+}
+
+void AlertMatcher::Expire(time_t now)
+{
+	unique_lock<mutex> llock(windows_lock);
+	
+	// Free windows that are no longer holding any information
+	for(auto it = windows.begin(); it!=windows.end();)
+	{
+		expire_window(it->second, now/60);
+		
+		if(it->second.count==0 && it->second.muted_until<=now)
+			it = windows.erase(it);
+		else
+			++it;
+	}
+}
+
+bool AlertMatcher::match_value(const st_filter &filter, const string &value) const
+{
+	// Mimic SQL comparisons on stored values (CHAR and TEXT columns are case insensitive)
+	try
+	{
+		switch(filter.field.GetType())
+		{
+			case Field::en_type::CHAR:
+			{
+				string stored = value.substr(0, 128);
+				if(filter.is_prefix)
+					return stored.size()>=filter.value_str.size() && iequals(stored, filter.value_str, filter.value_str.size());
+				return iequals(stored, filter.value_str);
+			}
+			
+			case Field::en_type::TEXT:
+				return iequals(value.substr(0, 65535), filter.value_str);
+			
+			case Field::en_type::ITEXT:
+				return value==filter.value_str;
+			
+			case Field::en_type::INT:
+				return filter.field.PackInteger(value)==filter.value_int;
+			
+			case Field::en_type::IP:
+				return filter.field.PackIP(value)==filter.value_str;
+			
+			case Field::en_type::PACK:
+				return value==filter.value_str;
+			
+			case Field::en_type::NONE:
+				return false;
+		}
+	}
+	catch(Exception &e)
+	{
+		return false; // Value could not be stored either
+	}
+	
+	return false;
+}
+
+string AlertMatcher::get_groupby_value(const Channel &channel, const map<string, string> &group_fields, const map<string, string> &channel_fields) const
+{
+	if(groupby=="crit")
+	{
+		auto it = group_fields.find("crit");
+		return it!=group_fields.end()?it->second:"";
+	}
+	
+	try
+	{
+		if(groupby.substr(0,6)=="group_")
+		{
+			auto it = group_fields.find(groupby.substr(6));
+			if(it!=group_fields.end())
+				return normalize(channel.GetGroup().GetFields().Get(it->first), it->second);
+		}
+		else if(groupby.substr(0,8)=="channel_")
+		{
+			auto it = channel_fields.find(groupby.substr(8));
+			if(it!=channel_fields.end())
+				return normalize(channel.GetFields().Get(it->first), it->second);
+		}
+	}
+	catch(Exception &e)
+	{
+	}
+	
+	return "";
+}
+
+json AlertMatcher::get_log(unsigned long long log_id, const Channel &channel, const map<string, string> &group_fields, const map<string, string> &channel_fields) const
+{
+	json j_log;
+	
+	j_log["id"] = to_string(log_id);
+	j_log["channel"] = channel.GetName();
+	
+	for(auto it = group_fields.begin(); it!=group_fields.end(); ++it)
+	{
+		if(it->first=="crit" || it->first=="date")
+			j_log[it->first] = it->second;
+		else if(filter_group!=0)
+			j_log["group_"+it->first] = it->second;
+	}
+	
+	if(filter_channel!=0)
+	{
+		for(auto it = channel_fields.begin(); it!=channel_fields.end(); ++it)
+			j_log["channel_"+it->first] = it->second;
+	}
+	
+	return j_log;
+}
+
+void AlertMatcher::expire_window(st_window &window, time_t minute) const
+{
+	while(window.minutes.size() && window.minutes.front().first<=minute-alert.GetPeriod())
+	{
+		window.count -= window.minutes.front().second;
+		window.minutes.pop_front();
+	}
+	
+	while(window.logs.size() && window.logs.front().first<=minute-alert.GetPeriod())
+		window.logs.pop_front();
+}
+
+string AlertMatcher::normalize(const Field &field, const string &value)
+{
+	if(field.GetType()==Field::en_type::INT)
+		return field.UnpackInteger(field.PackInteger(value));
+	else if(field.GetType()==Field::en_type::IP)
+		return field.UnpackIP(field.PackIP(value));
+	
+	return value;
+}
+
+bool AlertMatcher::iequals(const string &a, const string &b, size_t len)
+{
+	if(len==string::npos)
+	{
+		if(a.size()!=b.size())
+			return false;
+		len = a.size();
+	}
+	
+	return strncasecmp(a.c_str(), b.c_str(), len)==0;
+}
+
+time_t AlertMatcher::parse_date(const string &date)
+{
+	struct tm date_t;
+	memset(&date_t, 0, sizeof(struct tm));
+	if(!strptime(date.c_str(), "%Y-%m-%d %H:%M:%S", &date_t))
+		return time(0);
+	
+	date_t.tm_isdst = -1;
+	return mktime(&date_t);
+}
+
+}
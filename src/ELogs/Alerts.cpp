@@ -18,6 +18,7 @@
  */
 
 #include <ELogs/Alerts.h>
+#include <ELogs/AlertMatcher.h>
 #include <Configuration/Configuration.h>
 #include <API/QueryHandlers.h>
 #include <User/User.h>
@@ -59,6 +60,9 @@ Alerts::Alerts():APIObjectList("Alert")
 {
 	instance = this;
 	
+	is_streaming = Configuration::GetInstance()->Get("elog.alerts.engine")=="streaming";
+	matchers = make_shared<const t_matchers>();
+	
 	Reload(false);
 }
 
@@ -90,8 +94,15 @@ void Alerts::Reload(bool notify)
 	while(db.FetchRow())
 		add(db.GetFieldInt(0),db.GetField(1),new Alert(&db2,db.GetFieldInt(0)));
 	
+	vector<Alert> alert_objs;
+	for(auto it = objects_id.begin(); it!=objects_id.end(); ++it)
+		alert_objs.push_back(*it->second);
+	
 	llock.unlock();
 	
+	if(is_streaming)
+		reload_matchers(alert_objs);
+	
 	if(notify)
 	{
 		// Notify cluster
@@ -156,15 +167,100 @@ void Alerts::HandleNotificationTypeDelete(unsigned int id)
 	Events::GetInstance()->Create("ALERT_MODIFIED");
 }
 
+void Alerts::Match(unsigned long long log_id, const Channel &channel, const map<string, string> &group_fields, const map<string, string> &channel_fields)
+{
+	if(!is_streaming)
+		return;
+	
+	time_t now = time(0);
+	vector<st_trigger> new_triggers;
+	
+	shared_ptr<const t_matchers> current_matchers = get_matchers();
+	for(auto it = current_matchers->begin(); it!=current_matchers->end(); ++it)
+	{
+		try
+		{
+			json j_logs;
+			if(it->second->Match(log_id, channel, group_fields, channel_fields, now, j_logs))
+			{
+				const Alert &alert = it->second->GetAlert();
+				string key = alert.GetIsGroupped()?j_logs[0][alert.GetGroupby()].get<string>():"";
+				new_triggers.push_back({alert, key, move(j_logs)});
+			}
+		}
+		catch(Exception &e)
+		{
+			Logger::Log(LOG_ERR,"Alerts Engine : error matching alert \""+it->second->GetAlert().GetName()+"\" : "+e.error);
+		}
+	}
+	
+	if(new_triggers.size()==0)
+		return;
+	
+	{
+		unique_lock<mutex> llock(triggers_lock);
+		for(size_t i=0;i<new_triggers.size();i++)
+			triggers.push_back(move(new_triggers[i]));
+	}
+	
+	// Notifications are sent from the alerts thread, do not slow down log storage
+	wakeup();
+}
+
+shared_ptr<const Alerts::t_matchers> Alerts::get_matchers()
+{
+	unique_lock<mutex> llock(matchers_lock);
+	return matchers;
+}
+
+void Alerts::reload_matchers(const vector<Alert> &alert_objs)
+{
+	shared_ptr<const t_matchers> current_matchers = get_matchers();
+	
+	auto new_matchers = make_shared<t_matchers>();
+	for(int i=0;i<alert_objs.size();i++)
+	{
+		const Alert &alert = alert_objs[i];
+		if(!alert.GetIsActive())
+			continue;
+		
+		// Keep current windows if alert definition has not changed
+		auto it = current_matchers->find(alert.GetID());
+		if(it!=current_matchers->end() && it->second->IsSameDefinition(alert))
+		{
+			(*new_matchers)[alert.GetID()] = it->second;
+			continue;
+		}
+		
+		try
+		{
+			(*new_matchers)[alert.GetID()] = make_shared<AlertMatcher>(alert);
+		}
+		catch(Exception &e)
+		{
+			Logger::Log(LOG_ERR,"Alerts Engine : unable to compile alert \""+alert.GetName()+"\" : "+e.error);
+		}
+	}
+	
+	// Workers still matching against the previous snapshot keep it alive until they are done
+	unique_lock<mutex> llock(matchers_lock);
+	matchers = new_matchers;
+}
+
 void Alerts::main()
 {
 	unsigned int timer = 0;
+	time_t last_expire = time(0);
 	
 	DB::StartThread();
 	
+	// Streaming windows are empty on startup, catch up once with logs already stored
+	if(is_streaming)
+		check_sql_alerts(0);
+	
 	while(1)
 	{
-		// Our time resolution is 1 minute, so wait 60 seconds
+		// Our time resolution is 1 minute, so wait 60 seconds unless streaming alerts are triggered
 		if(!wait(60))
 		{
 			Logger::Log(LOG_NOTICE,"Shutdown in progress exiting Alerts Engine");
@@ -174,120 +270,216 @@ void Alerts::main()
 			return;
 		}
 		
-		Logger::Log(LOG_INFO, "Processing alerts...");
+		if(is_streaming)
+		{
+			process_triggers();
+			
+			time_t now = time(0);
+			if(now-last_expire>=60)
+			{
+				shared_ptr<const t_matchers> current_matchers = get_matchers();
+				for(auto it = current_matchers->begin(); it!=current_matchers->end(); ++it)
+					it->second->Expire(now);
+				
+				last_expire = now;
+			}
+			
+			continue;
+		}
 		
 		timer++;
 		
-		// Fetch all alerts
-		vector<Alert> alert_objs;
+		check_sql_alerts(timer);
+	}
+	
+	return;
+}
+
+void Alerts::process_triggers()
+{
+	vector<st_trigger> to_process;
+	
+	{
+		unique_lock<mutex> llock(triggers_lock);
+		to_process.swap(triggers);
+	}
+	
+	for(int i=0;i<to_process.size();i++)
+	{
+		const Alert &alert = to_process[i].alert;
+		
+		UniqueAction uaction(get_trigger_action(alert, to_process[i].key),alert.GetPeriod() * 60);
+		if(!uaction.IsElected())
+			continue;
+		
+		Logger::Log(LOG_INFO, "Alert «" + alert.GetName() + "» triggered");
+		
+		try
 		{
-			unique_lock<mutex> llock(lock);
-			
-			for(auto it = objects_name.begin(); it!=objects_name.end(); it++)
-				alert_objs.push_back(*it->second);
+			trigger(alert, to_process[i].logs);
 		}
+		catch(Exception &e)
+		{
+			Logger::Log(LOG_ERR,"Alerts Engine : error processing alert \""+alert.GetName()+"\" : "+e.error);
+		}
+	}
+}
+
+// SQL evaluation of alerts over their period, used when streaming is disabled and for backfill on startup
+void Alerts::check_sql_alerts(unsigned int timer)
+{
+	Logger::Log(LOG_INFO, "Processing alerts...");
+	
+	// Fetch all alerts
+	vector<Alert> alert_objs;
+	{
+		unique_lock<mutex> llock(lock);
+		
+		for(auto it = objects_name.begin(); it!=objects_name.end(); it++)
+			alert_objs.push_back(*it->second);
+	}
+	
+	for(int i=0;i<alert_objs.size();i++)
+	{
+		Alert alert = alert_objs[i];
+		
+		if(!alert.GetIsActive())
+			continue; // Alert has been disactiated
+		
+		if(timer%alert.GetPeriod()!=0)
+			continue; // Skip alert if period is not yet reached
+		
+		// Only one node evaluates the alert, triggers are then elected as in streaming mode
+		UniqueAction uaction("elogs_alerts_eval_" + alert.GetName(),alert.GetPeriod() * 60);
+		if(!uaction.IsElected())
+			continue;
+		
+		Logger::Log(LOG_INFO, "Processing alert «" + alert.GetName() + "»");
 		
-		for(int i=0;i<alert_objs.size();i++)
+		try
 		{
-			Alert alert = alert_objs[i];
+			map<string, string> filters = alert.GetFiltersMap();
 			
-			if(!alert.GetIsActive())
-				continue; // Alert has been disactiated
+			// Add start date based on alert period
+			filters["filter_emitted_from"] = Utils::Date::PastDate(alert.GetPeriod() * 60);
 			
-			if(timer%alert.GetPeriod()!=0)
-				continue; // Skip alert if period is not yet reached
+			bool is_groupped = alert.GetIsGroupped();
 			
-			UniqueAction uaction("elogs_alerts_" + alert.GetName(),alert.GetPeriod() * 60);
-			if(!uaction.IsElected())
-				continue;
-			
-			Logger::Log(LOG_INFO, "Processing alert «" + alert.GetName() + "»");
+			auto logs = ELogs::QueryLogs(filters, 1000);
+			if(!is_groupped && logs.size()<alert.GetOccurrences())
+				continue; // Too few logs to trigger
 			
-			try
+			// Build json data for notification script
+			json j_logs = json::array();
+			for(int i=0;i<logs.size(); i++)
 			{
-				// Convert json filters to map
-				auto json_filters = alert.GetJsonFilters();
-				map<string, string> filters;
-				for(auto it = json_filters.begin(); it!=json_filters.end(); ++it)
+				json j_log;
+				
+				try
 				{
-					if(it.value().type()==nlohmann::json::value_t::number_unsigned)
-						filters[it.key()] = to_string((int)it.value());
-					else if(it.value().type()==nlohmann::json::value_t::string)
-						filters[it.key()] = it.value();
+					if(is_groupped && stoi(logs[i]["n"])<alert.GetOccurrences())
+						continue; // To few groupped logs
 				}
-				
-				// Add start date based on alert period
-				string start_date = Utils::Date::PastDate(alert.GetPeriod() * 60);
-				filters["filter_emitted_from"] = start_date;
-				
-				bool is_groupped = alert.GetIsGroupped();
-				
-				auto logs = ELogs::QueryLogs(filters, 1000);
-				if(!is_groupped && logs.size()<alert.GetOccurrences())
-					continue; // Too few logs to trigger
-				
-				// Build json data for notification script
-				json j_logs = json::array();
-				for(int i=0;i<logs.size(); i++)
+				catch(...)
 				{
-					json j_log;
-					
-					try
-					{
-						if(is_groupped && stoi(logs[i]["n"])<alert.GetOccurrences())
-							continue; // To few groupped logs
-					}
-					catch(...)
-					{
-						continue; // Should not happen
-					}
-					
-					for(auto field = logs[i].begin(); field!=logs[i].end(); ++field)
-						j_log[field->first] = field->second;
-					j_logs.push_back(j_log);
+					continue; // Should not happen
 				}
 				
-				if(j_logs.size()==0)
-					continue; // No logs (everything was filtered in the loop), so do not call alert
-				
-				json j;
-				j["logs"] = j_logs;
-				
-				if(is_groupped)
-					j["groupby"] = filters["groupby"];
-				
-				auto notifications = alert.GetNotifications();
-				for(int i=0;i<notifications.size(); i++)
+				for(auto field = logs[i].begin(); field!=logs[i].end(); ++field)
+					j_log[field->first] = field->second;
+				j_logs.push_back(j_log);
+			}
+			
+			if(j_logs.size()==0)
+				continue; // No logs (everything was filtered in the loop), so do not call alert
+			
+			// Do not notify again what another node (or the streaming engine) already triggered
+			json j_elected_logs = json::array();
+			if(is_groupped)
+			{
+				for(size_t i=0;i<j_logs.size();i++)
 				{
-					Notifications::GetInstance()->Call(
-						notifications.at(i),
-						"alert "+alert.GetName(),
-						{},
-						j
-					);
+					UniqueAction trigger_uaction(get_trigger_action(alert, j_logs[i][alert.GetGroupby()].get<string>()),alert.GetPeriod() * 60);
+					if(trigger_uaction.IsElected())
+						j_elected_logs.push_back(j_logs[i]);
 				}
-				
-				// Log alert trigger
-				DB db("elog");
-				int alert_id = alert.GetID();
-				db.QueryPrintf(
-					"INSERT INTO t_alert_trigger(alert_id, alert_trigger_start, alert_trigger_filters) VALUES(%i,%s, %s)", {
-					&alert_id,
-					&start_date,
-					&alert.GetFilters()
-				});
-				
-				// Emit event
-				Events::GetInstance()->Create("ALERT_TRIGGER");
 			}
-			catch(Exception &e)
+			else
+			{
+				UniqueAction trigger_uaction(get_trigger_action(alert, ""),alert.GetPeriod() * 60);
+				if(trigger_uaction.IsElected())
+					j_elected_logs = j_logs;
+			}
+			
+			if(is_streaming)
 			{
-				Logger::Log(LOG_ERR,"Alerts Engine : error processing alert \""+alert.GetName()+"\" : "+e.error);
+				// Do not trigger streaming alert again for the same logs, even if another node notified them
+				shared_ptr<const t_matchers> current_matchers = get_matchers();
+				
+				auto it = current_matchers->find(alert.GetID());
+				if(it!=current_matchers->end())
+				{
+					time_t until = time(0) + alert.GetPeriod() * 60;
+					if(is_groupped)
+					{
+						for(int i=0;i<j_logs.size();i++)
+							it->second->Mute(j_logs[i][alert.GetGroupby()].get<string>(), until);
+					}
+					else
+						it->second->Mute("", until);
+				}
 			}
+			
+			if(j_elected_logs.size()==0)
+				continue;
+			
+			trigger(alert, j_elected_logs);
+		}
+		catch(Exception &e)
+		{
+			Logger::Log(LOG_ERR,"Alerts Engine : error processing alert \""+alert.GetName()+"\" : "+e.error);
 		}
 	}
+}
+
+void Alerts::trigger(const Alert &alert, const json &j_logs)
+{
+	json j;
+	j["logs"] = j_logs;
 	
-	return;
+	if(alert.GetIsGroupped())
+		j["groupby"] = alert.GetGroupby();
+	
+	auto notifications = alert.GetNotifications();
+	for(int i=0;i<notifications.size(); i++)
+	{
+		Notifications::GetInstance()->Call(
+			notifications.at(i),
+			"alert "+alert.GetName(),
+			{},
+			j
+		);
+	}
+	
+	// Log alert trigger
+	DB db("elog");
+	int alert_id = alert.GetID();
+	string start_date = Utils::Date::PastDate(alert.GetPeriod() * 60);
+	db.QueryPrintf(
+		"INSERT INTO t_alert_trigger(alert_id, alert_trigger_start, alert_trigger_filters) VALUES(%i,%s, %s)", {
+		&alert_id,
+		&start_date,
+		&alert.GetFilters()
+	});
+	
+	// Emit event
+	Events::GetInstance()->Create("ALERT_TRIGGER");
+}
+
+string Alerts::get_trigger_action(const Alert &alert, const string &key)
+{
+	// Same election name for SQL and streaming engines, so a trigger is notified once across the cluster
+	return "elogs_alerts_" + alert.GetName() + (alert.GetIsGroupped()?"_"+key:"");
 }
 
 }
@@ -51,9 +51,29 @@ ConfigurationELogs::ConfigurationELogs()
 	entries["elog.mysql.user"] = "";
 	entries["elog.bind.ip"] = "*";
 	entries["elog.bind.port"] = "5002";
+	entries["elog.stream.bind.ip"] = "";
+	entries["elog.stream.bind.port"] = "5003";
+	entries["elog.stream.bind.path"] = "";
+	entries["elog.stream.listen.backlog"] = "64";
+	entries["elog.stream.framing"] = "newline";
+	entries["elog.stream.ack"] = "100";
+	entries["elog.stream.connections.max"] = "64";
 	entries["elog.queue.size"] = "1000";
 	entries["elog.bulk.size"] = "500";
+	entries["elog.bulk.load"] = "no";
 	entries["elog.log.maxsize"] = "4K";
+	entries["elog.alerts.engine"] = "streaming";
+	entries["elog.partitions.ahead"] = "7";
+	entries["elog.storage"] = "mysql";
+	entries["elog.storage.workers"] = "4";
+	entries["elog.storage.ids"] = "10000";
+	entries["elog.segments.directory"] = "/var/lib/evqueue/elogs";
+	entries["elog.segments.rows"] = "65536";
+	entries["elog.segments.flush"] = "60";
+	entries["elog.rollups.enable"] = "yes";
+	entries["elog.rollups.fields"] = "";
+	entries["elog.cache.ttl"] = "5";
+	entries["elog.cache.size"] = "1000";
 	
 	entries["gc.elogs.logs.retention"] = "90";
 	entries["gc.elogs.triggers.retention"] = "30";
@@ -66,22 +86,62 @@ ConfigurationELogs::~ConfigurationELogs()
 void ConfigurationELogs::Check(void)
 {
 	check_bool_entry("elog.enable");
+	check_bool_entry("elog.bulk.load");
+	check_bool_entry("elog.rollups.enable");
 	
 	check_int_entry("elog.bind.port");
+	check_int_entry("elog.stream.bind.port");
+	check_int_entry("elog.stream.listen.backlog");
+	check_int_entry("elog.stream.ack");
+	check_int_entry("elog.stream.connections.max");
 	check_int_entry("elog.queue.size");
 	check_int_entry("elog.bulk.size");
+	check_int_entry("elog.partitions.ahead");
+	check_int_entry("elog.storage.workers");
+	check_int_entry("elog.storage.ids");
+	check_int_entry("elog.segments.rows");
+	check_int_entry("elog.segments.flush");
+	check_int_entry("elog.cache.ttl");
+	check_int_entry("elog.cache.size");
 	
 	check_int_entry("gc.elogs.logs.retention");
 	check_int_entry("gc.elogs.triggers.retention");
 	
 	check_size_entry("elog.log.maxsize");
 	
+	if(Get("elog.alerts.engine")!="streaming" && Get("elog.alerts.engine")!="sql")
+		throw Exception("Configuration","elog.alerts.engine: invalid value '"+Get("elog.alerts.engine")+"'. Value must be 'streaming' or 'sql'");
+	
+	if(Get("elog.storage")!="mysql" && Get("elog.storage")!="segments")
+		throw Exception("Configuration","elog.storage: invalid value '"+Get("elog.storage")+"'. Value must be 'mysql' or 'segments'");
+	
+	if(Get("elog.stream.framing")!="newline" && Get("elog.stream.framing")!="length")
+		throw Exception("Configuration","elog.stream.framing: invalid value '"+Get("elog.stream.framing")+"'. Value must be 'newline' or 'length'");
+	
 	if(Configuration::GetInstance()->Get("mysql.database")==Get("elog.mysql.database"))
 		throw Exception("Configuration","mysql.database and elog.mysql.database cannot be the same");
 	
 	if(GetInt("gc.elogs.logs.retention")<2)
 		throw Exception("Configuration","gc.elogs.logs.retention: cannot be less than 2");
 	
+	if(GetInt("elog.partitions.ahead")<1)
+		throw Exception("Configuration","elog.partitions.ahead: cannot be less than 1");
+	
+	if(GetInt("elog.cache.ttl")<0)
+		throw Exception("Configuration","elog.cache.ttl: cannot be less than 0");
+	
+	if(GetInt("elog.storage.workers")<1)
+		throw Exception("Configuration","elog.storage.workers: cannot be less than 1");
+	
+	if(GetInt("elog.storage.ids")<1)
+		throw Exception("Configuration","elog.storage.ids: cannot be less than 1");
+	
+	if(GetInt("elog.stream.ack")<1)
+		throw Exception("Configuration","elog.stream.ack: cannot be less than 1");
+	
+	if(GetInt("elog.stream.connections.max")<1)
+		throw Exception("Configuration","elog.stream.connections.max: cannot be less than 1");
+	
 	if(GetInt("gc.elogs.triggers.retention")<2)
 		throw Exception("Configuration","gc.elogs.triggers.retention: cannot be less than 2");
 }
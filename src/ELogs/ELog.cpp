@@ -19,6 +19,7 @@
 
 #include <ELogs/ELog.h>
 #include <ELogs/LogStorage.h>
+#include <ELogs/LogBackend.h>
 #include <ELogs/ChannelGroup.h>
 #include <ELogs/ChannelGroups.h>
 #include <ELogs/Channel.h>
@@ -34,6 +35,7 @@
 #include <User/User.h>
 
 #include <vector>
+#include <map>
 
 using namespace std;
 
@@ -59,21 +61,18 @@ bool ELog::HandleQuery(const User &user, XMLQuery *query, QueryResponse *respons
 	{
 		unsigned long long id = query->GetRootAttributeLong("id");
 		
-		DB db("elog");
-		db.QueryPrintf("SELECT l.channel_id, c.channel_group_id FROM t_log l INNER JOIN t_channel c ON l.channel_id=c.channel_id WHERE l.log_id=%l", {&id});
-		db.FetchRow();
-		
-		unsigned int channel_id = db.GetFieldInt(0);
-		unsigned int group_id = db.GetFieldInt(1);
-		
-		const Channel channel = Channels::GetInstance()->Get(channel_id);
-		const ChannelGroup group = ChannelGroups::GetInstance()->Get(group_id);
+		unsigned int channel_id;
+		map<string, string> group_values, channel_values;
+		if(!LogStorage::GetInstance()->GetBackend()->Get(id, &channel_id, group_values, channel_values))
+			throw Exception("ELog", "Unknown log ID", "UNKNOWN_LOG");
 		
 		DOMElement group_node = (DOMElement)response->AppendXML("<group />");
-		query_fields(&db, id, group.GetFields(), group_node);
+		for(auto it = group_values.begin(); it!=group_values.end(); ++it)
+			group_node.setAttribute(it->first, it->second);
 		
 		DOMElement channel_node = (DOMElement)response->AppendXML("<channel />");
-		query_fields(&db, id, channel.GetFields(), channel_node);
+		for(auto it = channel_values.begin(); it!=channel_values.end(); ++it)
+			channel_node.setAttribute(it->first, it->second);
 		
 		return true;
 	}
@@ -81,27 +80,6 @@ bool ELog::HandleQuery(const User &user, XMLQuery *query, QueryResponse *respons
 	return false;
 }
 
-void ELog::query_fields(DB *db, unsigned long long id, const Fields &fields, DOMElement &node)
-{
-	string query_select;
-	string query_from;
-	string query_where;
-	
-	BuildSelectFrom(query_select, query_from);
-	BuildSelectFromAppend(query_select, query_from, fields);
-	
-	query_where = " WHERE l.log_id=%l ";
-	
-	db->QueryPrintf(query_select+query_from+query_where, {&id});
-	if(!db->FetchRow())
-		return;
-	
-	int i = 4;
-	auto fields_map = fields.GetIDMap();
-	for(auto it = fields_map.begin(); it!=fields_map.end(); ++it)
-		node.setAttribute(it->second.GetName(), it->second.Unpack(db->GetField(i++)));
-}
-
 void ELog::BuildSelectFrom(string &query_select, string &query_from, const string &groupby)
 {
 	if(groupby=="")
@@ -18,7 +18,7 @@
  */
 
 #include <ELogs/Field.h>
-#include <ELogs/LogStorage.h>
+#include <ELogs/PackDictionary.h>
 #include <Exception/Exception.h>
 #include <DB/DB.h>
 
@@ -48,6 +48,13 @@ Field::Field(unsigned int id)
 	type = StringToFieldType(db.GetField(2));
 }
 
+Field::Field(unsigned int id, const string &name, en_type type)
+{
+	this->id = id;
+	this->name = name;
+	this->type = type;
+}
+
 Field::Field(const Field &f)
 {
 	id = f.id;
@@ -260,12 +267,12 @@ string Field::UnpackIP(const string &bin_ip) const
 
 unsigned int Field::PackString(const string &str) const
 {
-	return LogStorage::GetInstance()->PackString(str);
+	return PackDictionary::GetInstance()->Pack(str);
 }
 
 string Field::UnpackString(int i) const
 {
-	return LogStorage::GetInstance()->UnpackString(i);
+	return PackDictionary::GetInstance()->Unpack(i);
 }
 
 const string Field::GetTableName() const
@@ -18,6 +18,7 @@
  */
 
 #include <ELogs/Fields.h>
+#include <ELogs/FieldsPlan.h>
 #include <Exception/Exception.h>
 #include <DB/DB.h>
 #include <API/QueryResponse.h>
@@ -41,17 +42,20 @@ Fields::Fields(en_type type, unsigned int id)
 	else
 		col_name = "channel_id";
 	
-	if(id==0)
-		return; // Empty object constructor
-	
-	DB db("elog");
-	db.QueryPrintf("SELECT field_id, field_name FROM t_field WHERE %c=%i", {&col_name, &id});
-	
-	while(db.FetchRow())
+	if(id!=0)
 	{
-		id_fields[db.GetFieldInt(0)] = Field(db.GetFieldInt(0));
-		name_fields[db.GetField(1)] = Field(db.GetFieldInt(0));
+		DB db("elog");
+		db.QueryPrintf("SELECT field_id, field_name, field_type FROM t_field WHERE %c=%i", {&col_name, &id});
+		
+		while(db.FetchRow())
+		{
+			Field field(db.GetFieldInt(0), db.GetField(1), Field::StringToFieldType(db.GetField(2)));
+			id_fields[field.GetID()] = field;
+			name_fields[field.GetName()] = field;
+		}
 	}
+	
+	plan = make_shared<FieldsPlan>(id_fields);
 }
 
 void Fields::Update(const json &j)
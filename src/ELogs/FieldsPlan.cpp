@@ -0,0 +1,149 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#include <ELogs/FieldsPlan.h>
+#include <ELogs/PackDictionary.h>
+#include <Exception/Exception.h>
+
+#include <arpa/inet.h>
+
+using namespace std;
+
+namespace ELogs
+{
+
+FieldsPlan::FieldsPlan(const map<unsigned int, Field> &id_fields)
+{
+	for(auto it = id_fields.begin(); it!=id_fields.end(); ++it)
+	{
+		const Field &field = it->second;
+		
+		st_field f;
+		f.field = field;
+		f.id = field.GetID();
+		f.name = field.GetName();
+		f.type = field.GetType();
+		f.bulk_id = field.GetType();
+		f.is_int = field.GetDBType()=="%i";
+		
+		string column = " v"+to_string(f.id)+(f.type==Field::en_type::ITEXT?".value_sha1":".value");
+		f.filter_equal = " AND"+column+" = "+field.GetDBType()+" ";
+		if(f.type==Field::en_type::CHAR)
+			f.filter_prefix = " AND"+column+" LIKE CONCAT(%s, '%') ";
+		
+		switch(f.type)
+		{
+			case Field::en_type::CHAR:
+				f.pack = pack_char;
+				break;
+			
+			case Field::en_type::TEXT:
+				f.pack = pack_text;
+				break;
+			
+			case Field::en_type::ITEXT:
+				f.pack = pack_itext;
+				break;
+			
+			case Field::en_type::INT:
+				f.pack = pack_int;
+				break;
+			
+			case Field::en_type::IP:
+				f.pack = pack_ip;
+				break;
+			
+			case Field::en_type::PACK:
+				f.pack = pack_pack;
+				break;
+			
+			case Field::en_type::NONE:
+				continue;
+		}
+		
+		fields.push_back(f);
+	}
+	
+	// Pointers are taken once the vector is complete
+	for(size_t i=0;i<fields.size();i++)
+	{
+		names[fields[i].name] = i;
+		if(fields[i].type==Field::en_type::PACK)
+			pack_fields.push_back(&fields[i]);
+	}
+}
+
+const FieldsPlan::st_field *FieldsPlan::Get(const string &name) const
+{
+	auto it = names.find(name);
+	if(it==names.end())
+		return 0;
+	
+	return &fields[it->second];
+}
+
+void FieldsPlan::pack_char(const string &value, st_context &context, st_packed &packed)
+{
+	packed.val_str.assign(value, 0, 128);
+}
+
+void FieldsPlan::pack_text(const string &value, st_context &context, st_packed &packed)
+{
+	packed.val_str.assign(value, 0, 65535);
+}
+
+void FieldsPlan::pack_itext(const string &value, st_context &context, st_packed &packed)
+{
+	packed.val_str.assign(value, 0, 65535);
+	
+	context.sha1.Reset();
+	context.sha1.ProcessBytes(value);
+	packed.sha1 = context.sha1.GetBinary();
+}
+
+void FieldsPlan::pack_int(const string &value, st_context &context, st_packed &packed)
+{
+	try
+	{
+		packed.val_int = stoi(value);
+	}
+	catch(...)
+	{
+		throw Exception("Field", "Invalid integer : "+value);
+	}
+}
+
+void FieldsPlan::pack_ip(const string &value, st_context &context, st_packed &packed)
+{
+	char bin[16];
+	
+	if(inet_pton(AF_INET, value.c_str(), bin))
+		packed.val_str.assign(bin, 4);
+	else if(inet_pton(AF_INET6, value.c_str(), bin))
+		packed.val_str.assign(bin, 16);
+	else
+		throw Exception("Field", "Invalid IP : "+value);
+}
+
+void FieldsPlan::pack_pack(const string &value, st_context &context, st_packed &packed)
+{
+	packed.val_int = PackDictionary::GetInstance()->Pack(value);
+}
+
+}
@@ -18,6 +18,8 @@
  */
 
 #include <ELogs/GC.h>
+#include <ELogs/LogStorage.h>
+#include <ELogs/LogBackend.h>
 #include <DB/DB.h>
 #include <DB/GarbageCollector.h>
 #include <Logger/Logger.h>
@@ -45,7 +47,6 @@ void GC::APIReady()
 int GC::purge(time_t now)
 {
 	DB db("elog");
-	DB db2(&db);
 	
 	int deleted_rows = 0;
 	
@@ -55,28 +56,16 @@ int GC::purge(time_t now)
 	int limit = config->GetInt("gc.limit");
 	int elogs_logs_retention = config->GetInt("gc.elogs.logs.retention");
 	int elogs_triggers_retention = config->GetInt("gc.elogs.triggers.retention");
-	string dbname = config->Get("elog.mysql.database");
 	
 	string date = Utils::Date::PastDate(elogs_triggers_retention * 86400, now);
 	db.QueryPrintf("DELETE FROM t_alert_trigger WHERE alert_trigger_date <= %s LIMIT %i", {&date,&limit});
 	deleted_rows += db.AffectedRows();
 	
-	db.QueryPrintf(
-		"SELECT PARTITION_NAME FROM information_schema.partitions WHERE TABLE_SCHEMA=%s AND TABLE_NAME = 't_log' AND PARTITION_NAME IS NOT NULL ORDER BY PARTITION_DESCRIPTION DESC LIMIT 30 OFFSET %i",
-		{&dbname, &elogs_logs_retention}
-	);
+	date = Utils::Date::PastDate(elogs_logs_retention * 86400, now);
+	db.QueryPrintf("DELETE FROM t_log_rollup WHERE rollup_minute < %s LIMIT %i", {&date,&limit});
+	deleted_rows += db.AffectedRows();
 	
-	while(db.FetchRow())
-	{
-		db2.Query("ALTER TABLE t_log DROP PARTITION "+db.GetField(0));
-		db2.Query("ALTER TABLE t_value_char DROP PARTITION "+db.GetField(0));
-		db2.Query("ALTER TABLE t_value_text DROP PARTITION "+db.GetField(0));
-		db2.Query("ALTER TABLE t_value_itext DROP PARTITION "+db.GetField(0));
-		db2.Query("ALTER TABLE t_value_ip DROP PARTITION "+db.GetField(0));
-		db2.Query("ALTER TABLE t_value_pack DROP PARTITION "+db.GetField(0));
-		db2.Query("ALTER TABLE t_value_int DROP PARTITION "+db.GetField(0));
-		deleted_rows++;
-	}
+	deleted_rows += LogStorage::GetInstance()->GetBackend()->Purge(now, elogs_logs_retention);
 	
 	return deleted_rows;
 }
@@ -0,0 +1,553 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#include <ELogs/LogSegment.h>
+#include <Exception/Exception.h>
+
+#include <set>
+
+#include <zlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+using namespace std;
+
+namespace ELogs
+{
+
+string LogSegment::st_column::GetString(unsigned int row) const
+{
+	if(nulls[row])
+		return "";
+	
+	return is_int?to_string(ints[row]):strs[row];
+}
+
+void LogSegment::Builder::AddRow(const map<unsigned int, long long> &ints, const map<unsigned int, string> &strs)
+{
+	// Check types before modifying anything so a rejected row leaves columns aligned
+	for(auto it = ints.begin(); it!=ints.end(); ++it)
+	{
+		auto it_type = types.find(it->first);
+		if(it_type!=types.end() && !it_type->second)
+			throw Exception("LogSegment", "Column "+to_string(it->first)+" is not an integer column");
+	}
+	
+	for(auto it = strs.begin(); it!=strs.end(); ++it)
+	{
+		auto it_type = types.find(it->first);
+		if(it_type!=types.end() && it_type->second)
+			throw Exception("LogSegment", "Column "+to_string(it->first)+" is not a string column");
+	}
+	
+	// New columns are NULL for previous rows of the chunk
+	for(auto it = ints.begin(); it!=ints.end(); ++it)
+	{
+		types[it->first] = true;
+		if(columns.find(it->first)!=columns.end())
+			continue;
+		
+		st_column &column = columns[it->first];
+		column.is_int = true;
+		column.nulls.assign(chunk_rows, true);
+		column.ints.assign(chunk_rows, 0);
+	}
+	
+	for(auto it = strs.begin(); it!=strs.end(); ++it)
+	{
+		types[it->first] = false;
+		if(columns.find(it->first)!=columns.end())
+			continue;
+		
+		st_column &column = columns[it->first];
+		column.nulls.assign(chunk_rows, true);
+		column.strs.assign(chunk_rows, "");
+	}
+	
+	for(auto it = columns.begin(); it!=columns.end(); ++it)
+	{
+		st_column &column = it->second;
+		if(column.is_int)
+		{
+			auto it_val = ints.find(it->first);
+			column.nulls.push_back(it_val==ints.end());
+			column.ints.push_back(it_val==ints.end()?0:it_val->second);
+		}
+		else
+		{
+			auto it_val = strs.find(it->first);
+			column.nulls.push_back(it_val==strs.end());
+			column.strs.push_back(it_val==strs.end()?"":it_val->second);
+		}
+	}
+	
+	chunk_rows++;
+	nrows++;
+	
+	if(chunk_rows>=LOGSEGMENT_CHUNK_ROWS)
+		seal();
+}
+
+vector<shared_ptr<const LogSegment>> LogSegment::Builder::Snapshot()
+{
+	// Sealed chunks are never modified, queries can share them instead of copying rows
+	seal();
+	
+	return chunks;
+}
+
+void LogSegment::Builder::seal()
+{
+	if(chunk_rows==0)
+		return;
+	
+	auto data = make_shared<map<unsigned int, st_column>>();
+	data->swap(columns);
+	chunks.push_back(shared_ptr<const LogSegment>(new LogSegment(data, chunk_rows)));
+	chunk_rows = 0;
+}
+
+void LogSegment::Builder::Write(const string &filename) const
+{
+	// Chunks are concatenated, columns a chunk has no value for are NULL for its rows
+	map<unsigned int, st_column> merged;
+	for(auto it = types.begin(); it!=types.end(); ++it)
+		merged[it->first].is_int = it->second;
+	
+	auto append = [&merged](const map<unsigned int, st_column> &chunk_columns, unsigned int chunk_nrows) {
+		for(auto it = merged.begin(); it!=merged.end(); ++it)
+		{
+			st_column &column = it->second;
+			auto it_chunk = chunk_columns.find(it->first);
+			if(it_chunk==chunk_columns.end())
+			{
+				column.nulls.insert(column.nulls.end(), chunk_nrows, true);
+				if(column.is_int)
+					column.ints.insert(column.ints.end(), chunk_nrows, 0);
+				else
+					column.strs.insert(column.strs.end(), chunk_nrows, "");
+				continue;
+			}
+			
+			const st_column &chunk_column = it_chunk->second;
+			column.nulls.insert(column.nulls.end(), chunk_column.nulls.begin(), chunk_column.nulls.end());
+			column.ints.insert(column.ints.end(), chunk_column.ints.begin(), chunk_column.ints.end());
+			column.strs.insert(column.strs.end(), chunk_column.strs.begin(), chunk_column.strs.end());
+		}
+	};
+	
+	for(size_t i=0;i<chunks.size();i++)
+		append(*chunks[i]->data, chunks[i]->nrows);
+	append(columns, chunk_rows);
+	
+	string header, data;
+	
+	write_varint(header, nrows);
+	write_varint(header, merged.size());
+	
+	for(auto it = merged.begin(); it!=merged.end(); ++it)
+	{
+		st_column_desc desc = describe(it->second, nrows);
+		
+		string raw;
+		encode(it->second, desc, raw);
+		
+		uLongf compressed_length = compressBound(raw.size());
+		string compressed(compressed_length, '\0');
+		if(compress2((Bytef *)&compressed[0], &compressed_length, (const Bytef *)raw.c_str(), raw.size(), Z_BEST_SPEED)!=Z_OK)
+			throw Exception("LogSegment", "Unable to compress column "+to_string(it->first));
+		
+		desc.offset = data.size();
+		desc.length = compressed_length;
+		desc.raw_length = raw.size();
+		data.append(compressed, 0, compressed_length);
+		
+		write_varint(header, it->first);
+		header += (char)((desc.is_int?1:0) | (desc.has_nulls?2:0) | (desc.is_dict?4:0));
+		if(desc.is_int)
+		{
+			write_varint(header, zigzag(desc.min_int));
+			write_varint(header, zigzag(desc.max_int));
+		}
+		
+		if(desc.is_dict)
+		{
+			write_varint(header, desc.dict.size());
+			for(size_t i=0;i<desc.dict.size();i++)
+				write_string(header, desc.dict[i]);
+		}
+		
+		write_varint(header, desc.offset);
+		write_varint(header, desc.length);
+		write_varint(header, desc.raw_length);
+	}
+	
+	string file(LOGSEGMENT_MAGIC, 8);
+	unsigned int header_length = header.size();
+	for(int i=0;i<4;i++)
+		file += (char)((header_length >> (8*i)) & 0xFF);
+	file += header;
+	file += data;
+	
+	int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0640);
+	if(fd<0)
+		throw Exception("LogSegment", "Unable to create segment "+filename+" : "+strerror(errno));
+	
+	size_t written = 0;
+	while(written<file.size())
+	{
+		ssize_t n = write(fd, file.c_str()+written, file.size()-written);
+		if(n<0 && errno==EINTR)
+			continue;
+		
+		if(n<0)
+		{
+			int write_errno = errno;
+			close(fd);
+			throw Exception("LogSegment", "Unable to write segment "+filename+" : "+strerror(write_errno));
+		}
+		
+		written += n;
+	}
+	
+	// Segment is renamed in place once written, it must not become visible before its data is on disk
+	if(fsync(fd)!=0)
+	{
+		int sync_errno = errno;
+		close(fd);
+		throw Exception("LogSegment", "Unable to sync segment "+filename+" : "+strerror(sync_errno));
+	}
+	
+	close(fd);
+}
+
+LogSegment::LogSegment(const string &filename)
+{
+	this->filename = filename;
+	
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd<0)
+		throw Exception("LogSegment", "Unable to open segment "+filename+" : "+strerror(errno));
+	
+	struct stat st;
+	if(fstat(fd, &st)!=0)
+	{
+		int stat_errno = errno;
+		close(fd);
+		throw Exception("LogSegment", "Unable to stat segment "+filename+" : "+strerror(stat_errno));
+	}
+	
+	char prefix[12];
+	if(pread(fd, prefix, 12, 0)!=12 || memcmp(prefix, LOGSEGMENT_MAGIC, 8)!=0)
+	{
+		close(fd);
+		throw Exception("LogSegment", "Invalid segment "+filename);
+	}
+	
+	header_length = 0;
+	for(int i=0;i<4;i++)
+		header_length |= ((unsigned int)(unsigned char)prefix[8+i]) << (8*i);
+	
+	// Do not trust the header length before allocating it
+	unsigned long long data_length = st.st_size - 12;
+	if(header_length>data_length)
+	{
+		close(fd);
+		throw Exception("LogSegment", "Invalid header length in segment "+filename);
+	}
+	
+	data_length -= header_length;
+	
+	string header(header_length, '\0');
+	if(pread(fd, &header[0], header_length, 12)!=(ssize_t)header_length)
+	{
+		close(fd);
+		throw Exception("LogSegment", "Truncated segment "+filename);
+	}
+	
+	close(fd);
+	
+	size_t pos = 0;
+	nrows = read_varint(header, pos);
+	unsigned int ncols = read_varint(header, pos);
+	for(unsigned int i=0;i<ncols;i++)
+	{
+		unsigned int id = read_varint(header, pos);
+		if(pos>=header.size())
+			throw Exception("LogSegment", "Truncated segment "+filename);
+		
+		st_column_desc &desc = columns[id];
+		unsigned char flags = header[pos++];
+		desc.is_int = flags & 1;
+		desc.has_nulls = flags & 2;
+		desc.is_dict = flags & 4;
+		
+		if(desc.is_int)
+		{
+			desc.min_int = unzigzag(read_varint(header, pos));
+			desc.max_int = unzigzag(read_varint(header, pos));
+		}
+		
+		if(desc.is_dict)
+		{
+			unsigned int ndict = read_varint(header, pos);
+			for(unsigned int j=0;j<ndict;j++)
+				desc.dict.push_back(read_string(header, pos));
+		}
+		
+		desc.offset = read_varint(header, pos);
+		desc.length = read_varint(header, pos);
+		desc.raw_length = read_varint(header, pos);
+		
+		if(desc.offset>data_length || desc.length>data_length-desc.offset)
+			throw Exception("LogSegment", "Column "+to_string(id)+" is out of segment "+filename);
+	}
+}
+
+LogSegment::LogSegment(shared_ptr<map<unsigned int, st_column>> data, unsigned int nrows)
+{
+	this->nrows = nrows;
+	header_length = 0;
+	this->data = data;
+	
+	for(auto it = data->begin(); it!=data->end(); ++it)
+		columns[it->first] = describe(it->second, nrows);
+}
+
+const LogSegment::st_column_desc *LogSegment::GetColumn(unsigned int id) const
+{
+	auto it = columns.find(id);
+	if(it==columns.end())
+		return 0;
+	
+	return &it->second;
+}
+
+void LogSegment::ReadColumn(unsigned int id, st_column &column) const
+{
+	auto it = columns.find(id);
+	if(it==columns.end())
+	{
+		// Column has no value in this segment
+		column.is_int = false;
+		column.nulls.assign(nrows, true);
+		column.ints.assign(nrows, 0);
+		column.strs.assign(nrows, "");
+		return;
+	}
+	
+	if(data)
+	{
+		column = data->at(id);
+		return;
+	}
+	
+	const st_column_desc &desc = it->second;
+	
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd<0)
+		throw Exception("LogSegment", "Unable to open segment "+filename+" : "+strerror(errno));
+	
+	string compressed(desc.length, '\0');
+	ssize_t n = pread(fd, &compressed[0], desc.length, 12 + header_length + desc.offset);
+	close(fd);
+	
+	if(n!=desc.length)
+		throw Exception("LogSegment", "Truncated segment "+filename);
+	
+	string raw(desc.raw_length, '\0');
+	uLongf raw_length = desc.raw_length;
+	if(uncompress((Bytef *)&raw[0], &raw_length, (const Bytef *)compressed.c_str(), compressed.size())!=Z_OK || raw_length!=desc.raw_length)
+		throw Exception("LogSegment", "Corrupted column "+to_string(id)+" in segment "+filename);
+	
+	decode(raw, desc, nrows, column);
+}
+
+LogSegment::st_column_desc LogSegment::describe(const st_column &column, unsigned int nrows)
+{
+	st_column_desc desc;
+	desc.is_int = column.is_int;
+	
+	bool has_value = false;
+	unsigned int nvalues = 0;
+	set<string> distinct;
+	
+	for(unsigned int i=0;i<nrows;i++)
+	{
+		if(column.nulls[i])
+		{
+			desc.has_nulls = true;
+			continue;
+		}
+		
+		nvalues++;
+		
+		if(column.is_int)
+		{
+			if(!has_value || column.ints[i]<desc.min_int)
+				desc.min_int = column.ints[i];
+			if(!has_value || column.ints[i]>desc.max_int)
+				desc.max_int = column.ints[i];
+			has_value = true;
+		}
+		else if(distinct.size()<=LOGSEGMENT_DICT_MAX)
+			distinct.insert(column.strs[i]);
+	}
+	
+	// Dictionary is both an index and a compression, only use it when values repeat
+	if(!column.is_int && distinct.size()<=LOGSEGMENT_DICT_MAX && distinct.size()<nvalues)
+	{
+		desc.is_dict = true;
+		desc.dict.assign(distinct.begin(), distinct.end());
+	}
+	
+	return desc;
+}
+
+void LogSegment::encode(const st_column &column, const st_column_desc &desc, string &buf)
+{
+	if(desc.has_nulls)
+	{
+		string bitmap((column.nulls.size()+7)/8, '\0');
+		for(size_t i=0;i<column.nulls.size();i++)
+			if(column.nulls[i])
+				bitmap[i/8] |= 1 << (i%8);
+		buf += bitmap;
+	}
+	
+	map<string, unsigned int> dict_index;
+	for(size_t i=0;i<desc.dict.size();i++)
+		dict_index[desc.dict[i]] = i;
+	
+	long long prev = 0;
+	for(size_t i=0;i<column.nulls.size();i++)
+	{
+		if(column.nulls[i])
+			continue;
+		
+		if(desc.is_int)
+		{
+			// Log IDs and times are increasing, deltas are small
+			write_varint(buf, zigzag(column.ints[i] - prev));
+			prev = column.ints[i];
+		}
+		else if(desc.is_dict)
+			buf += (char)dict_index[column.strs[i]];
+		else
+			write_string(buf, column.strs[i]);
+	}
+}
+
+void LogSegment::decode(const string &buf, const st_column_desc &desc, unsigned int nrows, st_column &column)
+{
+	size_t pos = 0;
+	
+	column.is_int = desc.is_int;
+	column.nulls.assign(nrows, false);
+	column.ints.clear();
+	column.strs.clear();
+	
+	if(desc.has_nulls)
+	{
+		if(buf.size()<(nrows+7)/8)
+			throw Exception("LogSegment", "Corrupted nulls bitmap");
+		
+		for(unsigned int i=0;i<nrows;i++)
+			column.nulls[i] = (buf[i/8] >> (i%8)) & 1;
+		pos = (nrows+7)/8;
+	}
+	
+	if(desc.is_int)
+		column.ints.assign(nrows, 0);
+	else
+		column.strs.assign(nrows, "");
+	
+	long long prev = 0;
+	for(unsigned int i=0;i<nrows;i++)
+	{
+		if(column.nulls[i])
+			continue;
+		
+		if(desc.is_int)
+		{
+			prev += unzigzag(read_varint(buf, pos));
+			column.ints[i] = prev;
+		}
+		else if(desc.is_dict)
+		{
+			if(pos>=buf.size() || (unsigned char)buf[pos]>=desc.dict.size())
+				throw Exception("LogSegment", "Corrupted dictionary column");
+			column.strs[i] = desc.dict[(unsigned char)buf[pos++]];
+		}
+		else
+			column.strs[i] = read_string(buf, pos);
+	}
+}
+
+void LogSegment::write_varint(string &buf, unsigned long long v)
+{
+	while(v>=0x80)
+	{
+		buf += (char)((v & 0x7F) | 0x80);
+		v >>= 7;
+	}
+	
+	buf += (char)v;
+}
+
+unsigned long long LogSegment::read_varint(const string &buf, size_t &pos)
+{
+	unsigned long long v = 0;
+	for(int shift=0;shift<64;shift+=7)
+	{
+		if(pos>=buf.size())
+			throw Exception("LogSegment", "Truncated varint");
+		
+		unsigned char c = buf[pos++];
+		v |= ((unsigned long long)(c & 0x7F)) << shift;
+		if(!(c & 0x80))
+			return v;
+	}
+	
+	throw Exception("LogSegment", "Invalid varint");
+}
+
+void LogSegment::write_string(string &buf, const string &str)
+{
+	write_varint(buf, str.size());
+	buf += str;
+}
+
+string LogSegment::read_string(const string &buf, size_t &pos)
+{
+	size_t len = read_varint(buf, pos);
+	if(pos+len>buf.size())
+		throw Exception("LogSegment", "Truncated string");
+	
+	string str = buf.substr(pos, len);
+	pos += len;
+	return str;
+}
+
+}
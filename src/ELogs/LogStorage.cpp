@@ -18,19 +18,22 @@
  */
 
 #include <ELogs/LogStorage.h>
+#include <ELogs/LogStorageWorker.h>
+#include <ELogs/StreamIngest.h>
 #include <Exception/Exception.h>
 #include <DB/DB.h>
 #include <Logger/Logger.h>
 #include <WS/Events.h>
-#include <ELogs/Channels.h>
-#include <ELogs/Channel.h>
-#include <ELogs/ChannelGroup.h>
+#include <ELogs/LogBackend.h>
+#include <ELogs/Rollups.h>
+#include <ELogs/PackDictionary.h>
 #include <Configuration/Configuration.h>
-#include <Crypto/Sha1String.h>
 #include <API/QueryHandlers.h>
 #include <IO/NetworkConnections.h>
 
-#include <vector>
+#include <functional>
+
+#include <ctype.h>
 
 #include <nlohmann/json.hpp>
 
@@ -59,295 +62,104 @@ static auto init = QueryHandlers::GetInstance()->RegisterInit([](QueryHandlers *
 	if(config->Get("elog.bind.ip")!="")
 	{
 		nc->RegisterUDP("ELogs (udp)", config->Get("elog.bind.ip"), config->GetInt("elog.bind.port"), config->GetSize("elog.log.maxsize"), [](char *buf, size_t len) {
-			LogStorage::GetInstance()->Log(string(buf, len));
+			if(!LogStorage::GetInstance()->Log(string(buf, len)))
+				Logger::Log(LOG_WARNING,"External logs queue size is full, discarding log");
 		});
 	}
 	
+	// Stream sockets, senders are slowed down instead of losing logs
+	NetworkConnections::t_stream_handler stream_handler = [](int s) {
+		LogStorage::GetInstance()->GetStreamIngest()->Accept(s);
+	};
+	
+	if(config->Get("elog.stream.bind.ip")!="")
+		nc->RegisterTCP("ELogs (tcp)", config->Get("elog.stream.bind.ip"), config->GetInt("elog.stream.bind.port"), config->GetInt("elog.stream.listen.backlog"), stream_handler);
+	
+	if(config->Get("elog.stream.bind.path")!="")
+		nc->RegisterUNIX("ELogs (unix)", config->Get("elog.stream.bind.path"), config->GetInt("elog.stream.listen.backlog"), stream_handler);
+	
 	Events::GetInstance()->RegisterEvent("LOG_ELOG");
 	
 	return (APIAutoInit *)new LogStorage();
 });
 
-LogStorage::LogStorage(): ConsumerThread(this), channel_regex("([a-zA-Z0-9_-]+)[ ]+")
+LogStorage::LogStorage()
 {
-	DB db("elog");
-	storage_db = new DB("elog");
-	
 	Configuration *config = Configuration::GetInstance();
-	max_queue_size = config->GetInt("elog.queue.size");
-	bulk_size = config->GetInt("elog.bulk.size");
-	
-	db.Query("SELECT pack_id, pack_string FROM t_pack");
-	while(db.FetchRow())
-	{
-		pack_str_id[db.GetField(1)] = db.GetFieldInt(0);
-		pack_id_str[db.GetFieldInt(0)] = db.GetField(1);
-	}
-	
-	string dbname = config->Get("elog.mysql.database");
-	db.QueryPrintf(
-		"SELECT PARTITION_DESCRIPTION FROM information_schema.partitions WHERE TABLE_SCHEMA=%s AND TABLE_NAME = 't_log' AND PARTITION_NAME IS NOT NULL ORDER BY PARTITION_DESCRIPTION DESC LIMIT 1",
-		{&dbname}
-	);
-	
-	if(db.FetchRow())
-		last_partition_days = db.GetFieldInt(0);
-	
-	instance = this;
-	
-	start(); // Start consumer thread
-}
-
-LogStorage::~LogStorage()
-{
-	Shutdown();
-	
-	delete storage_db;
-}
-
-bool LogStorage::data_available()
-{
-	return logs.size()>0;
-}
-
-void LogStorage::init_thread()
-{
-	DB::StartThread();
+	ids_block = config->GetInt("elog.storage.ids");
+	watermark = 0;
 	
-	Logger::Log(LOG_NOTICE,"Log storage started");
-}
-
-void LogStorage::release_thread()
-{
-	Logger::Log(LOG_NOTICE,"Shutdown in progress exiting Log storage");
+	dictionary = new PackDictionary();
 	
-	DB::StopThread();
-}
-
-void LogStorage::get()
-{
-	LogStorage *ls = (LogStorage *)producer;
+	backend = LogBackend::Create();
 	
-	to_insert_logs.clear();
-		
-	for(int i=0;i<ls->bulk_size && !ls->logs.empty();i++)
+	if(config->GetBool("elog.rollups.enable"))
+		rollups = new Rollups();
+	else
 	{
-		to_insert_logs.push_back(ls->logs.front());
-		ls->logs.pop();
+		rollups = 0;
+		Rollups::Reset();
 	}
-}
-
-void LogStorage::process()
-{
-	LogStorage *ls = (LogStorage *)producer;
 	
-	try
-	{
-		ls->log(to_insert_logs);
-	}
-	catch(Exception &e)
-	{
-		Logger::Log(LOG_ERR,"Unexpected exception in log storage ("+e.context+") : "+e.error);
-	}
-}
-
-void LogStorage::Log(const std::string &str)
-{
-	unique_lock<mutex> llock(lock);
+	instance = this;
 	
-	if(logs.size()>=max_queue_size)
-	{
-		Logger::Log(LOG_WARNING,"External logs queue size is full, discarding log");
-		return;
-	}
-		
+	int nworkers = config->GetInt("elog.storage.workers");
+	for(int i=0;i<nworkers;i++)
+		workers.push_back(new LogStorageWorker(this));
 	
-	logs.push(str);
-	produced();
+	stream = new StreamIngest(this);
 }
 
-void LogStorage::log(const vector<string> &logs)
+LogStorage::~LogStorage()
 {
-	smatch matches;
-	
-	// Compute logs id range
-	int nlogs = logs.size();
-	storage_db->QueryPrintf("UPDATE t_seq SET seq_value=last_insert_id(seq_value + %i) where seq_name='log_id'",{&nlogs});
-	next_log_id = storage_db->InsertIDLong() - nlogs;
-	
-	storage_db->BulkStart(Field::en_type::NONE, "t_log", "log_id, channel_id, log_date, log_crit", 4);
-	storage_db->BulkStart(Field::en_type::CHAR, "t_value_char", "log_id, field_id, log_date, value", 4);
-	storage_db->BulkStart(Field::en_type::INT, "t_value_int", "log_id, field_id, log_date, value", 4);
-	storage_db->BulkStart(Field::en_type::IP, "t_value_ip", "log_id, field_id, log_date, value", 4);
-	storage_db->BulkStart(Field::en_type::PACK, "t_value_pack", "log_id, field_id, log_date, value", 4);
-	storage_db->BulkStart(Field::en_type::TEXT, "t_value_text", "log_id, field_id, log_date, value", 4);
-	storage_db->BulkStart(Field::en_type::ITEXT, "t_value_itext", "log_id, field_id, log_date, value, value_sha1", 5);
-	
-	for(int i=0;i<logs.size();i++)
-	{
-		string log_str;
-		
-		try
-		{
-			if(!regex_search(logs[i], matches, channel_regex))
-				throw Exception("LogStorage", "unable to get log message channel");
-			
-			if(matches.size()!=2)
-				throw Exception("LogStorage", "unable to get log message channel");
-			
-			string channel_name = matches[1];
-			log_str = logs[i].substr(matches[0].length());
-			
-			const Channel channel = Channels::GetInstance()->Get(channel_name);
-			
-			map<string, string> group_fields, channel_fields;
-			channel.ParseLog(log_str, group_fields, channel_fields);
-			
-			store_log(channel, group_fields, channel_fields);
-		}
-		catch(Exception &e)
-		{
-			Logger::Log(LOG_ERR, "Error parsing extern log in "+e.context+" : "+e.error+". Log is : "+log_str);
-		}
-	}
-	
-	storage_db->StartTransaction();
+	// Stop stream connections first, they may be waiting on workers queues
+	delete stream;
 	
-	try
+	for(int i=0;i<workers.size();i++)
 	{
-		storage_db->BulkExec(Field::en_type::NONE);
-		storage_db->BulkExec(Field::en_type::CHAR);
-		storage_db->BulkExec(Field::en_type::INT);
-		storage_db->BulkExec(Field::en_type::IP);
-		storage_db->BulkExec(Field::en_type::PACK);
-		storage_db->BulkExec(Field::en_type::TEXT);
-		storage_db->BulkExec(Field::en_type::ITEXT);
+		workers[i]->Shutdown();
+		delete workers[i];
 	}
-	catch(Exception &e)
-	{
-		Logger::Log(LOG_ERR, "Error parsing extern log in "+e.context+" : "+e.error);
-	}
-	
-	storage_db->CommitTransaction();
 	
-	Events::GetInstance()->Create("LOG_ELOG");
+	// Backend flushes remaining segments, it may need rollups
+	delete backend;
+	delete rollups;
+	delete dictionary;
 }
 
-void LogStorage::store_log(const Channel &channel, const map<string, string> &group_fields, const map<string, string> &channel_fields)
+bool LogStorage::Log(const std::string &str, int wait_ms)
 {
-	const ChannelGroup group = channel.GetGroup();
-	unsigned long long log_id = next_log_id++;
-	string date = group_fields.find("date")->second;
-	
-	// Check if partition exists for the log line
-	if(DB::TO_DAYS(date)>=last_partition_days)
-		create_partition(date);
-	
-	// Insert log line
-	storage_db->BulkDataLong(Field::en_type::NONE, log_id);
-	storage_db->BulkDataInt(Field::en_type::NONE, channel.GetID());
-	storage_db->BulkDataString(Field::en_type::NONE, date);
-	storage_db->BulkDataInt(Field::en_type::NONE, Field::PackCrit(group_fields.find("crit")->second));
-	
-	
-	for(auto it = group_fields.begin(); it!=group_fields.end(); ++it)
-	{
-		if(it->first=="date" || it->first=="crit")
-			continue;
-		
-		log_value(log_id, group.GetFields().Get(it->first), date, it->second);
-	}
-	
-	for(auto it = channel_fields.begin(); it!=channel_fields.end(); ++it)
-		log_value(log_id, channel.GetFields().Get(it->first), date, it->second);
+	// A channel is always stored by the same worker, so its logs are stored in order
+	size_t worker = hash<string>()(get_channel_name(str)) % workers.size();
+	return workers[worker]->Log(str, wait_ms);
 }
 
-void LogStorage::log_value(unsigned long long log_id, const Field &field, const string &date, const string &value)
+unsigned long long LogStorage::AllocateLogIDs(DB *db, int n)
 {
-	auto type = field.GetType();
+	unique_lock<mutex> llock(ids_lock);
 	
-	int pack_i;
-	string pack_str;
-	field.Pack(value, &pack_i, &pack_str);
-	
-	storage_db->BulkDataLong(type, log_id);
-	storage_db->BulkDataInt(type, field.GetID());
-	storage_db->BulkDataString(type, date);
-	if(field.GetType()==Field::en_type::ITEXT)
+	if(end_log_id-next_log_id<n)
 	{
-		storage_db->BulkDataString(type, pack_str.substr(0, 65535));
-		storage_db->BulkDataString(type, Sha1String(pack_str).GetBinary());
+		// Reserve a block at once, so workers do not all update t_seq for each batch
+		// Nodes reserve their own blocks, so IDs do not follow dates in a cluster: logs lists are sorted by date first
+		int nreserve = n>ids_block?n:ids_block;
+		db->QueryPrintf("UPDATE t_seq SET seq_value=last_insert_id(seq_value + %i) where seq_name='log_id'",{&nreserve});
+		end_log_id = db->InsertIDLong();
+		next_log_id = end_log_id - nreserve;
 	}
-	else if(field.GetType()==Field::en_type::TEXT)
-		storage_db->BulkDataString(type, pack_str.substr(0, 65535));
-	else if(field.GetType()==Field::en_type::CHAR)
-		storage_db->BulkDataString(type, pack_str.substr(0, 128));
-	else if(field.GetDBType()=="%i")
-		storage_db->BulkDataInt(type, pack_i);
-	else if(field.GetDBType()=="%s")
-		storage_db->BulkDataString(type, pack_str);
-}
-
-unsigned int LogStorage::PackString(const string &str)
-{
-	unique_lock<mutex> llock(lock);
-	
-	auto it = pack_str_id.find(str);
 	
-	if(it!=pack_str_id.end())
-		return it->second;
-	
-	DB db("elog");
-	db.QueryPrintf("REPLACE INTO t_pack(pack_string) VALUES(%s)", {&str});
-	
-	unsigned int id = db.InsertID();
-	pack_str_id[str] = id;
-	pack_id_str[id] = str;
-	
-	return id;
+	unsigned long long first_log_id = next_log_id;
+	next_log_id += n;
+	return first_log_id;
 }
 
-string LogStorage::UnpackString(int i)
+string LogStorage::get_channel_name(const string &str)
 {
-	unique_lock<mutex> llock(lock);
-	
-	auto it = pack_id_str.find(i);
-	
-	if(it!=pack_id_str.end())
-		return it->second;
-	
-	// Try to load value from database if not in cache
-	{
-		DB db("elog");
-
-		db.QueryPrintf("SELECT pack_string FROM t_pack WHERE pack_id=%i", {&i});
-		if(db.FetchRow())
-		{
-			pack_id_str[i] = db.GetField(0);
-			pack_str_id[db.GetField(0)] = i;
-			return db.GetField(0);
-		}
-	}
-	return "";
-}
-
-void LogStorage::create_partition(const string &date)
-{
-	string part_name = "p"+date.substr(0, 4)+date.substr(5, 2)+date.substr(8, 2);
-	unsigned int days = DB::TO_DAYS(date) + 1;
-	
-	if(days<=last_partition_days)
-		return; // Nothing to do
-	
-	storage_db->QueryPrintf("ALTER TABLE t_log ADD PARTITION (PARTITION "+part_name+" VALUES LESS THAN (%i))", {&days});
-	storage_db->QueryPrintf("ALTER TABLE t_value_char ADD PARTITION (PARTITION "+part_name+" VALUES LESS THAN (%i))", {&days});
-	storage_db->QueryPrintf("ALTER TABLE t_value_text ADD PARTITION (PARTITION "+part_name+" VALUES LESS THAN (%i))", {&days});
-	storage_db->QueryPrintf("ALTER TABLE t_value_itext ADD PARTITION (PARTITION "+part_name+" VALUES LESS THAN (%i))", {&days});
-	storage_db->QueryPrintf("ALTER TABLE t_value_ip ADD PARTITION (PARTITION "+part_name+" VALUES LESS THAN (%i))", {&days});
-	storage_db->QueryPrintf("ALTER TABLE t_value_int ADD PARTITION (PARTITION "+part_name+" VALUES LESS THAN (%i))", {&days});
-	storage_db->QueryPrintf("ALTER TABLE t_value_pack ADD PARTITION (PARTITION "+part_name+" VALUES LESS THAN (%i))", {&days});
+	size_t i = 0;
+	while(i<str.length() && (isalnum(str[i]) || str[i]=='_' || str[i]=='-'))
+		i++;
 	
-	last_partition_days = days;
+	return str.substr(0, i);
 }
 
 }
@@ -0,0 +1,269 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#include <ELogs/LogStorageWorker.h>
+#include <ELogs/LogStorage.h>
+#include <Exception/Exception.h>
+#include <DB/DB.h>
+#include <Logger/Logger.h>
+#include <WS/Events.h>
+#include <ELogs/Channels.h>
+#include <ELogs/Channel.h>
+#include <ELogs/ChannelGroup.h>
+#include <ELogs/Alerts.h>
+#include <ELogs/PackDictionary.h>
+#include <ELogs/Fields.h>
+#include <ELogs/FieldsPlan.h>
+#include <Configuration/Configuration.h>
+
+using namespace std;
+
+namespace ELogs
+{
+
+LogStorageWorker::LogStorageWorker(LogStorage *storage): ConsumerThread(this), channel_regex("([a-zA-Z0-9_-]+)[ ]+")
+{
+	this->storage = storage;
+	
+	storage_db = new DB("elog");
+	
+	Configuration *config = Configuration::GetInstance();
+	max_queue_size = config->GetInt("elog.queue.size");
+	bulk_size = config->GetInt("elog.bulk.size");
+	
+	writer = storage->GetBackend()->CreateWriter();
+	
+	// Backends buffering rows must be able to flush them when no more logs are received
+	idle_timeout = 1;
+	
+	start(); // Start consumer thread
+}
+
+LogStorageWorker::~LogStorageWorker()
+{
+	delete writer;
+	delete storage_db;
+}
+
+bool LogStorageWorker::data_available()
+{
+	return logs.size()>0;
+}
+
+void LogStorageWorker::idle()
+{
+	try
+	{
+		writer->Idle();
+	}
+	catch(Exception &e)
+	{
+		Logger::Log(LOG_ERR,"Unexpected exception in idle log storage ("+e.context+") : "+e.error);
+	}
+}
+
+void LogStorageWorker::init_thread()
+{
+	DB::StartThread();
+	
+	Logger::Log(LOG_NOTICE,"Log storage started");
+}
+
+void LogStorageWorker::release_thread()
+{
+	// Queued logs may already be acknowledged to stream senders, store them before exiting
+	// We hold the queue lock, so stream connections must have been closed before
+	if(logs.size())
+		Logger::Log(LOG_NOTICE,"Storing %d queued logs before exiting Log storage", logs.size());
+	
+	while(!logs.empty())
+	{
+		get();
+		process();
+	}
+	
+	Logger::Log(LOG_NOTICE,"Shutdown in progress exiting Log storage");
+	
+	DB::StopThread();
+}
+
+void LogStorageWorker::get()
+{
+	to_insert_logs.clear();
+	
+	for(int i=0;i<bulk_size && !logs.empty();i++)
+	{
+		to_insert_logs.push_back(logs.front());
+		logs.pop();
+	}
+	
+	space_cond.notify_all();
+}
+
+void LogStorageWorker::process()
+{
+	try
+	{
+		log(to_insert_logs);
+	}
+	catch(Exception &e)
+	{
+		Logger::Log(LOG_ERR,"Unexpected exception in log storage ("+e.context+") : "+e.error);
+	}
+}
+
+bool LogStorageWorker::Log(const std::string &str, int wait_ms)
+{
+	unique_lock<mutex> llock(lock);
+	
+	if(logs.size()>=max_queue_size && wait_ms>0)
+		space_cond.wait_for(llock, chrono::milliseconds(wait_ms), [this] { return logs.size()<max_queue_size; });
+	
+	if(logs.size()>=max_queue_size)
+		return false;
+	
+	logs.push(str);
+	produced();
+	
+	return true;
+}
+
+void LogStorageWorker::log(const vector<string> &logs)
+{
+	smatch matches;
+	
+	// Compute logs id range, this batch is contiguous so logs of a channel keep their order
+	next_log_id = storage->AllocateLogIDs(storage_db, logs.size());
+	
+	// Parse all logs first, so new pack strings are inserted at once
+	vector<st_log> parsed_logs;
+	set<string> pack_strings;
+	
+	for(int i=0;i<logs.size();i++)
+	{
+		string log_str;
+		
+		try
+		{
+			if(!regex_search(logs[i], matches, channel_regex))
+				throw Exception("LogStorage", "unable to get log message channel");
+			
+			if(matches.size()!=2)
+				throw Exception("LogStorage", "unable to get log message channel");
+			
+			string channel_name = matches[1];
+			log_str = logs[i].substr(matches[0].length());
+			
+			st_log log;
+			log.channel = Channels::GetInstance()->Get(channel_name);
+			log.log_str = log_str;
+			log.channel.ParseLog(log_str, log.group_fields, log.channel_fields);
+			
+			get_pack_strings(log.channel.GetGroup().GetFields(), log.group_fields, pack_strings);
+			get_pack_strings(log.channel.GetFields(), log.channel_fields, pack_strings);
+			
+			parsed_logs.push_back(log);
+		}
+		catch(Exception &e)
+		{
+			Logger::Log(LOG_ERR, "Error parsing extern log in "+e.context+" : "+e.error+". Log is : "+log_str);
+		}
+	}
+	
+	try
+	{
+		PackDictionary::GetInstance()->PackBatch(pack_strings);
+	}
+	catch(Exception &e)
+	{
+		Logger::Log(LOG_ERR, "Error storing pack strings in "+e.context+" : "+e.error);
+	}
+	
+	writer->StartBatch();
+	
+	vector<pair<size_t, unsigned long long>> stored_logs;
+	for(size_t i=0;i<parsed_logs.size();i++)
+	{
+		try
+		{
+			unsigned long long log_id = store_log(parsed_logs[i].channel, parsed_logs[i].group_fields, parsed_logs[i].channel_fields);
+			stored_logs.push_back({i, log_id});
+		}
+		catch(Exception &e)
+		{
+			Logger::Log(LOG_ERR, "Error parsing extern log in "+e.context+" : "+e.error+". Log is : "+parsed_logs[i].log_str);
+		}
+	}
+	
+	try
+	{
+		writer->CommitBatch(rollup_counters);
+	}
+	catch(Exception &e)
+	{
+		// Nothing of this batch is visible, so nothing is notified nor matched
+		Logger::Log(LOG_ERR, "Error storing logs batch in "+e.context+" : "+e.error+", "+to_string(stored_logs.size())+" logs are lost");
+		return;
+	}
+	
+	if(parsed_logs.size()>0)
+		storage->BatchStored();
+	
+	// Evaluate streaming alerts once logs are durable, so a failed batch never triggers
+	Alerts *alerts = Alerts::GetInstance();
+	if(alerts)
+	{
+		for(size_t i=0;i<stored_logs.size();i++)
+		{
+			const st_log &log = parsed_logs[stored_logs[i].first];
+			alerts->Match(stored_logs[i].second, log.channel, log.group_fields, log.channel_fields);
+		}
+	}
+	
+	Events::GetInstance()->Create("LOG_ELOG");
+}
+
+unsigned long long LogStorageWorker::store_log(const Channel &channel, const map<string, string> &group_fields, const map<string, string> &channel_fields)
+{
+	unsigned long long log_id = next_log_id++;
+	string date = group_fields.find("date")->second;
+	
+	int crit = Field::PackCrit(group_fields.find("crit")->second);
+	
+	writer->Store(log_id, channel, date, crit, group_fields, channel_fields);
+	
+	Rollups *rollups = storage->GetRollups();
+	if(rollups)
+		rollups->Add(rollup_counters, channel, date, crit, group_fields);
+	
+	return log_id;
+}
+
+void LogStorageWorker::get_pack_strings(const Fields &fields, const map<string, string> &values, set<string> &pack_strings)
+{
+	const vector<const FieldsPlan::st_field *> &pack_fields = fields.GetPlan().GetPackFields();
+	for(int i=0;i<pack_fields.size();i++)
+	{
+		auto it_value = values.find(pack_fields[i]->name);
+		if(it_value!=values.end())
+			pack_strings.insert(it_value->second);
+	}
+}
+
+}
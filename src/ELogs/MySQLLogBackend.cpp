@@ -0,0 +1,468 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#include <ELogs/MySQLLogBackend.h>
+#include <ELogs/Partitions.h>
+#include <ELogs/ELog.h>
+#include <ELogs/Channels.h>
+#include <ELogs/Field.h>
+#include <ELogs/Fields.h>
+#include <ELogs/PackDictionary.h>
+#include <Exception/Exception.h>
+#include <DB/DB.h>
+#include <Logger/Logger.h>
+#include <Configuration/Configuration.h>
+#include <Utils/Date.h>
+
+#include <set>
+
+using namespace std;
+
+namespace ELogs
+{
+
+MySQLLogBackend::MySQLLogBackend()
+{
+	partitions = new Partitions();
+}
+
+MySQLLogBackend::~MySQLLogBackend()
+{
+	delete partitions;
+}
+
+LogBackend::Writer *MySQLLogBackend::CreateWriter()
+{
+	return new Writer(partitions);
+}
+
+MySQLLogBackend::Writer::Writer(const Partitions *partitions)
+{
+	storage_db = new DB("elog");
+	this->partitions = partitions;
+	bulk_load = Configuration::GetInstance()->GetBool("elog.bulk.load");
+	
+	// Only logs writers may load data, and only when configured to
+	if(bulk_load)
+		storage_db->EnableLocalInfile();
+}
+
+MySQLLogBackend::Writer::~Writer()
+{
+	delete storage_db;
+}
+
+void MySQLLogBackend::Writer::StartBatch()
+{
+	storage_db->BulkStart(Field::en_type::NONE, "t_log", "log_id, channel_id, log_date, log_crit", 4);
+	storage_db->BulkStart(Field::en_type::CHAR, "t_value_char", "log_id, field_id, log_date, value", 4);
+	storage_db->BulkStart(Field::en_type::INT, "t_value_int", "log_id, field_id, log_date, value", 4);
+	storage_db->BulkStart(Field::en_type::IP, "t_value_ip", "log_id, field_id, log_date, value", 4);
+	storage_db->BulkStart(Field::en_type::PACK, "t_value_pack", "log_id, field_id, log_date, value", 4);
+	storage_db->BulkStart(Field::en_type::TEXT, "t_value_text", "log_id, field_id, log_date, value", 4);
+	storage_db->BulkStart(Field::en_type::ITEXT, "t_value_itext", "log_id, field_id, log_date, value, value_sha1", 5);
+}
+
+void MySQLLogBackend::Writer::Store(unsigned long long log_id, const Channel &channel, const string &date, int crit, const map<string, string> &group_fields, const map<string, string> &channel_fields)
+{
+	const ChannelGroup group = channel.GetGroup();
+	
+	// Partitions are created ahead by the maintenance thread, never from here
+	if(DB::TO_DAYS(date)>=partitions->GetLastPartitionDays())
+		throw Exception("LogStorage", "No partition available for date "+date+", log is discarded");
+	
+	// Pack all values first, an invalid value discards the whole log
+	packed.clear();
+	vector<const FieldsPlan::st_field *> fields;
+	pack_values(group.GetFields().GetPlan(), group_fields, fields);
+	pack_values(channel.GetFields().GetPlan(), channel_fields, fields);
+	
+	// Insert log line
+	storage_db->BulkDataLong(Field::en_type::NONE, log_id);
+	storage_db->BulkDataInt(Field::en_type::NONE, channel.GetID());
+	storage_db->BulkDataString(Field::en_type::NONE, date);
+	storage_db->BulkDataInt(Field::en_type::NONE, crit);
+	
+	for(int i=0;i<fields.size();i++)
+		log_value(log_id, *fields[i], date, packed[i]);
+}
+
+void MySQLLogBackend::Writer::pack_values(const FieldsPlan &plan, const map<string, string> &values, vector<const FieldsPlan::st_field *> &fields)
+{
+	const vector<FieldsPlan::st_field> &plan_fields = plan.GetFields();
+	for(int i=0;i<plan_fields.size();i++)
+	{
+		auto it = values.find(plan_fields[i].name);
+		if(it==values.end())
+			continue;
+		
+		packed.resize(fields.size()+1);
+		plan_fields[i].pack(it->second, context, packed.back());
+		fields.push_back(&plan_fields[i]);
+	}
+}
+
+void MySQLLogBackend::Writer::CommitBatch(Rollups::t_counters &rollup_counters)
+{
+	try
+	{
+		storage_db->StartTransaction();
+		
+		if(bulk_load)
+		{
+			storage_db->BulkLoad(Field::en_type::NONE);
+			storage_db->BulkLoad(Field::en_type::CHAR);
+			storage_db->BulkLoad(Field::en_type::INT);
+			storage_db->BulkLoad(Field::en_type::IP);
+			storage_db->BulkLoad(Field::en_type::PACK);
+			storage_db->BulkLoad(Field::en_type::TEXT);
+			storage_db->BulkLoad(Field::en_type::ITEXT);
+		}
+		else
+		{
+			storage_db->BulkExec(Field::en_type::NONE);
+			storage_db->BulkExec(Field::en_type::CHAR);
+			storage_db->BulkExec(Field::en_type::INT);
+			storage_db->BulkExec(Field::en_type::IP);
+			storage_db->BulkExec(Field::en_type::PACK);
+			storage_db->BulkExec(Field::en_type::TEXT);
+			storage_db->BulkExec(Field::en_type::ITEXT);
+		}
+		
+		// Counters are committed with the logs they count
+		Rollups::Commit(storage_db, rollup_counters);
+		
+		storage_db->CommitTransaction();
+	}
+	catch(Exception &e)
+	{
+		// Logs are rolled back, so are the counters of the batch
+		rollup_counters.clear();
+		
+		// Failed queries have already rolled back, this covers client side errors
+		try
+		{
+			storage_db->RollbackTransaction();
+		}
+		catch(...) {}
+		
+		throw e;
+	}
+}
+
+void MySQLLogBackend::Writer::log_value(unsigned long long log_id, const FieldsPlan::st_field &field, const string &date, const FieldsPlan::st_packed &value)
+{
+	int bulk_id = field.bulk_id;
+	
+	storage_db->BulkDataLong(bulk_id, log_id);
+	storage_db->BulkDataInt(bulk_id, field.id);
+	storage_db->BulkDataString(bulk_id, date);
+	
+	if(field.is_int)
+		storage_db->BulkDataInt(bulk_id, value.val_int);
+	else
+		storage_db->BulkDataString(bulk_id, value.val_str);
+	
+	if(field.type==Field::en_type::ITEXT)
+		storage_db->BulkDataString(bulk_id, value.sha1);
+}
+
+vector<map<string, string>> MySQLLogBackend::Query(const LogQuery &query, unsigned int limit, unsigned int offset)
+{
+	// Build base select
+	string query_select;
+	string query_from;
+	string query_where;
+	string query_groupby;
+	string query_order;
+	string query_limit;
+	vector<const void *> values;
+	
+	const string &groupby = query.groupby;
+	
+	ELog::BuildSelectFrom(query_select, query_from, groupby);
+	
+	query_where = " WHERE true ";
+	
+	if(query.crit>=0)
+	{
+		query_where += " AND l.log_crit = %i ";
+		values.push_back(&query.crit);
+	}
+	
+	if(query.emitted_from!="")
+	{
+		query_where += " AND l.log_date>=%s ";
+		values.push_back(&query.emitted_from);
+	}
+	
+	if(query.emitted_until!="")
+	{
+		query_where += " AND l.log_date<=%s ";
+		values.push_back(&query.emitted_until);
+	}
+	
+	if(query.group_id!=0)
+	{
+		query_where += " AND c.channel_group_id=%i ";
+		values.push_back(&query.group_id);
+		
+		ELog::BuildSelectFromAppend(query_select, query_from, query.group.GetFields(), "group_", groupby);
+	}
+	
+	if(query.channel_id!=0)
+	{
+		query_where += " AND l.channel_id=%i ";
+		values.push_back(&query.channel_id);
+		
+		ELog::BuildSelectFromAppend(query_select, query_from, query.channel.GetFields(), "channel_", groupby);
+	}
+	
+	auto group_fields = query.group.GetFields().GetIDMap();
+	vector<FieldsPlan::st_packed> group_filters_values;
+	add_auto_filters(query.group_filters, query.group.GetFields(), query_where, values, group_filters_values);
+	
+	auto channel_fields = query.channel.GetFields().GetIDMap();
+	vector<FieldsPlan::st_packed> channel_filters_values;
+	add_auto_filters(query.channel_filters, query.channel.GetFields(), query_where, values, channel_filters_values);
+	
+	if(groupby=="")
+		query_order = " ORDER BY l.log_date DESC, l.log_id DESC "; // IDs are reserved by blocks, they only follow dates on a single node
+	else
+		query_groupby = " GROUP BY "+groupby;
+	
+	query_limit = " LIMIT %i OFFSET %i ";
+	values.push_back(&limit);
+	values.push_back(&offset);
+	
+	// Field (and result name) of each selected column, to unpack values
+	vector<const Field *> columns;
+	vector<string> names;
+	if(groupby=="")
+	{
+		columns.assign(4, 0);
+		names.assign(4, "");
+		if(query.group_id!=0)
+		{
+			for(auto it = group_fields.begin(); it!=group_fields.end(); ++it)
+			{
+				columns.push_back(&it->second);
+				names.push_back("group_"+it->second.GetName());
+			}
+		}
+		
+		if(query.channel_id!=0)
+		{
+			for(auto it = channel_fields.begin(); it!=channel_fields.end(); ++it)
+			{
+				columns.push_back(&it->second);
+				names.push_back("channel_"+it->second.GetName());
+			}
+		}
+	}
+	else
+	{
+		columns.push_back(0);
+		if(groupby=="crit")
+			columns.push_back(0);
+		else if(groupby.substr(0,6)=="group_")
+			columns.push_back(&query.group.GetFields().Get(groupby.substr(6)));
+		else if(groupby.substr(0,8)=="channel_")
+			columns.push_back(&query.channel.GetFields().Get(groupby.substr(8)));
+	}
+	
+	DB db("elog");
+	db.QueryPrintf(query_select+query_from+query_where+query_groupby+query_order+query_limit, values);
+	
+	// Fetch the whole page first, so packed strings are resolved with one query
+	vector<vector<string>> rows;
+	set<unsigned int> pack_ids;
+	while(db.FetchRow())
+	{
+		vector<string> row;
+		for(int i=0;i<columns.size();i++)
+		{
+			row.push_back(db.GetField(i));
+			if(columns[i] && columns[i]->GetType()==Field::en_type::PACK && row[i]!="")
+				pack_ids.insert(stoul(row[i]));
+		}
+		
+		rows.push_back(row);
+	}
+	
+	PackDictionary::GetInstance()->Prefetch(pack_ids);
+	
+	vector<map<string, string>> results;
+	
+	for(int i=0;i<rows.size();i++)
+	{
+		const vector<string> &row = rows[i];
+		
+		map<string, string> result;
+		if(groupby=="")
+		{
+			result["id"] = row[0];
+			result["channel"] = Channels::GetInstance()->Get(stoi(row[1])).GetName();
+			result["crit"] = Field::UnpackCrit(stoi(row[2]));
+			result["date"] = row[3];
+			
+			for(int j=4;j<columns.size();j++)
+				result[names[j]] = columns[j]->Unpack(row[j]);
+		}
+		else
+		{
+			result["n"] = row[0];
+			if(groupby=="crit")
+				result[groupby] = Field::UnpackCrit(stoi(row[1]));
+			else if(columns.size()>1)
+				result[groupby] = columns[1]->Unpack(row[1]);
+		}
+		
+		results.push_back(result);
+	}
+	
+	return results;
+}
+
+void MySQLLogBackend::add_auto_filters(const map<string, string> &filters, const Fields &fields, string &query_where, vector<const void *> &values, vector<FieldsPlan::st_packed> &packed)
+{
+	const vector<FieldsPlan::st_field> &plan_fields = fields.GetPlan().GetFields();
+	
+	// Values are referenced by pointers, so they must not be reallocated
+	packed.resize(plan_fields.size());
+	
+	FieldsPlan::st_context context;
+	for(int i=0;i<plan_fields.size();i++)
+	{
+		const FieldsPlan::st_field &field = plan_fields[i];
+		
+		auto it_filter = filters.find(field.name);
+		if(it_filter==filters.end() || it_filter->second=="")
+			continue;
+		
+		string filter = it_filter->second;
+		if(field.type==Field::en_type::CHAR && filter.back()=='*')
+		{
+			field.pack(filter.substr(0, filter.size()-1), context, packed[i]);
+			query_where += field.filter_prefix;
+		}
+		else
+		{
+			field.pack(filter, context, packed[i]);
+			query_where += field.filter_equal;
+		}
+		
+		if(field.type==Field::en_type::ITEXT)
+			values.push_back(&packed[i].sha1);
+		else if(field.is_int)
+			values.push_back(&packed[i].val_int);
+		else
+			values.push_back(&packed[i].val_str);
+	}
+}
+
+bool MySQLLogBackend::Get(unsigned long long log_id, unsigned int *channel_id, map<string, string> &group_values, map<string, string> &channel_values)
+{
+	DB db("elog");
+	db.QueryPrintf("SELECT l.channel_id, c.channel_group_id FROM t_log l INNER JOIN t_channel c ON l.channel_id=c.channel_id WHERE l.log_id=%l", {&log_id});
+	if(!db.FetchRow())
+		return false;
+	
+	*channel_id = db.GetFieldInt(0);
+	
+	const Channel channel = Channels::GetInstance()->Get(*channel_id);
+	
+	query_fields(&db, log_id, channel.GetGroup().GetFields(), group_values);
+	query_fields(&db, log_id, channel.GetFields(), channel_values);
+	
+	return true;
+}
+
+void MySQLLogBackend::query_fields(DB *db, unsigned long long id, const Fields &fields, map<string, string> &values)
+{
+	string query_select;
+	string query_from;
+	string query_where;
+	
+	ELog::BuildSelectFrom(query_select, query_from);
+	ELog::BuildSelectFromAppend(query_select, query_from, fields);
+	
+	query_where = " WHERE l.log_id=%l ";
+	
+	db->QueryPrintf(query_select+query_from+query_where, {&id});
+	if(!db->FetchRow())
+		return;
+	
+	int i = 4;
+	auto fields_map = fields.GetIDMap();
+	for(auto it = fields_map.begin(); it!=fields_map.end(); ++it)
+		values[it->second.GetName()] = it->second.Unpack(db->GetField(i++));
+}
+
+vector<map<string, string>> MySQLLogBackend::GetStatistics()
+{
+	DB db("elog");
+	
+	string dbname = Configuration::GetInstance()->Get("elog.mysql.database");
+	db.QueryPrintf("SELECT PARTITION_NAME, CREATE_TIME, TABLE_ROWS, DATA_LENGTH, INDEX_LENGTH FROM information_schema.partitions WHERE TABLE_SCHEMA=%s AND TABLE_NAME = 't_log' AND PARTITION_NAME IS NOT NULL ORDER BY PARTITION_DESCRIPTION DESC", {&dbname});
+	
+	vector<map<string, string>> stats;
+	while(db.FetchRow())
+	{
+		map<string, string> stat;
+		stat["name"] = db.GetField(0);
+		stat["creation"] = db.GetField(1);
+		stat["rows"] = db.GetField(2);
+		stat["datasize"] = db.GetField(3);
+		stat["indexsize"] = db.GetField(4);
+		stats.push_back(stat);
+	}
+	
+	return stats;
+}
+
+int MySQLLogBackend::Purge(time_t now, int retention)
+{
+	DB db("elog");
+	DB db2(&db);
+	
+	int deleted_rows = 0;
+	
+	string dbname = Configuration::GetInstance()->Get("elog.mysql.database");
+	
+	// Partitions created ahead of time are not part of the retention
+	int today_days = DB::TO_DAYS(Utils::Date::FormatDate("%Y-%m-%d", now)) + 1;
+	db.QueryPrintf(
+		"SELECT PARTITION_NAME FROM information_schema.partitions WHERE TABLE_SCHEMA=%s AND TABLE_NAME = 't_log' AND PARTITION_NAME IS NOT NULL AND CAST(PARTITION_DESCRIPTION AS UNSIGNED)<=%i ORDER BY CAST(PARTITION_DESCRIPTION AS UNSIGNED) DESC LIMIT 30 OFFSET %i",
+		{&dbname, &today_days, &retention}
+	);
+	
+	const vector<string> &tables = Partitions::GetTables();
+	while(db.FetchRow())
+	{
+		for(int i=0;i<tables.size();i++)
+			db2.Query("ALTER TABLE "+tables[i]+" DROP PARTITION "+db.GetField(0));
+		deleted_rows++;
+	}
+	
+	return deleted_rows;
+}
+
+}
@@ -0,0 +1,183 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#include <ELogs/PackDictionary.h>
+#include <Exception/Exception.h>
+#include <Logger/Logger.h>
+#include <DB/DB.h>
+
+#include <vector>
+
+using namespace std;
+
+namespace ELogs
+{
+
+PackDictionary *PackDictionary::instance = 0;
+
+PackDictionary::PackDictionary()
+{
+	DB db("elog");
+	
+	db.Query("SELECT pack_id, pack_string FROM t_pack");
+	while(db.FetchRow())
+		add(db.GetFieldInt(0), db.GetField(1));
+	
+	instance = this;
+}
+
+PackDictionary::~PackDictionary()
+{
+	instance = 0;
+}
+
+void PackDictionary::add(unsigned int id, const string &str)
+{
+	{
+		st_str_shard &shard = str_shard(str);
+		unique_lock<mutex> llock(shard.lock);
+		shard.ids[str] = id;
+	}
+	
+	{
+		st_id_shard &shard = id_shard(id);
+		unique_lock<mutex> llock(shard.lock);
+		shard.strs[id] = str;
+	}
+}
+
+bool PackDictionary::Lookup(const string &str, unsigned int *id)
+{
+	st_str_shard &shard = str_shard(str);
+	unique_lock<mutex> llock(shard.lock);
+	
+	auto it = shard.ids.find(str);
+	if(it==shard.ids.end())
+		return false;
+	
+	*id = it->second;
+	return true;
+}
+
+bool PackDictionary::lookup_id(unsigned int id, string *str)
+{
+	st_id_shard &shard = id_shard(id);
+	unique_lock<mutex> llock(shard.lock);
+	
+	auto it = shard.strs.find(id);
+	if(it==shard.strs.end())
+		return false;
+	
+	*str = it->second;
+	return true;
+}
+
+unsigned int PackDictionary::Pack(const string &str)
+{
+	unsigned int id;
+	if(Lookup(str, &id))
+		return id;
+	
+	// Existing strings keep their ID, other nodes may have inserted it concurrently
+	DB db("elog");
+	db.QueryPrintf("INSERT INTO t_pack(pack_string) VALUES(%s) ON DUPLICATE KEY UPDATE pack_id=LAST_INSERT_ID(pack_id)", {&str});
+	
+	id = db.InsertID();
+	add(id, str);
+	
+	return id;
+}
+
+string PackDictionary::Unpack(unsigned int id)
+{
+	string str;
+	if(lookup_id(id, &str))
+		return str;
+	
+	// Try to load value from database if not in cache
+	DB db("elog");
+	
+	db.QueryPrintf("SELECT pack_string FROM t_pack WHERE pack_id=%i", {&id});
+	if(!db.FetchRow())
+		return "";
+	
+	add(id, db.GetField(0));
+	return db.GetField(0);
+}
+
+void PackDictionary::PackBatch(const set<string> &strs)
+{
+	vector<string> unknown;
+	for(auto it = strs.begin(); it!=strs.end(); ++it)
+	{
+		unsigned int id;
+		if(!Lookup(*it, &id))
+			unknown.push_back(*it);
+	}
+	
+	if(unknown.size()==0)
+		return;
+	
+	DB db("elog");
+	
+	// Strings already inserted by other nodes are left untouched
+	string in;
+	db.BulkStart(0, "t_pack", "pack_string", 1, "pack_id=pack_id");
+	for(int i=0;i<unknown.size();i++)
+	{
+		db.BulkDataString(0, unknown[i]);
+		in += string(i==0?"":",")+"'"+db.EscapeString(unknown[i])+"'";
+	}
+	
+	db.BulkExec(0);
+	
+	db.Query("SELECT pack_id, pack_string FROM t_pack WHERE pack_string IN("+in+")");
+	while(db.FetchRow())
+		add(db.GetFieldInt(0), db.GetField(1));
+	
+	// Strings not found back (altered by the column type) are packed one by one
+	for(int i=0;i<unknown.size();i++)
+	{
+		unsigned int id;
+		if(!Lookup(unknown[i], &id))
+			Pack(unknown[i]);
+	}
+}
+
+void PackDictionary::Prefetch(const set<unsigned int> &ids)
+{
+	string in;
+	for(auto it = ids.begin(); it!=ids.end(); ++it)
+	{
+		string str;
+		if(!lookup_id(*it, &str))
+			in += string(in==""?"":",")+to_string(*it);
+	}
+	
+	if(in=="")
+		return;
+	
+	DB db("elog");
+	db.Query("SELECT pack_id, pack_string FROM t_pack WHERE pack_id IN("+in+")");
+	while(db.FetchRow())
+		add(db.GetFieldInt(0), db.GetField(1));
+}
+
+}
@@ -0,0 +1,147 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#include <ELogs/Partitions.h>
+#include <DB/DB.h>
+#include <Logger/Logger.h>
+#include <Exception/Exception.h>
+#include <Configuration/Configuration.h>
+#include <Utils/Date.h>
+
+#include <map>
+
+using namespace std;
+
+namespace ELogs
+{
+
+Partitions::Partitions()
+{
+	days_ahead = Configuration::GetInstance()->GetInt("elog.partitions.ahead");
+	last_partition_days = 0;
+	
+	// Partitions must exist before log storage starts
+	DB db("elog");
+	maintain(&db);
+	
+	start();
+}
+
+Partitions::~Partitions()
+{
+	Shutdown();
+}
+
+const vector<string> &Partitions::GetTables()
+{
+	static const vector<string> tables = {"t_log", "t_value_char", "t_value_text", "t_value_itext", "t_value_ip", "t_value_int", "t_value_pack"};
+	return tables;
+}
+
+void Partitions::main()
+{
+	DB::StartThread();
+	
+	Logger::Log(LOG_NOTICE,"Partitions maintenance started");
+	
+	while(true)
+	{
+		if(!wait(3600))
+		{
+			Logger::Log(LOG_NOTICE,"Shutdown in progress exiting Partitions maintenance");
+			
+			DB::StopThread();
+			
+			return;
+		}
+		
+		try
+		{
+			DB db("elog");
+			maintain(&db);
+		}
+		catch(Exception &e)
+		{
+			Logger::Log(LOG_ERR,"Error maintaining ELogs partitions ("+e.context+") : "+e.error);
+		}
+	}
+}
+
+void Partitions::maintain(DB *db)
+{
+	const vector<string> &tables = GetTables();
+	string dbname = Configuration::GetInstance()->Get("elog.mysql.database");
+	
+	// Partitions are named after the day they hold, upper bound is the next day
+	map<int, string> expected;
+	time_t now = time(0);
+	for(int i=0;i<=days_ahead;i++)
+	{
+		string date = Utils::Date::FormatDate("%Y-%m-%d", now + i * 86400);
+		expected[DB::TO_DAYS(date) + 1] = "p"+date.substr(0, 4)+date.substr(5, 2)+date.substr(8, 2);
+	}
+	
+	int min_last_days = -1;
+	for(int i=0;i<tables.size();i++)
+	{
+		db->QueryPrintf(
+			"SELECT MAX(CAST(PARTITION_DESCRIPTION AS UNSIGNED)) FROM information_schema.partitions WHERE TABLE_SCHEMA=%s AND TABLE_NAME=%s AND PARTITION_NAME IS NOT NULL",
+			{&dbname, &tables[i]}
+		);
+		
+		int last_days = 0;
+		if(db->FetchRow() && !db->GetFieldIsNULL(0))
+			last_days = db->GetFieldInt(0);
+		
+		// Partitions can only be added after the last one, which also keeps all tables consistent
+		for(auto it = expected.begin(); it!=expected.end(); ++it)
+		{
+			if(it->first<=last_days)
+				continue;
+			
+			int days = it->first;
+			db->QueryPrintf("ALTER TABLE "+tables[i]+" ADD PARTITION (PARTITION "+it->second+" VALUES LESS THAN (%i))", {&days});
+			last_days = days;
+			
+			Logger::Log(LOG_INFO,"Created partition "+it->second+" on table "+tables[i]);
+		}
+		
+		if(min_last_days==-1 || last_days<min_last_days)
+			min_last_days = last_days;
+	}
+	
+	// Check all tables share the same partitions
+	string tables_list;
+	for(int i=0;i<tables.size();i++)
+		tables_list += (i==0?"'":",'")+tables[i]+"'";
+	
+	int ntables = tables.size();
+	db->QueryPrintf(
+		"SELECT PARTITION_NAME, COUNT(*) FROM information_schema.partitions WHERE TABLE_SCHEMA=%s AND TABLE_NAME IN ("+tables_list+") AND PARTITION_NAME IS NOT NULL GROUP BY PARTITION_NAME HAVING COUNT(*)<>%i",
+		{&dbname, &ntables}
+	);
+	
+	while(db->FetchRow())
+		Logger::Log(LOG_WARNING,"Partition "+db->GetField(0)+" is only present on "+db->GetField(1)+" logs tables out of "+to_string(tables.size()));
+	
+	last_partition_days = min_last_days;
+}
+
+}
@@ -0,0 +1,251 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#include <ELogs/QueryCache.h>
+#include <ELogs/LogBackend.h>
+#include <ELogs/LogStorage.h>
+#include <Exception/Exception.h>
+#include <Configuration/Configuration.h>
+#include <API/QueryHandlers.h>
+#include <Utils/Date.h>
+
+using namespace std;
+
+namespace ELogs
+{
+
+QueryCache *QueryCache::instance = 0;
+
+static auto init = QueryHandlers::GetInstance()->RegisterInit([](QueryHandlers *qh) {
+	if(!Configuration::GetInstance()->GetBool("elog.enable"))
+		return (APIAutoInit *)0;
+	
+	if(Configuration::GetInstance()->GetInt("elog.cache.ttl")==0)
+		return (APIAutoInit *)0;
+	
+	return (APIAutoInit *)new QueryCache();
+});
+
+QueryCache::QueryCache()
+{
+	Configuration *config = Configuration::GetInstance();
+	ttl = config->GetInt("elog.cache.ttl");
+	max_entries = config->GetInt("elog.cache.size");
+	
+	instance = this;
+}
+
+vector<map<string, string>> QueryCache::Get(const LogQuery &query, unsigned int limit, unsigned int offset, const function<vector<map<string, string>>()> &execute)
+{
+	string key = get_key(query, limit, offset);
+	
+	// Watermark is read before executing, so logs stored meanwhile invalidate the results
+	// Only logs stored by this node move it, other nodes logs are picked up when the TTL expires
+	LogStorage *storage = LogStorage::GetInstance();
+	unsigned long long watermark = storage?storage->GetWatermark():0;
+	
+	unique_lock<mutex> llock(lock);
+	
+	time_t now = time(0);
+	
+	auto it = entries.find(key);
+	if(it!=entries.end())
+	{
+		shared_ptr<st_entry> entry = it->second;
+		
+		if(!entry->ready)
+		{
+			// Same query is already running, wait for its results instead of running it again
+			cond.wait(llock, [&entry] { return entry->ready; });
+			
+			if(entry->failed)
+				throw Exception(entry->error_context, entry->error, entry->error_code, entry->error_codeno);
+			
+			hits++;
+			return entry->results;
+		}
+		
+		if(is_fresh(*entry, now, watermark))
+		{
+			hits++;
+			return entry->results;
+		}
+	}
+	
+	misses++;
+	
+	shared_ptr<st_entry> entry = make_shared<st_entry>();
+	entry->is_open = is_open(query);
+	entry->watermark = watermark;
+	entries[key] = entry;
+	
+	llock.unlock();
+	
+	vector<map<string, string>> results;
+	
+	try
+	{
+		results = execute();
+	}
+	catch(Exception &e)
+	{
+		llock.lock();
+		
+		// Waiting queries get the same error, next ones will try again
+		entry->error_context = e.context;
+		entry->error = e.error;
+		entry->error_code = e.code;
+		entry->error_codeno = e.codeno;
+		failed(key, entry);
+		
+		throw e;
+	}
+	catch(...)
+	{
+		// Waiters must never be left blocked on an entry that will not be ready
+		llock.lock();
+		
+		entry->error_context = "QueryCache";
+		entry->error = "Unexpected error while executing logs query";
+		entry->error_code = "";
+		entry->error_codeno = 0;
+		failed(key, entry);
+		
+		throw;
+	}
+	
+	llock.lock();
+	
+	entry->results = results;
+	entry->computed = time(0);
+	entry->ready = true;
+	
+	cond.notify_all();
+	
+	if(entries.size()>max_entries)
+		evict(entry->computed, watermark);
+	
+	return results;
+}
+
+void QueryCache::failed(const string &key, const shared_ptr<st_entry> &entry)
+{
+	entry->failed = true;
+	entry->ready = true;
+	
+	auto it = entries.find(key);
+	if(it!=entries.end() && it->second==entry)
+		entries.erase(it);
+	
+	cond.notify_all();
+}
+
+map<string, string> QueryCache::GetStatistics()
+{
+	unique_lock<mutex> llock(lock);
+	
+	map<string, string> stats;
+	stats["hits"] = to_string(hits);
+	stats["misses"] = to_string(misses);
+	stats["entries"] = to_string(entries.size());
+	stats["ttl"] = to_string(ttl);
+	
+	return stats;
+}
+
+bool QueryCache::is_fresh(const st_entry &entry, time_t now, unsigned long long watermark) const
+{
+	if(now-entry.computed>=ttl)
+		return false;
+	
+	if(entry.is_open && entry.watermark!=watermark)
+		return false;
+	
+	return true;
+}
+
+void QueryCache::evict(time_t now, unsigned long long watermark)
+{
+	for(auto it = entries.begin(); it!=entries.end();)
+	{
+		if(it->second->ready && !is_fresh(*it->second, now, watermark))
+			it = entries.erase(it);
+		else
+			++it;
+	}
+	
+	// Still full of fresh results, start over rather than tracking usage
+	if(entries.size()>max_entries)
+	{
+		for(auto it = entries.begin(); it!=entries.end();)
+		{
+			if(it->second->ready)
+				it = entries.erase(it);
+			else
+				++it;
+		}
+	}
+}
+
+string QueryCache::get_key(const LogQuery &query, unsigned int limit, unsigned int offset)
+{
+	string key;
+	
+	add_key(key, to_string(query.crit));
+	add_key(key, query.emitted_from);
+	add_key(key, query.emitted_until);
+	
+	add_key(key, to_string(query.group_id));
+	add_key(key, to_string(query.group_filters.size()));
+	for(auto it = query.group_filters.begin(); it!=query.group_filters.end(); ++it)
+	{
+		add_key(key, it->first);
+		add_key(key, it->second);
+	}
+	
+	add_key(key, to_string(query.channel_id));
+	add_key(key, to_string(query.channel_filters.size()));
+	for(auto it = query.channel_filters.begin(); it!=query.channel_filters.end(); ++it)
+	{
+		add_key(key, it->first);
+		add_key(key, it->second);
+	}
+	
+	add_key(key, query.groupby);
+	add_key(key, to_string(limit));
+	add_key(key, to_string(offset));
+	
+	return key;
+}
+
+void QueryCache::add_key(string &key, const string &value)
+{
+	// Length prefixed, so values cannot be confused whatever they contain
+	key += to_string(value.length())+":"+value;
+}
+
+bool QueryCache::is_open(const LogQuery &query)
+{
+	if(query.emitted_until=="")
+		return true;
+	
+	return query.emitted_until>=Utils::Date::FormatDate("%Y-%m-%d %H:%M:%S");
+}
+
+}
@@ -0,0 +1,350 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#include <ELogs/Rollups.h>
+#include <ELogs/LogBackend.h>
+#include <ELogs/Channel.h>
+#include <ELogs/ChannelGroup.h>
+#include <ELogs/Field.h>
+#include <ELogs/Fields.h>
+#include <ELogs/PackDictionary.h>
+#include <Exception/Exception.h>
+#include <Logger/Logger.h>
+#include <DB/DB.h>
+#include <Configuration/Configuration.h>
+#include <Utils/Date.h>
+
+#include <sstream>
+#include <set>
+
+using namespace std;
+
+namespace ELogs
+{
+
+Rollups::Rollups()
+{
+	node_name = Configuration::GetInstance()->Get("cluster.node.name");
+	
+	istringstream split(Configuration::GetInstance()->Get("elog.rollups.fields"));
+	for(string name; getline(split, name, ',');)
+	{
+		name.erase(0, name.find_first_not_of(" \t"));
+		name.erase(name.find_last_not_of(" \t")+1);
+		if(name!="")
+			fields.insert(name);
+	}
+	
+	DB db("elog");
+	
+	set<unsigned int> field_ids;
+	db.Query("SELECT field_id, field_name, field_type FROM t_field WHERE channel_group_id IS NOT NULL");
+	while(db.FetchRow())
+	{
+		string type = db.GetField(2);
+		if(fields.find(db.GetField(1))!=fields.end() && (type=="INT" || type=="PACK"))
+			field_ids.insert(db.GetFieldInt(0));
+	}
+	
+	// Rollups are enabled again on this node, counting starts over
+	string disabled_start = ROLLUPS_DISABLED_START;
+	db.QueryPrintf("DELETE FROM t_log_rollup_start WHERE node_name=%s AND rollup_start=%s", {&node_name, &disabled_start});
+	
+	db.QueryPrintf("SELECT field_id, rollup_start FROM t_log_rollup_start WHERE node_name=%s", {&node_name});
+	while(db.FetchRow())
+		starts[db.GetFieldInt(0)] = db.GetField(1);
+	
+	// Counters of fields no longer rolled up would have a gap if they were configured again
+	for(auto it = starts.begin(); it!=starts.end();)
+	{
+		unsigned int field_id = it->first;
+		if(field_id!=0 && field_ids.find(field_id)==field_ids.end())
+		{
+			db.QueryPrintf("DELETE FROM t_log_rollup_start WHERE node_name=%s AND field_id=%i", {&node_name, &field_id});
+			it = starts.erase(it);
+		}
+		else
+			++it;
+	}
+	
+	start(0);
+	for(auto it = field_ids.begin(); it!=field_ids.end(); ++it)
+		start(*it);
+}
+
+Rollups::~Rollups()
+{
+}
+
+void Rollups::Reset()
+{
+	// Rollups are disabled on this node, logs it stores from now on will not be counted
+	string node_name = Configuration::GetInstance()->Get("cluster.node.name");
+	string disabled_start = ROLLUPS_DISABLED_START;
+	
+	DB db("elog");
+	db.StartTransaction();
+	db.QueryPrintf("DELETE FROM t_log_rollup_start WHERE node_name=%s", {&node_name});
+	db.QueryPrintf("INSERT INTO t_log_rollup_start(node_name, field_id, rollup_start) VALUES(%s, 0, %s)", {&node_name, &disabled_start});
+	db.CommitTransaction();
+}
+
+void Rollups::start(unsigned int field_id)
+{
+	{
+		unique_lock<mutex> llock(starts_lock);
+		
+		if(starts.find(field_id)!=starts.end())
+			return;
+	}
+	
+	// Current minute is incomplete
+	string start_date = Utils::Date::FormatDate("%Y-%m-%d %H:%M:00", time(0)+60);
+	DB db("elog");
+	db.QueryPrintf("INSERT IGNORE INTO t_log_rollup_start(node_name, field_id, rollup_start) VALUES(%s, %i, %s)", {&node_name, &field_id, &start_date});
+	
+	unique_lock<mutex> llock(starts_lock);
+	starts[field_id] = start_date;
+}
+
+void Rollups::Restart()
+{
+	// Current minute may already hold lost counts
+	string start_date = Utils::Date::FormatDate("%Y-%m-%d %H:%M:00", time(0)+60);
+	
+	DB db("elog");
+	db.QueryPrintf("UPDATE t_log_rollup_start SET rollup_start=GREATEST(rollup_start, %s) WHERE node_name=%s", {&start_date, &node_name});
+	
+	unique_lock<mutex> llock(starts_lock);
+	for(auto it = starts.begin(); it!=starts.end(); ++it)
+	{
+		if(it->second<start_date)
+			it->second = start_date;
+	}
+}
+
+bool Rollups::is_rolled_up(const Field &field)
+{
+	return field.GetType()==Field::en_type::INT || field.GetType()==Field::en_type::PACK;
+}
+
+void Rollups::Add(t_counters &counters, const Channel &channel, const string &date, int crit, const map<string, string> &group_fields)
+{
+	if(date.size()<16)
+		return;
+	
+	string minute = date.substr(0, 16)+":00";
+	
+	counters[t_key(minute, channel.GetID(), crit, 0, 0)]++;
+	
+	if(fields.size()==0)
+		return;
+	
+	const ChannelGroup group = channel.GetGroup();
+	for(auto it = fields.begin(); it!=fields.end(); ++it)
+	{
+		auto it_value = group_fields.find(*it);
+		if(it_value==group_fields.end())
+			continue;
+		
+		const Field &field = group.GetFields().Get(*it);
+		if(!is_rolled_up(field))
+			continue;
+		
+		start(field.GetID());
+		
+		int pack_i;
+		string pack_str;
+		field.Pack(it_value->second, &pack_i, &pack_str);
+		
+		counters[t_key(minute, channel.GetID(), crit, field.GetID(), pack_i)]++;
+	}
+}
+
+void Rollups::Commit(DB *db, t_counters &counters)
+{
+	if(counters.size()==0)
+		return;
+	
+	// Counters are sorted, so concurrent workers lock rows in the same order
+	db->BulkStart(0, "t_log_rollup", "rollup_minute, channel_id, log_crit, field_id, value, rollup_count", 6, "rollup_count=rollup_count+VALUES(rollup_count)");
+	
+	for(auto it = counters.begin(); it!=counters.end(); ++it)
+	{
+		db->BulkDataString(0, get<0>(it->first));
+		db->BulkDataInt(0, get<1>(it->first));
+		db->BulkDataInt(0, get<2>(it->first));
+		db->BulkDataInt(0, get<3>(it->first));
+		db->BulkDataInt(0, get<4>(it->first));
+		db->BulkDataLong(0, it->second);
+	}
+	
+	db->BulkExec(0);
+	
+	counters.clear();
+}
+
+bool Rollups::Query(const LogQuery &query, unsigned int limit, unsigned int offset, vector<map<string, string>> &results)
+{
+	// Counters have no field values, nor sub minute dates
+	if(query.group_filters.size()!=0 || query.channel_filters.size()!=0)
+		return false;
+	
+	string from = normalize_date(query.emitted_from);
+	string until = normalize_date(query.emitted_until);
+	
+	if(from.size()!=19 || from.substr(16)!=":00")
+		return false;
+	
+	if(until!="" && (until.size()!=19 || until.substr(16)!=":59"))
+		return false;
+	
+	const Field *field = 0;
+	if(query.groupby.substr(0,6)=="group_" && query.group_id!=0 && fields.find(query.groupby.substr(6))!=fields.end())
+	{
+		field = &query.group.GetFields().Get(query.groupby.substr(6));
+		if(!is_rolled_up(*field))
+			return false;
+	}
+	else if(query.groupby!="crit")
+		return false;
+	
+	{
+		unique_lock<mutex> llock(starts_lock);
+		
+		auto it = starts.find(0);
+		if(it==starts.end() || from<it->second)
+			return false;
+		
+		if(field)
+		{
+			it = starts.find(field->GetID());
+			if(it==starts.end() || from<it->second)
+				return false;
+		}
+	}
+	
+	// Counters are only complete from the date all nodes count their logs
+	DB db("elog");
+	
+	if(from<get_cluster_start(&db, field?field->GetID():0))
+		return false;
+	
+	string query_from = " FROM t_log_rollup r ";
+	string query_where = " WHERE r.rollup_minute>=%s ";
+	vector<const void *> values = {&from};
+	
+	if(until!="")
+	{
+		query_where += " AND r.rollup_minute<=%s ";
+		values.push_back(&until);
+	}
+	
+	if(query.crit>=0)
+	{
+		query_where += " AND r.log_crit=%i ";
+		values.push_back(&query.crit);
+	}
+	
+	if(query.group_id!=0)
+	{
+		query_from += " INNER JOIN t_channel c ON c.channel_id=r.channel_id ";
+		query_where += " AND c.channel_group_id=%i ";
+		values.push_back(&query.group_id);
+	}
+	
+	if(query.channel_id!=0)
+	{
+		query_where += " AND r.channel_id=%i ";
+		values.push_back(&query.channel_id);
+	}
+	
+	vector<pair<string, string>> counts;
+	
+	if(!field)
+	{
+		db.QueryPrintf("SELECT SUM(r.rollup_count), r.log_crit"+query_from+query_where+" AND r.field_id=0 GROUP BY r.log_crit ORDER BY r.log_crit", values);
+		while(db.FetchRow())
+			counts.push_back({db.GetField(0), Field::UnpackCrit(db.GetFieldInt(1))});
+	}
+	else
+	{
+		// Logs without the field are not counted for it, they form the NULL group
+		db.QueryPrintf("SELECT SUM(r.rollup_count)"+query_from+query_where+" AND r.field_id=0", values);
+		unsigned long long total = 0;
+		if(db.FetchRow() && !db.GetFieldIsNULL(0))
+			total = stoull(db.GetField(0));
+		
+		unsigned int field_id = field->GetID();
+		values.push_back(&field_id);
+		db.QueryPrintf("SELECT SUM(r.rollup_count), r.value"+query_from+query_where+" AND r.field_id=%i GROUP BY r.value ORDER BY r.value", values);
+		
+		vector<pair<string, string>> rows;
+		set<unsigned int> pack_ids;
+		while(db.FetchRow())
+		{
+			rows.push_back({db.GetField(0), db.GetField(1)});
+			if(field->GetType()==Field::en_type::PACK)
+				pack_ids.insert(stoul(db.GetField(1)));
+		}
+		
+		PackDictionary::GetInstance()->Prefetch(pack_ids);
+		
+		unsigned long long with_value = 0;
+		for(int i=0;i<rows.size();i++)
+		{
+			with_value += stoull(rows[i].first);
+			counts.push_back({rows[i].first, field->Unpack(rows[i].second)});
+		}
+		
+		if(total>with_value)
+			counts.insert(counts.begin(), {to_string(total-with_value), field->Unpack("")});
+	}
+	
+	for(size_t i=offset;i<counts.size() && i<(size_t)offset+limit;i++)
+	{
+		map<string, string> result;
+		result["n"] = counts[i].first;
+		result[query.groupby] = counts[i].second;
+		results.push_back(result);
+	}
+	
+	return true;
+}
+
+string Rollups::get_cluster_start(DB *db, unsigned int field_id)
+{
+	// A node with rollups disabled has a start in the far future for all fields
+	db->QueryPrintf("SELECT MAX(rollup_start) FROM t_log_rollup_start WHERE field_id=0 OR field_id=%i", {&field_id});
+	if(!db->FetchRow() || db->GetFieldIsNULL(0))
+		return ROLLUPS_DISABLED_START;
+	
+	return db->GetField(0);
+}
+
+string Rollups::normalize_date(const string &date)
+{
+	if(date.size()==10)
+		return date+" 00:00:00";
+	
+	return date;
+}
+
+}
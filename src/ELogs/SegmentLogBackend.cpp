@@ -0,0 +1,1084 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#include <ELogs/SegmentLogBackend.h>
+#include <ELogs/LogStorage.h>
+#include <ELogs/Channels.h>
+#include <ELogs/Fields.h>
+#include <ELogs/PackDictionary.h>
+#include <Exception/Exception.h>
+#include <Logger/Logger.h>
+#include <Configuration/Configuration.h>
+#include <Utils/Date.h>
+#include <DB/DB.h>
+
+#include <queue>
+#include <tuple>
+#include <algorithm>
+#include <climits>
+#include <set>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+using namespace std;
+
+namespace ELogs
+{
+
+SegmentLogBackend::SegmentLogBackend()
+{
+	Configuration *config = Configuration::GetInstance();
+	directory = config->Get("elog.segments.directory");
+	segment_rows = config->GetInt("elog.segments.rows");
+	segment_flush = config->GetInt("elog.segments.flush");
+	
+	create_directory(directory);
+}
+
+SegmentLogBackend::~SegmentLogBackend()
+{
+	// Writers have flushed their segments, this only covers writers that were not released
+	flush(0, true);
+}
+
+LogBackend::Writer *SegmentLogBackend::CreateWriter()
+{
+	return new Writer(this);
+}
+
+SegmentLogBackend::Writer::Writer(SegmentLogBackend *backend)
+{
+	this->backend = backend;
+	rollups_db = new DB("elog");
+}
+
+SegmentLogBackend::Writer::~Writer()
+{
+	backend->flush(this, true);
+	
+	delete rollups_db;
+}
+
+void SegmentLogBackend::Writer::CommitBatch(Rollups::t_counters &rollup_counters)
+{
+	if(!backend->flush(this, false))
+	{
+		// Rollups have been restarted, counters of lost logs must not be stored
+		rollup_counters.clear();
+		throw Exception("SegmentLogBackend", "Unable to write logs segments");
+	}
+	
+	// Logs are not stored in the database, counters can only be committed on their own
+	try
+	{
+		Rollups::Commit(rollups_db, rollup_counters);
+	}
+	catch(Exception &e)
+	{
+		Logger::Log(LOG_ERR, "Error storing logs rollups in "+e.context+" : "+e.error);
+		
+		// Logs are stored but not counted
+		rollup_counters.clear();
+		restart_rollups();
+	}
+}
+
+void SegmentLogBackend::store(const Writer *writer, unsigned long long log_id, const Channel &channel, const string &date, int crit, const map<string, string> &group_fields, const map<string, string> &channel_fields)
+{
+	const ChannelGroup group = channel.GetGroup();
+	
+	map<unsigned int, long long> ints;
+	map<unsigned int, string> strs;
+	
+	ints[LOGSEGMENT_COL_LOG_ID] = log_id;
+	ints[LOGSEGMENT_COL_TIME] = parse_time(date);
+	ints[LOGSEGMENT_COL_CRIT] = crit;
+	
+	for(auto it = group_fields.begin(); it!=group_fields.end(); ++it)
+	{
+		if(it->first=="date" || it->first=="crit")
+			continue;
+		
+		add_value(group.GetFields().Get(it->first), it->second, ints, strs);
+	}
+	
+	for(auto it = channel_fields.begin(); it!=channel_fields.end(); ++it)
+		add_value(channel.GetFields().Get(it->first), it->second, ints, strs);
+	
+	unique_lock<mutex> llock(pending_lock);
+	
+	auto key = make_pair(date.substr(0, 10), channel.GetID());
+	auto it = pending.find(key);
+	if(it==pending.end())
+	{
+		it = pending.insert({key, st_pending()}).first;
+		it->second.writer = writer;
+		it->second.first_log_id = log_id;
+		it->second.created = time(0);
+	}
+	
+	it->second.builder.AddRow(ints, strs);
+}
+
+bool SegmentLogBackend::flush(const Writer *writer, bool all)
+{
+	bool flushed = true;
+	
+	time_t now = time(0);
+	
+	struct st_flush
+	{
+		string day_path;
+		string path;
+		st_segment segment;
+		unsigned long long last_log_id;
+		LogSegment::Builder builder;
+	};
+	
+	vector<st_flush> to_flush;
+	{
+		unique_lock<mutex> llock(pending_lock);
+		
+		for(auto it = pending.begin(); it!=pending.end();)
+		{
+			if((writer && it->second.writer!=writer) || !(all || it->second.builder.GetRows()>=segment_rows || now-it->second.created>=segment_flush))
+			{
+				++it;
+				continue;
+			}
+			
+			st_flush f;
+			f.day_path = directory+"/"+it->first.first;
+			f.path = f.day_path+"/"+to_string(it->first.second);
+			f.segment.day = it->first.first;
+			f.segment.channel_id = it->first.second;
+			f.segment.first_log_id = it->second.first_log_id;
+			f.segment.filename = f.path+"/"+to_string(it->second.first_log_id)+".seg";
+			
+			// Rows leave pending but stay visible to queries until the segment is renamed
+			vector<st_segment> &chunks = flushing[f.segment.filename];
+			add_memory_segments(f.segment.day, f.segment.channel_id, it->second.builder.Snapshot(), -1, chunks);
+			
+			f.last_log_id = f.segment.first_log_id;
+			for(size_t i=0;i<chunks.size();i++)
+				f.last_log_id = max(f.last_log_id, (unsigned long long)chunks[i].segment->GetColumn(LOGSEGMENT_COL_LOG_ID)->max_int);
+			
+			f.builder = move(it->second.builder);
+			to_flush.push_back(move(f));
+			
+			it = pending.erase(it);
+		}
+	}
+	
+	// Builders are now owned by this thread, they are written without lock
+	for(size_t i=0;i<to_flush.size();i++)
+	{
+		const st_flush &f = to_flush[i];
+		const string &filename = f.segment.filename;
+		string tmp_filename = f.path+"/."+to_string(f.segment.first_log_id)+".tmp";
+		
+		try
+		{
+			create_directory(f.day_path);
+			create_directory(f.path);
+			
+			f.builder.Write(tmp_filename);
+			
+			// Segment becomes visible on disk as it leaves memory, so queries never see it twice
+			unique_lock<mutex> llock(pending_lock);
+			
+			flushing.erase(filename);
+			
+			if(rename(tmp_filename.c_str(), filename.c_str())!=0)
+				throw Exception("SegmentLogBackend", "Unable to rename segment "+tmp_filename+" : "+strerror(errno));
+			
+			unique_lock<mutex> ilock(index_lock);
+			if(index_built)
+				index_segment(f.segment, f.last_log_id);
+		}
+		catch(Exception &e)
+		{
+			Logger::Log(LOG_ERR, "Unable to write logs segment "+filename+" : "+e.error+", "+to_string(f.builder.GetRows())+" logs are lost");
+			
+			unlink(tmp_filename.c_str());
+			
+			unique_lock<mutex> llock(pending_lock);
+			flushing.erase(filename);
+			
+			flushed = false;
+		}
+	}
+	
+	// Lost logs may already be counted
+	if(!flushed)
+		restart_rollups();
+	
+	return flushed;
+}
+
+void SegmentLogBackend::restart_rollups()
+{
+	Rollups *rollups = LogStorage::GetInstance()->GetRollups();
+	if(!rollups)
+		return;
+	
+	try
+	{
+		rollups->Restart();
+	}
+	catch(Exception &e)
+	{
+		Logger::Log(LOG_ERR, "Unable to restart logs rollups in "+e.context+" : "+e.error);
+	}
+}
+
+vector<map<string, string>> SegmentLogBackend::Query(const LogQuery &query, unsigned int limit, unsigned int offset)
+{
+	string from = normalize_date(query.emitted_from);
+	string until = normalize_date(query.emitted_until);
+	
+	vector<st_filter> filters = compile_filters(query);
+	vector<st_segment> segments = list_segments(from.substr(0, 10), until.substr(0, 10), query);
+	
+	if(query.groupby=="")
+		return query_logs(query, segments, filters, from, until, limit, offset);
+	
+	return query_groupby(query, segments, filters, from, until, limit, offset);
+}
+
+vector<map<string, string>> SegmentLogBackend::query_logs(const LogQuery &query, vector<st_segment> &segments, const vector<st_filter> &filters, const string &from, const string &until, unsigned int limit, unsigned int offset)
+{
+	vector<map<string, string>> results;
+	
+	unsigned long long need = (unsigned long long)offset + limit;
+	if(need==0)
+		return results;
+	
+	size_t nloaded = 0;
+	for(size_t i=0;i<segments.size();i++)
+	{
+		if(load_segment(segments[i]))
+			segments[nloaded++] = segments[i];
+	}
+	
+	segments.resize(nloaded);
+	
+	// Logs are sorted by date then ID, as IDs are reserved by blocks they do not follow dates across cluster nodes
+	auto max_key = [](const st_segment &segment) {
+		return make_pair(date_key(segment.day, segment.segment->GetColumn(LOGSEGMENT_COL_TIME)->max_int), segment.segment->GetColumn(LOGSEGMENT_COL_LOG_ID)->max_int);
+	};
+	
+	// Most recent segments first, so we can stop as soon as older ones cannot enter the result
+	sort(segments.begin(), segments.end(), [&max_key](const st_segment &a, const st_segment &b) {
+		return max_key(a) > max_key(b);
+	});
+	
+	typedef tuple<long long, long long, size_t, unsigned int> t_match; // date, log_id, segment, row
+	priority_queue<t_match, vector<t_match>, greater<t_match>> best;
+	vector<map<unsigned int, LogSegment::st_column>> columns(segments.size());
+	
+	for(size_t i=0;i<segments.size();i++)
+	{
+		const LogSegment &segment = *segments[i].segment;
+		
+		if(best.size()>=need && max_key(segments[i])<make_pair(get<0>(best.top()), get<1>(best.top())))
+			break;
+		
+		vector<st_filter> seg_filters = segment_filters(segments[i], filters, from, until);
+		if(!may_match(segment, seg_filters))
+			continue;
+		
+		vector<unsigned int> rows = match_rows(segment, seg_filters, columns[i]);
+		const LogSegment::st_column &log_ids = get_column(segment, LOGSEGMENT_COL_LOG_ID, columns[i]);
+		const LogSegment::st_column &times = get_column(segment, LOGSEGMENT_COL_TIME, columns[i]);
+		for(size_t j=0;j<rows.size();j++)
+		{
+			best.push(t_match(date_key(segments[i].day, times.ints[rows[j]]), log_ids.ints[rows[j]], i, rows[j]));
+			if(best.size()>need)
+				best.pop();
+		}
+	}
+	
+	vector<t_match> matches;
+	while(!best.empty())
+	{
+		matches.push_back(best.top());
+		best.pop();
+	}
+	
+	reverse(matches.begin(), matches.end());
+	
+	auto group_fields = query.group.GetFields().GetIDMap();
+	auto channel_fields = query.channel.GetFields().GetIDMap();
+	
+	// Resolve packed strings of the whole page with one query
+	set<unsigned int> pack_ids;
+	for(size_t i=offset;i<matches.size();i++)
+	{
+		size_t seg = get<2>(matches[i]);
+		unsigned int row = get<3>(matches[i]);
+		
+		if(query.group_id!=0)
+			get_pack_ids(*segments[seg].segment, row, group_fields, columns[seg], pack_ids);
+		if(query.channel_id!=0)
+			get_pack_ids(*segments[seg].segment, row, channel_fields, columns[seg], pack_ids);
+	}
+	
+	PackDictionary::GetInstance()->Prefetch(pack_ids);
+	
+	for(size_t i=offset;i<matches.size();i++)
+	{
+		size_t seg = get<2>(matches[i]);
+		unsigned int row = get<3>(matches[i]);
+		const LogSegment &segment = *segments[seg].segment;
+		
+		map<string, string> result;
+		result["id"] = to_string(get<1>(matches[i]));
+		result["channel"] = Channels::GetInstance()->Get(segments[seg].channel_id).GetName();
+		result["crit"] = Field::UnpackCrit(get_column(segment, LOGSEGMENT_COL_CRIT, columns[seg]).ints[row]);
+		result["date"] = segments[seg].day+" "+format_time(get_column(segment, LOGSEGMENT_COL_TIME, columns[seg]).ints[row]);
+		
+		if(query.group_id!=0)
+		{
+			for(auto it = group_fields.begin(); it!=group_fields.end(); ++it)
+				result["group_"+it->second.GetName()] = it->second.Unpack(get_column(segment, it->first, columns[seg]).GetString(row));
+		}
+		
+		if(query.channel_id!=0)
+		{
+			for(auto it = channel_fields.begin(); it!=channel_fields.end(); ++it)
+				result["channel_"+it->second.GetName()] = it->second.Unpack(get_column(segment, it->first, columns[seg]).GetString(row));
+		}
+		
+		results.push_back(result);
+	}
+	
+	return results;
+}
+
+vector<map<string, string>> SegmentLogBackend::query_groupby(const LogQuery &query, vector<st_segment> &segments, const vector<st_filter> &filters, const string &from, const string &until, unsigned int limit, unsigned int offset)
+{
+	const string &groupby = query.groupby;
+	
+	unsigned int key_column;
+	const Field *key_field = 0;
+	if(groupby=="crit")
+		key_column = LOGSEGMENT_COL_CRIT;
+	else if(groupby.substr(0,6)=="group_" && query.group_id!=0)
+		key_field = &query.group.GetFields().Get(groupby.substr(6));
+	else if(groupby.substr(0,8)=="channel_" && query.channel_id!=0)
+		key_field = &query.channel.GetFields().Get(groupby.substr(8));
+	else
+		throw Exception("ELogs", "Unknown groupby field "+groupby);
+	
+	if(key_field)
+		key_column = key_field->GetID();
+	
+	unsigned long long null_count = 0;
+	map<long long, unsigned long long> int_counts;
+	map<string, unsigned long long> str_counts;
+	
+	for(size_t i=0;i<segments.size();i++)
+	{
+		if(!load_segment(segments[i]))
+			continue;
+		
+		const LogSegment &segment = *segments[i].segment;
+		
+		vector<st_filter> seg_filters = segment_filters(segments[i], filters, from, until);
+		if(!may_match(segment, seg_filters))
+			continue;
+		
+		map<unsigned int, LogSegment::st_column> columns;
+		vector<unsigned int> rows = match_rows(segment, seg_filters, columns);
+		const LogSegment::st_column &keys = get_column(segment, key_column, columns);
+		for(int j=0;j<rows.size();j++)
+		{
+			if(keys.IsNull(rows[j]))
+				null_count++;
+			else if(keys.is_int)
+				int_counts[keys.ints[rows[j]]]++;
+			else
+				str_counts[keys.strs[rows[j]]]++;
+		}
+	}
+	
+	if(key_field && key_field->GetType()==Field::en_type::PACK)
+	{
+		set<unsigned int> pack_ids;
+		for(auto it = int_counts.begin(); it!=int_counts.end(); ++it)
+			pack_ids.insert(it->first);
+		PackDictionary::GetInstance()->Prefetch(pack_ids);
+	}
+	
+	// NULL first then values in ascending order, like MySQL GROUP BY
+	vector<pair<string, unsigned long long>> counts;
+	if(null_count>0)
+		counts.push_back({key_field?key_field->Unpack(""):"", null_count});
+	for(auto it = int_counts.begin(); it!=int_counts.end(); ++it)
+		counts.push_back({key_field?key_field->Unpack(to_string(it->first)):Field::UnpackCrit(it->first), it->second});
+	for(auto it = str_counts.begin(); it!=str_counts.end(); ++it)
+		counts.push_back({key_field->Unpack(it->first), it->second});
+	
+	vector<map<string, string>> results;
+	for(size_t i=offset;i<counts.size() && i<(size_t)offset+limit;i++)
+	{
+		map<string, string> result;
+		result["n"] = to_string(counts[i].second);
+		result[groupby] = counts[i].first;
+		results.push_back(result);
+	}
+	
+	return results;
+}
+
+bool SegmentLogBackend::Get(unsigned long long log_id, unsigned int *channel_id, map<string, string> &group_values, map<string, string> &channel_values)
+{
+	// Rows still in memory, then on disk segments whose log IDs range holds this ID
+	vector<st_segment> segments = list_segments("", "", LogQuery(), log_id, false);
+	vector<st_segment> indexed_segments = lookup_index(log_id);
+	segments.insert(segments.end(), indexed_segments.begin(), indexed_segments.end());
+	
+	// The segment holding this ID is most likely the one that started last before it
+	sort(segments.begin(), segments.end(), [](const st_segment &a, const st_segment &b) {
+		return a.first_log_id > b.first_log_id;
+	});
+	
+	for(size_t i=0;i<segments.size();i++)
+	{
+		if(!load_segment(segments[i]))
+			continue;
+		
+		const LogSegment &segment = *segments[i].segment;
+		
+		const LogSegment::st_column_desc *desc = segment.GetColumn(LOGSEGMENT_COL_LOG_ID);
+		if(!desc || desc->min_int>(long long)log_id || desc->max_int<(long long)log_id)
+			continue;
+		
+		map<unsigned int, LogSegment::st_column> columns;
+		const LogSegment::st_column &log_ids = get_column(segment, LOGSEGMENT_COL_LOG_ID, columns);
+		for(unsigned int row=0;row<segment.GetRows();row++)
+		{
+			if(log_ids.ints[row]!=(long long)log_id)
+				continue;
+			
+			*channel_id = segments[i].channel_id;
+			
+			const Channel channel = Channels::GetInstance()->Get(*channel_id);
+			
+			auto group_fields = channel.GetGroup().GetFields().GetIDMap();
+			for(auto it = group_fields.begin(); it!=group_fields.end(); ++it)
+				group_values[it->second.GetName()] = it->second.Unpack(get_column(segment, it->first, columns).GetString(row));
+			
+			auto channel_fields = channel.GetFields().GetIDMap();
+			for(auto it = channel_fields.begin(); it!=channel_fields.end(); ++it)
+				channel_values[it->second.GetName()] = it->second.Unpack(get_column(segment, it->first, columns).GetString(row));
+			
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+vector<map<string, string>> SegmentLogBackend::GetStatistics()
+{
+	vector<map<string, string>> stats;
+	
+	vector<string> days = list_directory(directory);
+	for(auto it_day = days.rbegin(); it_day!=days.rend(); ++it_day)
+	{
+		string day_path = directory+"/"+*it_day;
+		
+		struct stat st;
+		if(stat(day_path.c_str(), &st)!=0)
+			continue;
+		
+		unsigned long long rows = 0, datasize = 0, indexsize = 0;
+		vector<string> channels = list_directory(day_path);
+		for(int i=0;i<channels.size();i++)
+		{
+			vector<string> files = list_directory(day_path+"/"+channels[i]);
+			for(int j=0;j<files.size();j++)
+			{
+				string filename = day_path+"/"+channels[i]+"/"+files[j];
+				
+				struct stat st_file;
+				if(stat(filename.c_str(), &st_file)!=0)
+					continue;
+				
+				try
+				{
+					LogSegment segment(filename);
+					rows += segment.GetRows();
+					indexsize += 12 + segment.GetHeaderLength();
+					datasize += st_file.st_size - 12 - segment.GetHeaderLength();
+				}
+				catch(Exception &e)
+				{
+					continue; // Removed while computing statistics
+				}
+			}
+		}
+		
+		map<string, string> stat;
+		stat["name"] = *it_day;
+		stat["creation"] = Utils::Date::FormatDate("%Y-%m-%d %H:%M:%S", st.st_ctime);
+		stat["rows"] = to_string(rows);
+		stat["datasize"] = to_string(datasize);
+		stat["indexsize"] = to_string(indexsize);
+		stats.push_back(stat);
+	}
+	
+	return stats;
+}
+
+int SegmentLogBackend::Purge(time_t now, int retention)
+{
+	int deleted_days = 0;
+	
+	string today = Utils::Date::FormatDate("%Y-%m-%d", now);
+	
+	vector<string> days = list_directory(directory);
+	int kept = 0;
+	for(auto it_day = days.rbegin(); it_day!=days.rend() && deleted_days<30; ++it_day)
+	{
+		if(*it_day>today)
+			continue; // Logs from the future are not part of the retention
+		
+		if(kept++<retention)
+			continue;
+		
+		// Retention is only a matter of removing files
+		string day_path = directory+"/"+*it_day;
+		vector<string> channels = list_directory(day_path);
+		for(int i=0;i<channels.size();i++)
+		{
+			string channel_path = day_path+"/"+channels[i];
+			vector<string> files = list_directory(channel_path);
+			for(int j=0;j<files.size();j++)
+				unlink((channel_path+"/"+files[j]).c_str());
+			
+			rmdir(channel_path.c_str());
+		}
+		
+		if(rmdir(day_path.c_str())!=0)
+			Logger::Log(LOG_WARNING, "Unable to remove logs directory "+day_path+" : "+strerror(errno));
+		
+		{
+			unique_lock<mutex> ilock(index_lock);
+			
+			for(auto it = index.begin(); it!=index.end();)
+			{
+				if(it->second.segment.day==*it_day)
+					it = index.erase(it);
+				else
+					++it;
+			}
+		}
+		
+		deleted_days++;
+	}
+	
+	return deleted_days;
+}
+
+vector<SegmentLogBackend::st_segment> SegmentLogBackend::list_segments(const string &from_day, const string &until_day, const LogQuery &query, unsigned long long max_first_log_id, bool list_files)
+{
+	vector<st_segment> segments;
+	map<unsigned int, bool> channel_match;
+	
+	auto is_channel_matching = [&channel_match, &query](unsigned int channel_id) {
+		auto it = channel_match.find(channel_id);
+		if(it!=channel_match.end())
+			return it->second;
+		
+		bool match = true;
+		if(query.channel_id!=0)
+			match = channel_id==query.channel_id;
+		
+		if(match && query.group_id!=0)
+		{
+			try
+			{
+				match = Channels::GetInstance()->Get(channel_id).GetGroupID()==query.group_id;
+			}
+			catch(Exception &e)
+			{
+				match = false; // Channel has been removed
+			}
+		}
+		
+		channel_match[channel_id] = match;
+		return match;
+	};
+	
+	auto is_day_matching = [&from_day, &until_day](const string &day) {
+		return (from_day=="" || day>=from_day) && (until_day=="" || day<=until_day);
+	};
+	
+	// Files and pending rows are listed together, a flush cannot make rows appear twice or vanish
+	unique_lock<mutex> llock(pending_lock);
+	
+	vector<string> days;
+	if(list_files)
+		days = list_directory(directory);
+	
+	for(int i=0;i<days.size();i++)
+	{
+		if(!is_day_matching(days[i]))
+			continue;
+		
+		vector<string> channels = list_directory(directory+"/"+days[i]);
+		for(int j=0;j<channels.size();j++)
+		{
+			unsigned int channel_id = strtoul(channels[j].c_str(), 0, 10);
+			if(channel_id==0 || !is_channel_matching(channel_id))
+				continue;
+			
+			string path = directory+"/"+days[i]+"/"+channels[j];
+			vector<string> files = list_directory(path);
+			for(int k=0;k<files.size();k++)
+			{
+				if(files[k].size()<5 || files[k].substr(files[k].size()-4)!=".seg")
+					continue;
+				
+				st_segment segment;
+				segment.day = days[i];
+				segment.channel_id = channel_id;
+				segment.first_log_id = strtoull(files[k].c_str(), 0, 10);
+				segment.filename = path+"/"+files[k];
+				
+				if(segment.first_log_id<=max_first_log_id)
+					segments.push_back(segment);
+			}
+		}
+	}
+	
+	for(auto it = pending.begin(); it!=pending.end(); ++it)
+	{
+		if(!is_day_matching(it->first.first) || !is_channel_matching(it->first.second) || it->second.first_log_id>max_first_log_id)
+			continue;
+		
+		add_memory_segments(it->first.first, it->first.second, it->second.builder.Snapshot(), max_first_log_id, segments);
+	}
+	
+	for(auto it = flushing.begin(); it!=flushing.end(); ++it)
+	{
+		for(size_t i=0;i<it->second.size();i++)
+		{
+			const st_segment &segment = it->second[i];
+			if(is_day_matching(segment.day) && is_channel_matching(segment.channel_id) && segment.first_log_id<=max_first_log_id)
+				segments.push_back(segment);
+		}
+	}
+	
+	return segments;
+}
+
+void SegmentLogBackend::add_memory_segments(const string &day, unsigned int channel_id, const vector<shared_ptr<const LogSegment>> &chunks, unsigned long long max_first_log_id, vector<st_segment> &segments)
+{
+	for(size_t i=0;i<chunks.size();i++)
+	{
+		st_segment segment;
+		segment.day = day;
+		segment.channel_id = channel_id;
+		segment.first_log_id = chunks[i]->GetColumn(LOGSEGMENT_COL_LOG_ID)->min_int;
+		segment.segment = chunks[i];
+		
+		if(segment.first_log_id<=max_first_log_id)
+			segments.push_back(segment);
+	}
+}
+
+bool SegmentLogBackend::load_segment(st_segment &segment)
+{
+	if(segment.segment)
+		return true;
+	
+	try
+	{
+		segment.segment = make_shared<LogSegment>(segment.filename);
+	}
+	catch(Exception &e)
+	{
+		struct stat st;
+		if(stat(segment.filename.c_str(), &st)!=0 && errno==ENOENT)
+			return false; // Removed by retention since it was listed
+		
+		throw e;
+	}
+	
+	return true;
+}
+
+vector<SegmentLogBackend::st_segment> SegmentLogBackend::lookup_index(unsigned long long log_id)
+{
+	vector<st_segment> segments;
+	
+	unique_lock<mutex> llock(index_lock);
+	
+	if(!index_built)
+		build_index();
+	
+	// Segments of different channels overlap, but none of them spans more than index_max_span IDs
+	auto it = index.upper_bound(log_id);
+	while(it!=index.begin())
+	{
+		--it;
+		
+		if(log_id-it->first>index_max_span)
+			break;
+		
+		if(it->second.last_log_id>=log_id)
+			segments.push_back(it->second.segment);
+	}
+	
+	return segments;
+}
+
+void SegmentLogBackend::build_index()
+{
+	// Called with index_lock held, flushes wait for the index to be complete before adding their segment
+	vector<string> days = list_directory(directory);
+	for(size_t i=0;i<days.size();i++)
+	{
+		vector<string> channels = list_directory(directory+"/"+days[i]);
+		for(size_t j=0;j<channels.size();j++)
+		{
+			unsigned int channel_id = strtoul(channels[j].c_str(), 0, 10);
+			if(channel_id==0)
+				continue;
+			
+			string path = directory+"/"+days[i]+"/"+channels[j];
+			vector<string> files = list_directory(path);
+			for(size_t k=0;k<files.size();k++)
+			{
+				if(files[k].size()<5 || files[k].substr(files[k].size()-4)!=".seg")
+					continue;
+				
+				st_segment segment;
+				segment.day = days[i];
+				segment.channel_id = channel_id;
+				segment.first_log_id = strtoull(files[k].c_str(), 0, 10);
+				segment.filename = path+"/"+files[k];
+				
+				try
+				{
+					LogSegment log_segment(segment.filename);
+					
+					const LogSegment::st_column_desc *desc = log_segment.GetColumn(LOGSEGMENT_COL_LOG_ID);
+					if(desc)
+						index_segment(segment, desc->max_int);
+				}
+				catch(Exception &e)
+				{
+					Logger::Log(LOG_WARNING, "Unable to index logs segment "+segment.filename+" : "+e.error);
+				}
+			}
+		}
+	}
+	
+	index_built = true;
+}
+
+void SegmentLogBackend::index_segment(const st_segment &segment, unsigned long long last_log_id)
+{
+	index[segment.first_log_id] = {last_log_id, segment};
+	
+	if(last_log_id>segment.first_log_id)
+		index_max_span = max(index_max_span, last_log_id-segment.first_log_id);
+}
+
+vector<SegmentLogBackend::st_filter> SegmentLogBackend::compile_filters(const LogQuery &query)
+{
+	vector<st_filter> filters;
+	
+	if(query.crit>=0)
+	{
+		st_filter filter;
+		filter.column = LOGSEGMENT_COL_CRIT;
+		filter.type = Field::en_type::NONE;
+		filter.min_int = filter.max_int = query.crit;
+		filters.push_back(filter);
+	}
+	
+	compile_field_filters(query.group.GetFields(), query.group_filters, filters);
+	compile_field_filters(query.channel.GetFields(), query.channel_filters, filters);
+	
+	return filters;
+}
+
+void SegmentLogBackend::compile_field_filters(const Fields &fields, const map<string, string> &values, vector<st_filter> &filters)
+{
+	auto fields_map = fields.GetIDMap();
+	for(auto it = fields_map.begin(); it!=fields_map.end(); ++it)
+	{
+		auto it_value = values.find(it->second.GetName());
+		if(it_value==values.end() || it_value->second=="")
+			continue;
+		
+		const Field &field = it->second;
+		
+		st_filter filter;
+		filter.column = field.GetID();
+		filter.type = field.GetType();
+		
+		string value = it_value->second;
+		if(field.GetType()==Field::en_type::CHAR && value.back()=='*')
+		{
+			filter.is_prefix = true;
+			value = value.substr(0, value.size()-1);
+		}
+		
+		int pack_i;
+		string pack_str;
+		field.Pack(value, &pack_i, &pack_str);
+		
+		if(field.GetType()==Field::en_type::INT || field.GetType()==Field::en_type::PACK)
+			filter.min_int = filter.max_int = pack_i;
+		else if(field.GetType()==Field::en_type::ITEXT)
+			filter.value_str = pack_str.substr(0, 65535);
+		else
+			filter.value_str = pack_str;
+		
+		filters.push_back(filter);
+	}
+}
+
+vector<SegmentLogBackend::st_filter> SegmentLogBackend::segment_filters(const st_segment &segment, const vector<st_filter> &filters, const string &from, const string &until)
+{
+	vector<st_filter> seg_filters = filters;
+	
+	// Days are directories, time bounds only apply to the first and last days
+	bool is_first_day = from!="" && segment.day==from.substr(0, 10);
+	bool is_last_day = until!="" && segment.day==until.substr(0, 10);
+	if(is_first_day || is_last_day)
+	{
+		st_filter filter;
+		filter.column = LOGSEGMENT_COL_TIME;
+		filter.type = Field::en_type::NONE;
+		filter.min_int = is_first_day?parse_time(from):0;
+		filter.max_int = is_last_day?parse_time(until):86400;
+		seg_filters.push_back(filter);
+	}
+	
+	return seg_filters;
+}
+
+bool SegmentLogBackend::may_match(const LogSegment &segment, const vector<st_filter> &filters)
+{
+	for(int i=0;i<filters.size();i++)
+	{
+		const LogSegment::st_column_desc *desc = segment.GetColumn(filters[i].column);
+		if(!desc)
+			return false; // No value at all, NULL never matches
+		
+		if(desc->is_int)
+		{
+			if(desc->max_int<filters[i].min_int || desc->min_int>filters[i].max_int)
+				return false;
+		}
+		else if(desc->is_dict)
+		{
+			bool found = false;
+			for(int j=0;j<desc->dict.size() && !found;j++)
+				found = match_string(filters[i], desc->dict[j]);
+			
+			if(!found)
+				return false;
+		}
+	}
+	
+	return true;
+}
+
+vector<unsigned int> SegmentLogBackend::match_rows(const LogSegment &segment, const vector<st_filter> &filters, map<unsigned int, LogSegment::st_column> &columns)
+{
+	vector<unsigned int> rows;
+	
+	vector<const LogSegment::st_column *> filter_columns;
+	for(int i=0;i<filters.size();i++)
+		filter_columns.push_back(&get_column(segment, filters[i].column, columns));
+	
+	for(unsigned int row=0;row<segment.GetRows();row++)
+	{
+		bool match = true;
+		for(int i=0;i<filters.size() && match;i++)
+		{
+			const LogSegment::st_column &column = *filter_columns[i];
+			if(column.IsNull(row))
+				match = false;
+			else if(column.is_int)
+				match = column.ints[row]>=filters[i].min_int && column.ints[row]<=filters[i].max_int;
+			else
+				match = match_string(filters[i], column.strs[row]);
+		}
+		
+		if(match)
+			rows.push_back(row);
+	}
+	
+	return rows;
+}
+
+bool SegmentLogBackend::match_string(const st_filter &filter, const string &value)
+{
+	// Same semantics as the case insensitive collation of the MySQL backend
+	switch(filter.type)
+	{
+		case Field::en_type::CHAR:
+			if(filter.is_prefix)
+				return value.size()>=filter.value_str.size() && strncasecmp(value.c_str(), filter.value_str.c_str(), filter.value_str.size())==0;
+			return strcasecmp(value.c_str(), filter.value_str.c_str())==0;
+		
+		case Field::en_type::TEXT:
+			return strcasecmp(value.c_str(), filter.value_str.c_str())==0;
+		
+		default:
+			return value==filter.value_str;
+	}
+}
+
+const LogSegment::st_column &SegmentLogBackend::get_column(const LogSegment &segment, unsigned int id, map<unsigned int, LogSegment::st_column> &columns)
+{
+	auto it = columns.find(id);
+	if(it!=columns.end())
+		return it->second;
+	
+	LogSegment::st_column &column = columns[id];
+	segment.ReadColumn(id, column);
+	return column;
+}
+
+void SegmentLogBackend::get_pack_ids(const LogSegment &segment, unsigned int row, const map<unsigned int, Field> &fields, map<unsigned int, LogSegment::st_column> &columns, set<unsigned int> &pack_ids)
+{
+	for(auto it = fields.begin(); it!=fields.end(); ++it)
+	{
+		if(it->second.GetType()!=Field::en_type::PACK)
+			continue;
+		
+		const LogSegment::st_column &column = get_column(segment, it->first, columns);
+		if(column.is_int && !column.IsNull(row))
+			pack_ids.insert(column.ints[row]);
+	}
+}
+
+void SegmentLogBackend::add_value(const Field &field, const string &value, map<unsigned int, long long> &ints, map<unsigned int, string> &strs)
+{
+	int pack_i;
+	string pack_str;
+	field.Pack(value, &pack_i, &pack_str);
+	
+	switch(field.GetType())
+	{
+		case Field::en_type::INT:
+		case Field::en_type::PACK:
+			ints[field.GetID()] = pack_i;
+			break;
+		
+		case Field::en_type::CHAR:
+			strs[field.GetID()] = pack_str.substr(0, 128);
+			break;
+		
+		case Field::en_type::TEXT:
+		case Field::en_type::ITEXT:
+			strs[field.GetID()] = pack_str.substr(0, 65535);
+			break;
+		
+		case Field::en_type::IP:
+			strs[field.GetID()] = pack_str;
+			break;
+		
+		case Field::en_type::NONE:
+			break;
+	}
+}
+
+string SegmentLogBackend::normalize_date(const string &date)
+{
+	if(date.size()==10)
+		return date+" 00:00:00";
+	
+	return date;
+}
+
+long long SegmentLogBackend::date_key(const string &day, long long time)
+{
+	// Only used to compare dates: YYYYMMDD followed by the seconds in the day
+	int y = 0, m = 0, d = 0;
+	sscanf(day.c_str(), "%4d-%2d-%2d", &y, &m, &d);
+	
+	return ((long long)y*10000 + m*100 + d)*100000 + time;
+}
+
+int SegmentLogBackend::parse_time(const string &date)
+{
+	int y, m, d, h, i, s;
+	if(sscanf(date.c_str(), "%4d-%2d-%2d %2d:%2d:%2d", &y, &m, &d, &h, &i, &s)!=6 || date.size()<19)
+		throw Exception("SegmentLogBackend", "Invalid date "+date);
+	
+	return h*3600 + i*60 + s;
+}
+
+string SegmentLogBackend::format_time(int t)
+{
+	char buf[16];
+	snprintf(buf, 16, "%02d:%02d:%02d", t/3600, (t/60)%60, t%60);
+	return string(buf);
+}
+
+vector<string> SegmentLogBackend::list_directory(const string &path)
+{
+	vector<string> entries;
+	
+	DIR *dh = opendir(path.c_str());
+	if(!dh)
+		return entries; // Nothing has been stored yet
+	
+	struct dirent *result;
+	while((result = readdir(dh))!=0)
+	{
+		if(result->d_name[0]=='.')
+			continue; // Skip hidden and temporary files
+		
+		entries.push_back(result->d_name);
+	}
+	
+	closedir(dh);
+	
+	sort(entries.begin(), entries.end());
+	return entries;
+}
+
+void SegmentLogBackend::create_directory(const string &path)
+{
+	if(mkdir(path.c_str(), 0750)!=0 && errno!=EEXIST)
+		throw Exception("SegmentLogBackend", "Unable to create directory "+path+" : "+strerror(errno));
+}
+
+}
@@ -0,0 +1,328 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#include <ELogs/StreamIngest.h>
+#include <ELogs/LogStorage.h>
+#include <Configuration/Configuration.h>
+#include <Logger/Logger.h>
+#include <Utils/Date.h>
+
+#include <chrono>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+namespace ELogs
+{
+
+StreamIngest::StreamIngest(LogStorage *storage)
+{
+	Configuration *config = Configuration::GetInstance();
+	
+	this->storage = storage;
+	
+	framing = config->Get("elog.stream.framing")=="length"?LENGTH:NEWLINE;
+	max_size = config->GetSize("elog.log.maxsize");
+	ack_every = config->GetInt("elog.stream.ack");
+	max_connections = config->GetInt("elog.stream.connections.max");
+	
+	is_shutting_down = false;
+}
+
+StreamIngest::~StreamIngest()
+{
+	{
+		unique_lock<mutex> llock(lock);
+		
+		is_shutting_down = true;
+		
+		if(connections.size())
+			Logger::Log(LOG_NOTICE,"Closing %d ELogs stream connections...", connections.size());
+		
+		// Wake up threads blocked in recv(), threads blocked on full queues will see the shutdown flag
+		for(auto it = connections.begin(); it!=connections.end(); ++it)
+			shutdown(it->first, SHUT_RDWR);
+	}
+	
+	// Connections are not removed once shutting down, so we can join without lock
+	for(auto it = connections.begin(); it!=connections.end(); ++it)
+	{
+		it->second.th.join();
+		close(it->first);
+	}
+}
+
+void StreamIngest::Accept(int s)
+{
+	unique_lock<mutex> llock(lock);
+	
+	if(is_shutting_down || connections.size()>=max_connections)
+	{
+		if(!is_shutting_down)
+			Logger::Log(LOG_WARNING,"Maximum number of ELogs stream connections reached, refusing connection");
+		
+		close(s);
+		return;
+	}
+	
+	st_connection &connection = connections[s];
+	connection.peer = get_peer(s);
+	connection.connected = time(0);
+	connection.th = thread(&StreamIngest::handle_connection, this, s);
+	
+	Logger::Log(LOG_DEBUG, "Accepting ELogs stream connection from %s, current connections : %d", connection.peer.c_str(), connections.size());
+}
+
+vector<map<string, string>> StreamIngest::GetStatistics()
+{
+	unique_lock<mutex> llock(lock);
+	
+	time_t now = time(0);
+	
+	vector<map<string, string>> stats;
+	for(auto it = connections.begin(); it!=connections.end(); ++it)
+	{
+		const st_connection &connection = it->second;
+		time_t duration = now-connection.connected;
+		
+		map<string, string> stat;
+		stat["peer"] = connection.peer;
+		stat["connected"] = Utils::Date::FormatDate("%Y-%m-%d %H:%M:%S", connection.connected);
+		stat["bytes"] = to_string(connection.bytes);
+		stat["logs"] = to_string(connection.logs);
+		stat["acked"] = to_string(connection.acked);
+		stat["rate"] = to_string(duration>0?connection.logs/duration:connection.logs);
+		stat["waits"] = to_string(connection.waits);
+		stat["wait_time"] = to_string((unsigned long long)connection.wait_time);
+		stat["waiting"] = connection.waiting?"yes":"no";
+		stats.push_back(stat);
+	}
+	
+	return stats;
+}
+
+string StreamIngest::get_peer(int s)
+{
+	struct sockaddr_storage addr;
+	socklen_t addr_len = sizeof(addr);
+	if(getpeername(s, (struct sockaddr *)&addr, &addr_len)!=0)
+		return "unknown";
+	
+	char ip[INET6_ADDRSTRLEN];
+	if(addr.ss_family==AF_INET)
+	{
+		struct sockaddr_in *addr4 = (struct sockaddr_in *)&addr;
+		inet_ntop(AF_INET, &addr4->sin_addr, ip, sizeof(ip));
+		return string(ip)+":"+to_string(ntohs(addr4->sin_port));
+	}
+	else if(addr.ss_family==AF_INET6)
+	{
+		struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&addr;
+		inet_ntop(AF_INET6, &addr6->sin6_addr, ip, sizeof(ip));
+		return "["+string(ip)+"]:"+to_string(ntohs(addr6->sin6_port));
+	}
+	
+	return "unix";
+}
+
+void StreamIngest::handle_connection(int s)
+{
+	string buf;
+	size_t scan = 0; // Bytes of buf already searched for a newline
+	char rbuf[65536];
+	unsigned long long logs = 0, acked = 0;
+	
+	while(true)
+	{
+		ssize_t len = recv(s, rbuf, sizeof(rbuf), 0);
+		if(len<=0)
+			break;
+		
+		{
+			unique_lock<mutex> llock(lock);
+			connections.at(s).bytes += len;
+		}
+		
+		buf.append(rbuf, len);
+		
+		size_t pos = 0;
+		string msg, error;
+		bool stored = true;
+		while(next_message(buf, pos, scan, msg, error))
+		{
+			// We do not read from the socket while the queue is full, this will fill the TCP window of the sender
+			if(!(stored = store(s, msg)))
+				break;
+			
+			if(++logs-acked>=ack_every)
+			{
+				if(!send_ack(s, logs))
+					break;
+				acked = logs;
+			}
+		}
+		
+		if(!stored)
+			break; // Shutting down
+		
+		if(error!="")
+		{
+			Logger::Log(LOG_WARNING, "ELogs stream connection : %s", error.c_str());
+			
+			string err = "ERR "+error+"\n";
+			send(s, err.c_str(), err.length(), MSG_NOSIGNAL);
+			break;
+		}
+		
+		buf.erase(0, pos);
+		scan -= pos;
+		
+		// Acknowledge as soon as everything received has been queued (accepted, not yet committed)
+		if(logs>acked)
+		{
+			if(!send_ack(s, logs))
+				break;
+			acked = logs;
+		}
+	}
+	
+	end_connection(s);
+}
+
+void StreamIngest::end_connection(int s)
+{
+	unique_lock<mutex> llock(lock);
+	
+	// Connection will be closed and joined by destructor
+	if(is_shutting_down)
+		return;
+	
+	connections.at(s).th.detach();
+	connections.erase(s);
+	close(s);
+	
+	Logger::Log(LOG_DEBUG, "Ending ELogs stream connection, current connections : %d", connections.size());
+}
+
+bool StreamIngest::next_message(const string &buf, size_t &pos, size_t &scan, string &msg, string &error)
+{
+	if(framing==NEWLINE)
+	{
+		// Do not search again what was already received without newline
+		size_t end = buf.find('\n', scan>pos?scan:pos);
+		if(end==string::npos)
+		{
+			scan = buf.length();
+			if(buf.length()-pos>max_size)
+				error = "log exceeds maximum size";
+			return false;
+		}
+		
+		size_t len = end-pos;
+		if(len>0 && buf[end-1]=='\r')
+			len--;
+		
+		msg = buf.substr(pos, len);
+		pos = end+1;
+		scan = pos;
+	}
+	else
+	{
+		// 4 bytes big endian length prefix
+		if(buf.length()-pos<4)
+			return false;
+		
+		const unsigned char *prefix = (const unsigned char *)buf.c_str()+pos;
+		size_t len = ((size_t)prefix[0]<<24) | ((size_t)prefix[1]<<16) | ((size_t)prefix[2]<<8) | (size_t)prefix[3];
+		if(len>max_size)
+		{
+			error = "log exceeds maximum size";
+			return false;
+		}
+		
+		if(buf.length()-pos-4<len)
+			return false;
+		
+		msg = buf.substr(pos+4, len);
+		pos += 4+len;
+	}
+	
+	if(msg.length()>max_size)
+	{
+		error = "log exceeds maximum size";
+		return false;
+	}
+	
+	return true;
+}
+
+bool StreamIngest::store(int s, const string &msg)
+{
+	if(storage->Log(msg))
+	{
+		unique_lock<mutex> llock(lock);
+		connections.at(s).logs++;
+		return true;
+	}
+	
+	// Queue is full, wait for space
+	{
+		unique_lock<mutex> llock(lock);
+		st_connection &connection = connections.at(s);
+		connection.waits++;
+		connection.waiting = true;
+	}
+	
+	auto start = chrono::steady_clock::now();
+	
+	bool stored;
+	while(!(stored = storage->Log(msg, 1000)))
+	{
+		unique_lock<mutex> llock(lock);
+		if(is_shutting_down)
+			break;
+	}
+	
+	unique_lock<mutex> llock(lock);
+	st_connection &connection = connections.at(s);
+	connection.waiting = false;
+	connection.wait_time += chrono::duration<double>(chrono::steady_clock::now()-start).count();
+	if(stored)
+		connection.logs++;
+	
+	return stored;
+}
+
+bool StreamIngest::send_ack(int s, unsigned long long logs)
+{
+	string ack = "ACK "+to_string(logs)+"\n";
+	if(send(s, ack.c_str(), ack.length(), MSG_NOSIGNAL)!=ack.length())
+		return false;
+	
+	unique_lock<mutex> llock(lock);
+	connections.at(s).acked = logs;
+	
+	return true;
+}
+
+}
@@ -113,6 +113,25 @@ static map<string, string> elogs_tables = {
  PARTITION BY RANGE (to_days(`log_date`)) \
 (PARTITION `p0` VALUES LESS THAN (0) ENGINE = InnoDB); \
 "},
+{"t_log_rollup",
+"CREATE TABLE `t_log_rollup` ( \
+  `rollup_minute` datetime NOT NULL, \
+  `channel_id` int(10) unsigned NOT NULL, \
+  `log_crit` int(10) unsigned NOT NULL, \
+  `field_id` int(10) unsigned NOT NULL, \
+  `value` int(11) NOT NULL, \
+  `rollup_count` bigint(20) unsigned NOT NULL, \
+  PRIMARY KEY (`rollup_minute`,`channel_id`,`log_crit`,`field_id`,`value`) \
+) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COMMENT='v3.3'; \
+"},
+{"t_log_rollup_start",
+"CREATE TABLE `t_log_rollup_start` ( \
+  `node_name` varchar(32) CHARACTER SET ascii NOT NULL, \
+  `field_id` int(10) unsigned NOT NULL, \
+  `rollup_start` datetime NOT NULL, \
+  PRIMARY KEY (`node_name`,`field_id`) \
+) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COMMENT='v3.3'; \
+"},
 {"t_pack",
 "CREATE TABLE `t_pack` ( \
   `pack_id` int(10) unsigned NOT NULL AUTO_INCREMENT, \
@@ -0,0 +1,526 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#include <Process/AgentProtocol.h>
+#include <Exception/Exception.h>
+#include <global.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+
+using namespace std;
+
+AgentProtocolWriter::AgentProtocolWriter(int fd, int version)
+{
+	this->fd = fd;
+	this->version = version;
+	
+	buf.resize(AGENT_MAX_FRAME_SIZE);
+}
+
+AgentProtocolWriter::~AgentProtocolWriter()
+{
+	for(int i=0;i<AGENT_MAXFD;i++)
+	{
+		if(zstreams[i])
+		{
+			deflateEnd(zstreams[i]);
+			delete zstreams[i];
+		}
+	}
+}
+
+void AgentProtocolWriter::EnableCompression(int stream_fd, int level)
+{
+	if(version<AGENT_PROTOCOL_VERSION || stream_fd<0 || stream_fd>=AGENT_MAXFD || zstreams[stream_fd])
+		return;
+	
+	z_stream *strm = new z_stream;
+	strm->zalloc = Z_NULL;
+	strm->zfree = Z_NULL;
+	strm->opaque = Z_NULL;
+	if(deflateInit(strm, level)!=Z_OK)
+	{
+		delete strm;
+		throw Exception("AgentProtocol","Unable to initialize compression");
+	}
+	
+	zstreams[stream_fd] = strm;
+}
+
+void AgentProtocolWriter::Handshake()
+{
+	if(version<AGENT_PROTOCOL_VERSION)
+		return;
+	
+	char handshake[2] = {(char)AGENT_PROTOCOL_MAGIC, (char)AGENT_PROTOCOL_VERSION};
+	write_all(handshake,2);
+}
+
+bool AgentProtocolWriter::Forward(int stream_fd, int in_fd)
+{
+	// Size the frame on what is available right now, this makes frames grow with the throughput of the task
+	int avail = 0;
+	if(ioctl(in_fd,FIONREAD,&avail)!=0)
+		avail = 0;
+	
+	if(avail>0 && version>=AGENT_PROTOCOL_VERSION && use_splice && !zstreams[stream_fd])
+	{
+		// Data is moved from the task pipe to our output without being copied to user space
+		size_t len = MIN(avail, AGENT_MAX_FRAME_SIZE);
+		write_header(stream_fd, 0, len);
+		splice_all(in_fd, len);
+		return true;
+	}
+	
+	if(avail<AGENT_MIN_FRAME_SIZE)
+		avail = AGENT_MIN_FRAME_SIZE;
+	else if(avail>AGENT_MAX_FRAME_SIZE)
+		avail = AGENT_MAX_FRAME_SIZE;
+	
+	ssize_t read_size;
+	do
+	{
+		read_size = read(in_fd,buf.data(),avail);
+	} while(read_size<0 && errno==EINTR);
+	
+	if(read_size<=0)
+		return false;
+	
+	if(version<AGENT_PROTOCOL_VERSION)
+		write_legacy(stream_fd, buf.data(), read_size);
+	else if(zstreams[stream_fd])
+	{
+		z_stream *strm = zstreams[stream_fd];
+		
+		zbuf.resize(deflateBound(strm,read_size)+64);
+		
+		strm->next_in = (Bytef *)buf.data();
+		strm->avail_in = read_size;
+		strm->next_out = (Bytef *)zbuf.data();
+		strm->avail_out = zbuf.size();
+		
+		// Sync flush so each frame can be inflated on its own by the monitor
+		if(deflate(strm, Z_SYNC_FLUSH)!=Z_OK || strm->avail_in!=0)
+			throw Exception("AgentProtocol","Compression error");
+		
+		write_frame(stream_fd, AGENT_FLAG_DEFLATE, zbuf.data(), zbuf.size()-strm->avail_out);
+	}
+	else
+		write_frame(stream_fd, 0, buf.data(), read_size);
+	
+	return true;
+}
+
+void AgentProtocolWriter::GrowPipe(int fd)
+{
+#ifdef F_SETPIPE_SZ
+	// Best effort, the system might limit pipe size (/proc/sys/fs/pipe-max-size)
+	fcntl(fd, F_SETPIPE_SZ, AGENT_MAX_FRAME_SIZE);
+#endif
+}
+
+void AgentProtocolWriter::write_header(int stream_fd, unsigned char flags, size_t len)
+{
+	unsigned char header[AGENT_HEADER_SIZE];
+	header[0] = stream_fd;
+	header[1] = flags;
+	header[2] = (len>>24) & 0xFF;
+	header[3] = (len>>16) & 0xFF;
+	header[4] = (len>>8) & 0xFF;
+	header[5] = len & 0xFF;
+	
+	write_all((char *)header, AGENT_HEADER_SIZE);
+}
+
+void AgentProtocolWriter::write_frame(int stream_fd, unsigned char flags, const char *data, size_t len)
+{
+	unsigned char header[AGENT_HEADER_SIZE];
+	header[0] = stream_fd;
+	header[1] = flags;
+	header[2] = (len>>24) & 0xFF;
+	header[3] = (len>>16) & 0xFF;
+	header[4] = (len>>8) & 0xFF;
+	header[5] = len & 0xFF;
+	
+	struct iovec iov[2];
+	iov[0].iov_base = header;
+	iov[0].iov_len = AGENT_HEADER_SIZE;
+	iov[1].iov_base = (void *)data;
+	iov[1].iov_len = len;
+	
+	ssize_t written;
+	do
+	{
+		written = writev(fd, iov, 2);
+	} while(written<0 && errno==EINTR);
+	
+	if(written<0)
+		throw Exception("AgentProtocol","Error writing to output");
+	
+	// Short write, finish with plain writes
+	if(written<AGENT_HEADER_SIZE)
+	{
+		write_all((char *)header+written, AGENT_HEADER_SIZE-written);
+		written = AGENT_HEADER_SIZE;
+	}
+	
+	write_all(data+(written-AGENT_HEADER_SIZE), len-(written-AGENT_HEADER_SIZE));
+}
+
+void AgentProtocolWriter::write_legacy(int stream_fd, const char *data, size_t len)
+{
+	// Legacy monitors cannot read frames larger than 4096 bytes
+	char header[AGENT_LEGACY_HEADER_SIZE+1];
+	
+	for(size_t offset=0;offset<len;offset+=AGENT_LEGACY_FRAME_SIZE)
+	{
+		size_t frame_size = MIN(len-offset, AGENT_LEGACY_FRAME_SIZE);
+		
+		sprintf(header,"%02d%09d",stream_fd,(int)frame_size);
+		write_all(header, AGENT_LEGACY_HEADER_SIZE);
+		write_all(data+offset, frame_size);
+	}
+}
+
+void AgentProtocolWriter::write_all(const char *data, size_t len)
+{
+	while(len>0)
+	{
+		ssize_t written = write(fd,data,len);
+		if(written<0 && errno==EINTR)
+			continue;
+		
+		if(written<=0)
+			throw Exception("AgentProtocol","Error writing to output");
+		
+		data += written;
+		len -= written;
+	}
+}
+
+void AgentProtocolWriter::splice_all(int in_fd, size_t len)
+{
+	while(len>0)
+	{
+		ssize_t moved = splice(in_fd, 0, fd, 0, len, SPLICE_F_MOVE|SPLICE_F_MORE);
+		if(moved<0 && errno==EINTR)
+			continue;
+		
+		if(moved<0 && (errno==EINVAL || errno==ENOSYS))
+		{
+			// Output does not support splice, use read/write from now on
+			use_splice = false;
+			break;
+		}
+		
+		if(moved<=0)
+			throw Exception("AgentProtocol","Error forwarding data to output");
+		
+		len -= moved;
+	}
+	
+	// Fallback if splice is not supported. Header is already written so we have to send exactly len bytes
+	while(len>0)
+	{
+		ssize_t read_size = read(in_fd, buf.data(), MIN(len, buf.size()));
+		if(read_size<0 && errno==EINTR)
+			continue;
+		
+		if(read_size<=0)
+			throw Exception("AgentProtocol","Error reading data to forward");
+		
+		write_all(buf.data(), read_size);
+		len -= read_size;
+	}
+}
+
+AgentProtocolReader::AgentProtocolReader(int fd)
+{
+	this->fd = fd;
+	
+	for(int i=0;i<AGENT_MAXFD;i++)
+		splice_targets[i] = -1;
+}
+
+AgentProtocolReader::~AgentProtocolReader()
+{
+	for(int i=0;i<AGENT_MAXFD;i++)
+	{
+		if(zstreams[i])
+		{
+			inflateEnd(zstreams[i]);
+			delete zstreams[i];
+		}
+	}
+}
+
+void AgentProtocolReader::SetSpliceTarget(int stream_fd, int out_fd)
+{
+	if(stream_fd>=0 && stream_fd<AGENT_MAXFD)
+		splice_targets[stream_fd] = out_fd;
+}
+
+AgentProtocolReader::en_status AgentProtocolReader::ReadFrame(int *stream_fd, const char **data, size_t *len)
+{
+	if(version==0)
+	{
+		int re = handshake();
+		if(re==0)
+			return FRAME_EOF;
+		else if(re<0)
+			return FRAME_ERROR;
+	}
+	
+	if(version==1)
+	{
+		// Legacy ASCII header, first byte might have been consumed by the handshake
+		char header[AGENT_LEGACY_HEADER_SIZE+1];
+		size_t offset = 0;
+		if(pending_byte!=-1)
+		{
+			header[0] = pending_byte;
+			pending_byte = -1;
+			offset = 1;
+		}
+		else
+		{
+			ssize_t read_size = read(fd,header,1);
+			if(read_size==0)
+				return FRAME_EOF;
+			if(read_size!=1)
+				return FRAME_ERROR;
+			offset = 1;
+		}
+		
+		if(!read_all(header+offset, AGENT_LEGACY_HEADER_SIZE-offset))
+			return FRAME_ERROR;
+		
+		header[AGENT_LEGACY_HEADER_SIZE] = '\0';
+		size_t data_size = atoi(header+2);
+		header[2] = '\0';
+		*stream_fd = atoi(header);
+		
+		if(data_size>AGENT_LEGACY_FRAME_SIZE || *stream_fd<0 || *stream_fd>=AGENT_MAXFD)
+			return FRAME_ERROR;
+		
+		buf.resize(AGENT_LEGACY_FRAME_SIZE);
+		if(!read_all(buf.data(), data_size))
+			return FRAME_ERROR;
+		
+		*data = buf.data();
+		*len = data_size;
+		return FRAME_OK;
+	}
+	
+	unsigned char header[AGENT_HEADER_SIZE];
+	ssize_t read_size;
+	do
+	{
+		read_size = read(fd,header,1);
+	} while(read_size<0 && errno==EINTR);
+	
+	if(read_size==0)
+		return FRAME_EOF;
+	
+	if(read_size!=1 || !read_all((char *)header+1, AGENT_HEADER_SIZE-1))
+		return FRAME_ERROR;
+	
+	*stream_fd = header[0];
+	unsigned char flags = header[1];
+	size_t frame_size = ((size_t)header[2]<<24) | ((size_t)header[3]<<16) | ((size_t)header[4]<<8) | (size_t)header[5];
+	
+	// Compressed frames can be slightly larger than raw ones
+	if(*stream_fd>=AGENT_MAXFD || frame_size>2*AGENT_MAX_FRAME_SIZE)
+		return FRAME_ERROR;
+	
+	if(flags&AGENT_FLAG_DEFLATE)
+	{
+		if(!inflate_frame(*stream_fd, frame_size))
+			return FRAME_ERROR;
+		
+		*data = buf.data();
+		*len = buf.size();
+		return FRAME_OK;
+	}
+	
+	if(splice_targets[*stream_fd]!=-1)
+	{
+		if(!splice_all(splice_targets[*stream_fd], frame_size))
+			return FRAME_ERROR;
+		
+		// Data has already been written to its target
+		*data = 0;
+		*len = frame_size;
+		return FRAME_OK;
+	}
+	
+	buf.resize(frame_size);
+	if(!read_all(buf.data(), frame_size))
+		return FRAME_ERROR;
+	
+	*data = buf.data();
+	*len = frame_size;
+	return FRAME_OK;
+}
+
+int AgentProtocolReader::handshake()
+{
+	unsigned char c;
+	ssize_t read_size;
+	do
+	{
+		read_size = read(fd,&c,1);
+	} while(read_size<0 && errno==EINTR);
+	
+	if(read_size==0)
+		return 0;
+	if(read_size!=1)
+		return -1;
+	
+	if(c!=AGENT_PROTOCOL_MAGIC)
+	{
+		// Agent does not know the binary protocol, keep the byte we have read for the first legacy header
+		version = 1;
+		pending_byte = c;
+		return 1;
+	}
+	
+	if(!read_all((char *)&c,1) || c!=AGENT_PROTOCOL_VERSION)
+		return -1;
+	
+	version = AGENT_PROTOCOL_VERSION;
+	return 1;
+}
+
+bool AgentProtocolReader::read_all(char *data, size_t len)
+{
+	while(len>0)
+	{
+		ssize_t read_size = read(fd,data,len);
+		if(read_size<0 && errno==EINTR)
+			continue;
+		
+		if(read_size<=0)
+			return false;
+		
+		data += read_size;
+		len -= read_size;
+	}
+	
+	return true;
+}
+
+bool AgentProtocolReader::splice_all(int out_fd, size_t len)
+{
+	while(len>0)
+	{
+		ssize_t moved = splice(fd, 0, out_fd, 0, len, SPLICE_F_MOVE);
+		if(moved<0 && errno==EINTR)
+			continue;
+		
+		if(moved<=0)
+			break;
+		
+		len -= moved;
+	}
+	
+	if(len==0)
+		return true;
+	
+	// Splice is not possible on this target, fallback to read/write
+	for(int i=0;i<AGENT_MAXFD;i++)
+		if(splice_targets[i]==out_fd)
+			splice_targets[i] = -1;
+	
+	buf.resize(MIN(len, AGENT_MAX_FRAME_SIZE));
+	while(len>0)
+	{
+		size_t chunk = MIN(len, buf.size());
+		if(!read_all(buf.data(), chunk))
+			return false;
+		
+		if(write(out_fd, buf.data(), chunk)!=(ssize_t)chunk)
+			fprintf(stderr,"Error writing to fd %d\n",out_fd);
+		
+		len -= chunk;
+	}
+	
+	return true;
+}
+
+bool AgentProtocolReader::inflate_frame(int stream_fd, size_t len)
+{
+	zbuf.resize(len);
+	if(!read_all(zbuf.data(), len))
+		return false;
+	
+	if(!zstreams[stream_fd])
+	{
+		z_stream *strm = new z_stream;
+		strm->zalloc = Z_NULL;
+		strm->zfree = Z_NULL;
+		strm->opaque = Z_NULL;
+		strm->next_in = Z_NULL;
+		strm->avail_in = 0;
+		if(inflateInit(strm)!=Z_OK)
+		{
+			delete strm;
+			return false;
+		}
+		
+		zstreams[stream_fd] = strm;
+	}
+	
+	z_stream *strm = zstreams[stream_fd];
+	strm->next_in = (Bytef *)zbuf.data();
+	strm->avail_in = len;
+	
+	// Frames are compressed from at most AGENT_MAX_FRAME_SIZE bytes, one extra byte detects bigger (corrupted) frames
+	size_t out_len = 0;
+	buf.resize(AGENT_MAX_FRAME_SIZE+1);
+	while(true)
+	{
+		strm->next_out = (Bytef *)buf.data()+out_len;
+		strm->avail_out = buf.size()-out_len;
+		
+		int re = inflate(strm, Z_SYNC_FLUSH);
+		if(re!=Z_OK && re!=Z_BUF_ERROR)
+			return false;
+		
+		out_len = buf.size()-strm->avail_out;
+		if(out_len>AGENT_MAX_FRAME_SIZE)
+			return false;
+		
+		if(strm->avail_in==0 && strm->avail_out!=0)
+			break;
+		
+		if(re==Z_BUF_ERROR && strm->avail_in==0)
+			break;
+	}
+	
+	buf.resize(out_len);
+	return true;
+}
@@ -0,0 +1,178 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#include <Process/Cgroup.h>
+#include <Exception/Exception.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <sstream>
+
+using namespace std;
+
+Cgroup::Cgroup(const string &base, const string &name)
+{
+	// Task groups must stay below the base group
+	istringstream components(name);
+	for(string component; getline(components,component,'/');)
+	{
+		if(component=="" || component=="." || component=="..")
+			throw Exception("Cgroup","Invalid cgroup name '"+name+"'");
+	}
+	
+	if(name=="" || name[name.length()-1]=='/')
+		throw Exception("Cgroup","Invalid cgroup name '"+name+"'");
+	
+	this->base = base;
+	this->path = base+"/"+name;
+}
+
+void Cgroup::Create()
+{
+	// Base group must exist (it is delegated to evQueue), create intermediate groups and delegate controllers down to the task group
+	enable_controllers(base);
+	
+	size_t pos = path.find('/',base.length()+1);
+	while(pos!=string::npos)
+	{
+		string parent = path.substr(0,pos);
+		if(mkdir(parent.c_str(),0755)!=0 && errno!=EEXIST)
+			throw Exception("Cgroup","Unable to create cgroup "+parent+" : "+strerror(errno));
+		
+		enable_controllers(parent);
+		
+		pos = path.find('/',pos+1);
+	}
+	
+	if(mkdir(path.c_str(),0755)!=0 && errno!=EEXIST)
+		throw Exception("Cgroup","Unable to create cgroup "+path+" : "+strerror(errno));
+}
+
+void Cgroup::SetLimit(const string &name, const string &value)
+{
+	if(value=="")
+		return;
+	
+	if(value.find('\n')!=string::npos)
+		throw Exception("Cgroup","Invalid value for "+name);
+	
+	if(!write_file(path+"/"+name,value))
+		throw Exception("Cgroup","Unable to set "+name+" to '"+value+"' : "+strerror(errno));
+}
+
+void Cgroup::GetAccounting(map<string,string> &accounting)
+{
+	string content;
+	
+	if(read_file(path+"/cpu.stat",content))
+	{
+		istringstream stat(content);
+		string key;
+		unsigned long long value;
+		while(stat>>key>>value)
+		{
+			if(key=="usage_usec" || key=="user_usec" || key=="system_usec")
+				accounting["cpu_"+key] = to_string(value);
+		}
+	}
+	
+	if(read_file(path+"/memory.peak",content))
+		accounting["memory_peak"] = to_string(strtoull(content.c_str(),0,10));
+	
+	if(read_file(path+"/io.stat",content))
+	{
+		// One line per device : "8:0 rbytes=1 wbytes=2 rios=3 wios=4 ..."
+		unsigned long long rbytes = 0, wbytes = 0;
+		istringstream stat(content);
+		string token;
+		while(stat>>token)
+		{
+			if(token.compare(0,7,"rbytes=")==0)
+				rbytes += strtoull(token.c_str()+7,0,10);
+			else if(token.compare(0,7,"wbytes=")==0)
+				wbytes += strtoull(token.c_str()+7,0,10);
+		}
+		
+		accounting["io_rbytes"] = to_string(rbytes);
+		accounting["io_wbytes"] = to_string(wbytes);
+	}
+}
+
+void Cgroup::Destroy()
+{
+	// Kill remaining processes (daemonized children of the task), then remove group
+	write_file(path+"/cgroup.kill","1");
+	
+	for(int i=0;i<10;i++)
+	{
+		if(rmdir(path.c_str())==0 || errno!=EBUSY)
+			return;
+		
+		usleep(10000);
+	}
+}
+
+void Cgroup::Join(const string &path)
+{
+	if(!write_file(path+"/cgroup.procs","0"))
+		throw Exception("Cgroup","Unable to join cgroup "+path+" : "+strerror(errno));
+}
+
+bool Cgroup::write_file(const string &filename, const string &value)
+{
+	int fd = open(filename.c_str(),O_WRONLY);
+	if(fd<0)
+		return false;
+	
+	ssize_t written = write(fd,value.c_str(),value.length());
+	int err = errno;
+	close(fd);
+	errno = err;
+	
+	return written==(ssize_t)value.length();
+}
+
+bool Cgroup::read_file(const string &filename, string &value)
+{
+	int fd = open(filename.c_str(),O_RDONLY);
+	if(fd<0)
+		return false;
+	
+	char buf[4096];
+	ssize_t read_size;
+	value = "";
+	while((read_size = read(fd,buf,4096))>0)
+		value.append(buf,read_size);
+	
+	close(fd);
+	
+	return read_size==0;
+}
+
+void Cgroup::enable_controllers(const string &path)
+{
+	// Best effort, controllers might not be available
+	const char *controllers[] = {"+cpu", "+memory", "+pids", "+io"};
+	for(int i=0;i<4;i++)
+		write_file(path+"/cgroup.subtree_control",controllers[i]);
+}
@@ -1,6 +1,30 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
 #include <Process/DataSerializer.h>
+#include <Exception/Exception.h>
 
 #include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/uio.h>
 
 using namespace std;
 
@@ -8,49 +32,162 @@ int DataSerializer::readlen(int fd, char *value, int value_len)
 {
 	int read_size = 0;
 	int re;
-	while(read_size<value_len && (re = read(fd,value+read_size,value_len-read_size)) > 0)
-		read_size += re;
+	while(read_size<value_len && ((re = read(fd,value+read_size,value_len-read_size)) > 0 || (re<0 && errno==EINTR)))
+	{
+		if(re>0)
+			read_size += re;
+	}
 	return read_size;
 }
 
+bool DataSerializer::read_tag(int fd, unsigned char *tag)
+{
+	return readlen(fd,(char *)tag,1)==1;
+}
+
+bool DataSerializer::read_u32(int fd, uint32_t *n)
+{
+	char buf[4];
+	if(readlen(fd,buf,4)!=4)
+		return false;
+	
+	*n = get_u32(buf);
+	return true;
+}
+
+bool DataSerializer::read_string(int fd, uint32_t len, string &str)
+{
+	if(len>DATASERIALIZER_MAX_LEN)
+		return false;
+	
+	// Read directly into the string buffer, growing it as data is received
+	str.clear();
+	while(str.length()<len)
+	{
+		size_t cur = str.length();
+		size_t chunk = len-cur;
+		if(chunk>DATASERIALIZER_READ_CHUNK)
+			chunk = DATASERIALIZER_READ_CHUNK;
+		
+		str.resize(cur+chunk);
+		if(readlen(fd,&str[cur],chunk)!=(int)chunk)
+			return false;
+	}
+	
+	return true;
+}
+
+void DataSerializer::append_u32(string &data, uint32_t n)
+{
+	char buf[4];
+	buf[0] = n & 0xFF;
+	buf[1] = (n>>8) & 0xFF;
+	buf[2] = (n>>16) & 0xFF;
+	buf[3] = (n>>24) & 0xFF;
+	data.append(buf,4);
+}
+
+uint32_t DataSerializer::get_u32(const char *buf)
+{
+	const unsigned char *ubuf = (const unsigned char *)buf;
+	return (uint32_t)ubuf[0] | ((uint32_t)ubuf[1]<<8) | ((uint32_t)ubuf[2]<<16) | ((uint32_t)ubuf[3]<<24);
+}
+
 string DataSerializer::Serialize(const map<string,string> &map)
 {
+	size_t size = 5;
+	for(auto it=map.begin();it!=map.end();++it)
+		size += 8 + it->first.length() + it->second.length();
+	
 	string data;
-	char buf[32];
+	data.reserve(size);
 	
-	sprintf(buf,"%03ld",map.size());
-	data += buf;
+	data += (char)DATASERIALIZER_TAG_MAP;
+	append_u32(data,map.size());
 	
 	for(auto it=map.begin();it!=map.end();++it)
 	{
-		sprintf(buf,"%09ld%09ld",it->first.length(),it->second.length());
-		data += buf;
-		data += it->first + it->second;
+		append_u32(data,it->first.length());
+		append_u32(data,it->second.length());
+		data += it->first;
+		data += it->second;
 	}
 	
 	return data;
 }
 
 string DataSerializer::Serialize(const vector<string> &vector)
+{
+	size_t size = 5;
+	for(size_t i=0;i<vector.size();i++)
+		size += 4 + vector.at(i).length();
+	
+	string data;
+	data.reserve(size);
+	
+	data += (char)DATASERIALIZER_TAG_VECTOR;
+	append_u32(data,vector.size());
+	
+	for(size_t i=0;i<vector.size();i++)
+	{
+		append_u32(data,vector.at(i).length());
+		data += vector.at(i);
+	}
+	
+	return data;
+}
+
+string DataSerializer::Serialize(const string &str)
 {
+	string data;
+	data.reserve(5+str.length());
+	
+	data += (char)DATASERIALIZER_TAG_STRING;
+	append_u32(data,str.length());
+	data += str;
+	
+	return data;
+}
+
+string DataSerializer::Serialize(int n)
+{
+	string data;
+	
+	data += (char)DATASERIALIZER_TAG_INT;
+	append_u32(data,(uint32_t)n);
+	
+	return data;
+}
+
+string DataSerializer::SerializeLegacy(const map<string,string> &map)
+{
+	if(map.size()>DATASERIALIZER_LEGACY_MAX_ENTRIES)
+		throw Exception("DataSerializer","Too many parameters, legacy format is limited to "+to_string(DATASERIALIZER_LEGACY_MAX_ENTRIES));
+	
 	string data;
 	char buf[32];
 	
-	sprintf(buf,"%03ld",vector.size());
+	sprintf(buf,"%03ld",map.size());
 	data += buf;
 	
-	for (int i = 0; i<vector.size(); i++)
+	for(auto it=map.begin();it!=map.end();++it)
 	{
-		sprintf(buf,"%09ld",vector.at(i).length());
+		if(it->first.length()>DATASERIALIZER_LEGACY_MAX_LEN || it->second.length()>DATASERIALIZER_LEGACY_MAX_LEN)
+			throw Exception("DataSerializer","Parameter is too long for legacy format");
+		
+		sprintf(buf,"%09ld%09ld",it->first.length(),it->second.length());
 		data += buf;
-		data += vector.at(i);
+		data += it->first + it->second;
 	}
 	
 	return data;
 }
 
-string DataSerializer::Serialize(const string &str)
+string DataSerializer::SerializeLegacy(const string &str)
 {
+	if(str.length()>DATASERIALIZER_LEGACY_MAX_LEN)
+		throw Exception("DataSerializer","String is too long for legacy format");
+	
 	string data;
 	char buf[32];
 	
@@ -62,27 +199,180 @@ string DataSerializer::Serialize(const string &str)
 	return data;
 }
 
-string DataSerializer::Serialize(int n)
+bool DataSerializer::Unserialize(int fd, map<string,string> &map)
+{
+	unsigned char tag;
+	if(!read_tag(fd,&tag))
+		return false;
+	
+	if(tag!=DATASERIALIZER_TAG_MAP)
+		return unserialize_legacy(fd,tag,map);
+	
+	uint32_t nentries;
+	if(!read_u32(fd,&nentries))
+		return false;
+	
+	if(nentries==0)
+		return true;
+	
+	char header[8];
+	if(readlen(fd,header,8)!=8)
+		return false;
+	
+	string name, value;
+	for(uint32_t i=0;i<nentries;i++)
+	{
+		uint32_t name_len = get_u32(header);
+		uint32_t value_len = get_u32(header+4);
+		
+		if(name_len>DATASERIALIZER_MAX_LEN || value_len>DATASERIALIZER_MAX_LEN)
+			return false;
+		
+		if(name_len>DATASERIALIZER_READ_CHUNK || value_len>DATASERIALIZER_READ_CHUNK)
+		{
+			// Big entry, do not trust lengths before data is received
+			if(!read_string(fd,name_len,name) || !read_string(fd,value_len,value))
+				return false;
+			
+			if(i<nentries-1 && readlen(fd,header,8)!=8)
+				return false;
+			
+			map[name_len!=0?name:"DEFAULT_PARAMETER_NAME"] = value;
+			continue;
+		}
+		
+		name.resize(name_len);
+		value.resize(value_len);
+		
+		// Read name, value and next entry header with a single call
+		struct iovec iov[3];
+		int iovcnt = 0;
+		if(name_len>0)
+			iov[iovcnt++] = {&name[0], name_len};
+		if(value_len>0)
+			iov[iovcnt++] = {&value[0], value_len};
+		if(i<nentries-1)
+			iov[iovcnt++] = {header, 8};
+		
+		int cur = 0;
+		while(cur<iovcnt)
+		{
+			ssize_t re = readv(fd,iov+cur,iovcnt-cur);
+			if(re<0 && errno==EINTR)
+				continue;
+			
+			if(re<=0)
+				return false;
+			
+			// Skip filled buffers, adjust partially filled one
+			while(cur<iovcnt && re>=(ssize_t)iov[cur].iov_len)
+				re -= iov[cur++].iov_len;
+			
+			if(cur<iovcnt)
+			{
+				iov[cur].iov_base = (char *)iov[cur].iov_base+re;
+				iov[cur].iov_len -= re;
+			}
+		}
+		
+		if(name_len!=0)
+			map[name] = value;
+		else
+			map["DEFAULT_PARAMETER_NAME"] = value;
+	}
+	
+	return true;
+}
+
+bool DataSerializer::Unserialize(int fd, vector<string> &vector)
 {
-	string str = to_string(n);
+	unsigned char tag;
+	if(!read_tag(fd,&tag))
+		return false;
+	
+	if(tag!=DATASERIALIZER_TAG_VECTOR)
+		return unserialize_legacy(fd,tag,vector);
+	
+	uint32_t nentries;
+	if(!read_u32(fd,&nentries))
+		return false;
+	
+	for(uint32_t i=0;i<nentries;i++)
+	{
+		uint32_t len;
+		if(!read_u32(fd,&len))
+			return false;
+		
+		vector.push_back(string());
+		if(!read_string(fd,len,vector.back()))
+			return false;
+	}
 	
-	return Serialize(str);
+	return true;
 }
 
+bool DataSerializer::Unserialize(int fd, string &str)
+{
+	unsigned char tag;
+	if(!read_tag(fd,&tag))
+		return false;
+	
+	if(tag!=DATASERIALIZER_TAG_STRING)
+		return unserialize_legacy(fd,tag,str);
+	
+	uint32_t len;
+	if(!read_u32(fd,&len))
+		return false;
+	
+	return read_string(fd,len,str);
+}
 
-bool DataSerializer::Unserialize(int fd, map<string,string> &map)
+bool DataSerializer::Unserialize(int fd, int *n)
+{
+	unsigned char tag;
+	if(!read_tag(fd,&tag))
+		return false;
+	
+	if(tag==DATASERIALIZER_TAG_INT)
+	{
+		uint32_t un;
+		if(!read_u32(fd,&un))
+			return false;
+		
+		*n = (int)un;
+		return true;
+	}
+	
+	string str;
+	if(!unserialize_legacy(fd,tag,str))
+		return false;
+	
+	try
+	{
+		*n = stoi(str);
+		return true;
+	}
+	catch(...)
+	{
+		return false;
+	}
+}
+
+bool DataSerializer::unserialize_legacy(int fd, char first, map<string,string> &map)
 {
 	int read_size;
-	char buf[4096];
+	char buf[32];
 	
 	// Read the number of arguments
-	read_size = readlen(fd,buf,3);
-	if(read_size!=3)
+	buf[0] = first;
+	read_size = readlen(fd,buf+1,2);
+	if(read_size!=2)
 		return false;
 		
-	buf[read_size] = '\0';
+	buf[3] = '\0';
 	int nparameters = atoi(buf);
 	
+	string name, value;
 	for(int i=0;i<nparameters;i++)
 	{
 		// Read the size of arguments
@@ -96,23 +386,10 @@ bool DataSerializer::Unserialize(int fd, map<string,string> &map)
 		buf[9] = '\0';
 		int name_len = atoi(buf);
 		
-		if(value_len>4096 || name_len>4096)
-			return false;
-		
-		char name[4097],value[4097];
-		read_size = readlen(fd,name,name_len);
-		if(read_size!=name_len)
+		if(!read_string(fd,name_len,name) || !read_string(fd,value_len,value))
 			return false;
 		
-		name[read_size] = '\0';
-		
-		read_size = readlen(fd,value,value_len);
-		if(read_size!=value_len)
-			return false;
-		
-		value[read_size] = '\0';
-		
-		if(name[0]!='\0')
+		if(name_len!=0)
 			map[name] = value;
 		else
 			map["DEFAULT_PARAMETER_NAME"] = value;
@@ -121,17 +398,18 @@ bool DataSerializer::Unserialize(int fd, map<string,string> &map)
 	return true;
 }
 
-bool DataSerializer::Unserialize(int fd, vector<string> &vector)
+bool DataSerializer::unserialize_legacy(int fd, char first, vector<string> &vector)
 {
 	int read_size;
 	char buf[32];
 	
 	// Read the number of arguments
-	read_size = readlen(fd,buf,3);
-	if(read_size!=3)
+	buf[0] = first;
+	read_size = readlen(fd,buf+1,2);
+	if(read_size!=2)
 		return false;
 	
-	buf[read_size] = '\0';
+	buf[3] = '\0';
 	int nparameters = atoi(buf);
 	
 	for(int i=0;i<nparameters;i++)
@@ -144,55 +422,26 @@ bool DataSerializer::Unserialize(int fd, vector<string> &vector)
 		buf[9] = '\0';
 		int len = atoi(buf);
 		
-		char value[len];
-		read_size = readlen(fd,value,len);
-		if(read_size!=len)
+		vector.push_back(string());
+		if(!read_string(fd,len,vector.back()))
 			return false;
-		
-		string str;
-		str.assign(value,len);
-		
-		vector.push_back(str);
 	}
 	
 	return true;
 }
 
-bool DataSerializer::Unserialize(int fd, string &str)
+bool DataSerializer::unserialize_legacy(int fd, char first, string &str)
 {
 	int read_size;
 	char buf[32];
 	
-	read_size = readlen(fd,buf,9);
-	if(read_size!=9)
+	buf[0] = first;
+	read_size = readlen(fd,buf+1,8);
+	if(read_size!=8)
 		return false;
 	
-	buf[read_size] = '\0';
+	buf[9] = '\0';
 	int value_len = atoi(buf);
 	
-	char value[value_len];
-	read_size = readlen(fd,value,value_len);
-	if(read_size!=value_len)
-		return false;
-	
-	str.assign(value,value_len);
-	
-	return true;
-}
-
-bool DataSerializer::Unserialize(int fd, int *n)
-{
-	string str;
-	if(!Unserialize(fd,str))
-		return false;
-	
-	try
-	{
-		*n = stoi(str);
-		return true;
-	}
-	catch(...)
-	{
-		return false;
-	}
+	return read_string(fd,value_len,str);
 }
@@ -24,6 +24,9 @@
 #include <Configuration/Configuration.h>
 #include <Exception/Exception.h>
 #include <Process/ProcessExec.h>
+#include <Process/AgentProtocol.h>
+#include <Process/ProgressThrottle.h>
+#include <Process/Cgroup.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,6 +34,8 @@
 #include <string.h>
 #include <fcntl.h>
 #include <syslog.h>
+#include <poll.h>
+#include <errno.h>
 
 #include <sys/ipc.h>
 #include <sys/msg.h>
@@ -39,6 +44,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <memory>
 
 static pid_t pid = 0;
 
@@ -58,6 +64,69 @@ static void signal_callback_handler(int signum)
 
 using namespace std;
 
+static bool wait_data(int fd, ProgressThrottle &progress)
+{
+	// Wait for task output, sending coalesced progress when it is due
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	
+	while(true)
+	{
+		int re = poll(&pfd,1,progress.GetTimeout());
+		if(re<0 && errno!=EINTR)
+			return false;
+		
+		if(re>0)
+			return true;
+		
+		if(re==0)
+			progress.Flush();
+	}
+}
+
+static bool handle_log_line(const char *line, int line_size, ProgressThrottle &progress)
+{
+	if(strcmp(line,"\\close\n")==0)
+		return false;
+	
+	if(!progress.Handle(line))
+	{
+		if(line[0]=='%')
+		{
+			if(write(LOG_FILENO,line+1,line_size-1)!=line_size-1)
+				fprintf(stderr,"Error writing to log file\n");
+		}
+		else
+		{
+			if(write(LOG_FILENO,line,line_size)!=line_size)
+				fprintf(stderr,"Error writing to log file\n");
+		}
+	}
+	
+	return true;
+}
+
+static bool parse_log(const char *buf, int size, char *line_buf, int *line_buf_size, ProgressThrottle &progress)
+{
+	for(int i=0;i<size;i++)
+	{
+		line_buf[(*line_buf_size)++] = buf[i];
+		if(buf[i]=='\n' || *line_buf_size==4095)
+		{
+			line_buf[*line_buf_size] = '\0';
+			
+			bool cont = handle_log_line(line_buf,*line_buf_size,progress);
+			*line_buf_size = 0;
+			
+			if(!cont)
+				return false;
+		}
+	}
+	
+	return true;
+}
+
 int Monitor::main()
 {
 	Configuration *config = Configuration::GetInstance();
@@ -140,6 +209,7 @@ int Monitor::main()
 		ProcessExec proc;
 		
 		int stdout_fd = -1, log_fd = -1;
+		unique_ptr<Cgroup> cgroup;
 		bool use_ssh = monitor_config.Get("monitor.ssh.host")!="";
 		if(use_ssh)
 		{
@@ -171,6 +241,10 @@ int Monitor::main()
 					config_map["processmanager.scripts.directory"] = config->Get("processmanager.scripts.directory");
 				}
 				
+				// Request binary protocol, agents that do not know this entry will use legacy format
+				config_map["agent.protocol"] = to_string(AGENT_PROTOCOL_VERSION);
+				config_map["agent.compress"] = config->Get("processmanager.agent.compress");
+				
 				proc.PipeMap(config_map);
 				proc.PipeMap(env_map);
 				
@@ -201,6 +275,17 @@ int Monitor::main()
 			
 			log_fd = proc.ParentRedirect(LOG_FILENO);
 			proc.Pipe(stdin_data);
+			
+			if(monitor_config.Get("monitor.cgroup.name")!="")
+			{
+				// Run task in its own cgroup to limit and account its resources
+				cgroup = unique_ptr<Cgroup>(new Cgroup(config->Get("processmanager.cgroup.path"),monitor_config.Get("monitor.cgroup.name")));
+				cgroup->Create();
+				cgroup->SetLimit("memory.max",monitor_config.Get("monitor.cgroup.memory.max"));
+				cgroup->SetLimit("cpu.max",monitor_config.Get("monitor.cgroup.cpu.max"));
+				cgroup->SetLimit("pids.max",monitor_config.Get("monitor.cgroup.pids.max"));
+				proc.SetCgroup(cgroup->GetPath());
+			}
 		}
 		
 		if(monitor_config.Get("monitor.merge_stderr")=="yes")
@@ -216,92 +301,50 @@ int Monitor::main()
 		else if(pid==0)
 			throw Exception("evq_monitor","Unable to execute command '"+task_filename+"', execv() returned error");
 		
+		// Progress lines are coalesced, only the latest value is sent to the engine
+		ProgressThrottle progress(msgqid,tid,config->GetInt("processmanager.progress.interval"));
+		
+		char line_buf[4096];
+		int line_buf_size = 0;
+		
 		if(use_ssh && monitor_config.GetBool("monitor.ssh.useagent"))
 		{
 			// When using evqueue agent over SSH we receive 3 FDs multiplexed on stdout
 			
-			char line_buf[4096];
-			int line_buf_size = 0;
-	
 			// Demultiplex Data
-			FILE *log_in = fdopen(stdout_fd,"r");
-			while(1)
+			AgentProtocolReader reader(stdout_fd);
+			
+			// stdout and stderr are stored as is, move them directly to log files when possible
+			reader.SetSpliceTarget(STDOUT_FILENO,STDOUT_FILENO);
+			reader.SetSpliceTarget(STDERR_FILENO,STDERR_FILENO);
+			
+			while(wait_data(stdout_fd,progress))
 			{
-				char buf[4096];
-				int read_size,data_size,data_fd;
+				int data_fd;
+				const char *buf;
+				size_t read_size;
 				
-				// Read file descriptor
-				read_size = fread(buf,1,2,log_in);
-				if(read_size==0)
+				AgentProtocolReader::en_status status = reader.ReadFrame(&data_fd,&buf,&read_size);
+				if(status==AgentProtocolReader::FRAME_EOF)
 					break;
 				
-				if(read_size!=2)
+				if(status==AgentProtocolReader::FRAME_ERROR)
 				{
 					fprintf(stderr,"Corrupted data received from evqueue agent\n");
 					break;
 				}
 				
-				buf[read_size] = '\0';
-				data_fd = atoi(buf);
-				
-				// Read data length
-				read_size = fread(buf,1,9,log_in);
-				if(read_size!=9)
-				{
-					fprintf(stderr,"Corrupted data received from evqueue agent\n");
-					break;
-				}
-				
-				buf[read_size] = '\0';
-				data_size = atoi(buf);
-				
-				if(data_size>4096)
-				{
-					fprintf(stderr,"Corrupted data received from evqueue agent\n");
-					break;
-				}
-				
-				read_size = fread(buf,1,data_size,log_in);
-				if(read_size!=data_size)
-				{
-					fprintf(stderr,"Corrupted data received from evqueue agent\n");
-					break;
-				}
+				if(!buf)
+					continue; // Data has already been forwarded
 				
 				if(data_fd==LOG_FILENO)
 				{
-					// Parse evqueue log
-					for(int i=0;i<read_size;i++)
-					{
-						line_buf[line_buf_size++] = buf[i];
-						if(buf[i]=='\n' || line_buf_size==4095)
-						{
-							line_buf[line_buf_size] = '\0';
-							
-							if(strcmp(line_buf,"\\close\n")==0)
-								break;
-							
-							if(!ipc_send_progress_message(msgqid,line_buf,tid))
-							{
-								if(line_buf[0]=='%')
-								{
-									if(write(LOG_FILENO,line_buf+1,line_buf_size-1)!=line_buf_size-1)
-										fprintf(stderr,"Error writing to log file\n");
-								}
-								else
-								{
-									if(write(LOG_FILENO,line_buf,line_buf_size)!=line_buf_size)
-										fprintf(stderr,"Error writing to log file\n");
-								}
-							}
-							
-							line_buf_size = 0;
-						}
-					}
+					// Parse evqueue log, remaining of the frame is dropped after \close
+					parse_log(buf,read_size,line_buf,&line_buf_size,progress);
 				}
 				else // Directly forward stdout and sterr
 				{
-					if(write(data_fd,buf,read_size)!=read_size)
+					if(write(data_fd,buf,read_size)!=(ssize_t)read_size)
 						fprintf(stderr,"Error writing to fd %d\n",data_fd);
 				}
 			}
@@ -309,33 +352,54 @@ int Monitor::main()
 		else if(!use_ssh)
 		{
 			// Running locally, stdout and stderr are already handled, just parse evqueue log
-		
+			
 			char buf[4096];
-			FILE *log_in = fdopen(log_fd,"r");
-			FILE *log_out = fdopen(LOG_FILENO,"w");
-			while(fgets(buf,4096,log_in))
+			while(wait_data(log_fd,progress))
 			{
-				if(strcmp(buf,"\\close\n")==0)
+				ssize_t read_size = read(log_fd,buf,4096);
+				if(read_size<0 && errno==EINTR)
+					continue;
+				
+				if(read_size<=0)
 					break;
 				
-				if(!ipc_send_progress_message(msgqid,buf,tid))
+				if(!parse_log(buf,read_size,line_buf,&line_buf_size,progress))
 				{
-					if(buf[0]=='%')
-						fputs(buf+1,log_out);
-					else
-						fputs(buf,log_out);
-					
-					fflush(log_out);
+					line_buf_size = 0;
+					break;
 				}
 			}
-			fclose(log_in);
-			fclose(log_out);
+			close(log_fd);
 		}
 		
+		// Last line might not be terminated
+		if(line_buf_size>0)
+		{
+			line_buf[line_buf_size] = '\0';
+			handle_log_line(line_buf,line_buf_size,progress);
+		}
 		
 		int status;
 		waitpid(pid,&status,0);
 		
+		if(cgroup)
+		{
+			// Store accounting next to task logs, it is read by the engine along with outputs
+			map<string,string> accounting;
+			cgroup->GetAccounting(accounting);
+			cgroup->Destroy();
+			
+			FILE *f = fopen((logs_directory+"/"+to_string(tid)+".resources").c_str(),"w");
+			if(f)
+			{
+				for(auto it=accounting.begin();it!=accounting.end();++it)
+					fprintf(f,"%s=%s\n",it->first.c_str(),it->second.c_str());
+				fclose(f);
+			}
+			else
+				fprintf(stderr,"Unable to write resources accounting\n");
+		}
+		
 		if(monitor_config.Get("monitor.task.type")=="SCRIPT" && config->GetBool("processmanager.scripts.delete"))
 			unlink(proc.GetPath().c_str());
 		
@@ -344,6 +408,9 @@ int Monitor::main()
 		else
 			msgbuf.mtext.retcode = -1;
 		
+		// Last progress value must reach the engine before exit notification
+		progress.Flush();
+		
 		// Notify evqueue
 		if(msgsnd(msgqid,&msgbuf,sizeof(st_msgbuf::mtext),0)==-1)
 			syslog(LOG_CRIT, "evq_monitor: failed to send daemon notification");
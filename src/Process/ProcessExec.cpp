@@ -99,14 +99,15 @@ void ProcessExec::PipeMap(const map<string,string> &data)
 {
 	init_stdin_pipe();
 	
-	stdin_data += DataSerializer::Serialize(data);
+	// Data is read by evqueue_agent which might run an older version on a remote host, stick to the legacy format
+	stdin_data += DataSerializer::SerializeLegacy(data);
 }
 
 void ProcessExec::PipeString(const string &data)
 {
 	init_stdin_pipe();
 	
-	stdin_data += DataSerializer::Serialize(data);
+	stdin_data += DataSerializer::SerializeLegacy(data);
 }
 
 void ProcessExec::Pipe(const string &data)
@@ -163,6 +164,19 @@ pid_t ProcessExec::Exec()
 	{
 		setsid(); // This is used to avoid CTRL+C killing all child processes
 		
+		if(cgroup!="")
+		{
+			// Move ourself to the cgroup before exec so all descendants are accounted
+			int fd = open((cgroup+"/cgroup.procs").c_str(),O_WRONLY);
+			if(fd<0 || write(fd,"0",1)!=1)
+			{
+				fprintf(stderr,"Unable to join cgroup %s\n",cgroup.c_str());
+				return pid;
+			}
+			
+			close(fd);
+		}
+		
 		if(wd!="")
 		{
 			if(chdir(wd.c_str())!=0)
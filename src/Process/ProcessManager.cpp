@@ -21,6 +21,7 @@
 #include <Exception/Exception.h>
 #include <global.h>
 #include <Queue/QueuePool.h>
+#include <Queue/Queue.h>
 #include <WorkflowInstance/WorkflowInstance.h>
 #include <Notification/Notifications.h>
 #include <Configuration/ConfigurationEvQueue.h>
@@ -56,6 +57,8 @@
 #include <arpa/inet.h>
 
 #include <string>
+#include <map>
+#include <chrono>
 
 static auto init = QueryHandlers::GetInstance()->RegisterInit([](QueryHandlers *qh) {
 	qh->RegisterHandler("processmanager",ProcessManager::HandleQuery);
@@ -89,6 +92,8 @@ ProcessManager::ProcessManager()
 	
 	// Start gatherer
 	gatherer_thread_handle = thread(ProcessManager::Gather,this);
+	
+	progress_timer_thread_handle = thread(ProcessManager::ProgressTimer,this);
 }
 
 ProcessManager::~ProcessManager()
@@ -167,6 +172,12 @@ void *ProcessManager::Gather(ProcessManager *pm)
 	WorkflowInstance *workflow_instance;
 	DOMElement task;
 	
+	// Progress updates are coalesced per task and applied at most once per interval
+	map<pid_t,int> pending_progress;
+	chrono::milliseconds progress_interval(ConfigurationEvQueue::GetInstance()->GetInt("processmanager.progress.interval"));
+	chrono::steady_clock::time_point last_progress_flush;
+	bool progress_timer_armed = false;
+	
 	DB::StartThread();
 	
 	Logger::Log(LOG_NOTICE,"Gatherer started");
@@ -182,6 +193,15 @@ void *ProcessManager::Gather(ProcessManager *pm)
 				break;
 		}
 		
+		if(msgbuf.type==4)
+		{
+			// Progress timer expired
+			progress_timer_armed = false;
+			flush_progress(pending_progress);
+			last_progress_flush = chrono::steady_clock::now();
+			continue;
+		}
+		
 		pid = msgbuf.mtext.pid;
 		tid = msgbuf.mtext.tid;
 		retcode = msgbuf.mtext.retcode;
@@ -203,21 +223,36 @@ void *ProcessManager::Gather(ProcessManager *pm)
 		
 		if(msgbuf.type==3)
 		{
-			if(!QueuePool::GetInstance()->GetTask(tid,&workflow_instance,&task))
-				continue;
+			pending_progress[tid] = msgbuf.mtext.retcode; // Keep only the latest value
 			
-			workflow_instance->TaskUpdateProgression(task,msgbuf.mtext.retcode);
+			if(chrono::steady_clock::now()-last_progress_flush>=progress_interval)
+			{
+				flush_progress(pending_progress);
+				last_progress_flush = chrono::steady_clock::now();
+			}
+			else if(!progress_timer_armed)
+			{
+				// msgrcv() has no timeout, the timer thread will post a message when updates are due
+				pm->arm_progress_timer(last_progress_flush+progress_interval);
+				progress_timer_armed = true;
+			}
 			
 			continue; // Not process is terminated, skip waitpid
 		}
 		
 		if(msgbuf.type==1)
 		{
+			// Task is terminated, its final progression is set by TaskStop()
+			pending_progress.erase(tid);
+			
 			// Fetch task output in log files before releasing tid
 			stdout_output =  read_log_file(pid,tid,STDOUT_FILENO);
 			stderr_output =  read_log_file(pid,tid,STDERR_FILENO);
 			log_output =  read_log_file(pid,tid,LOG_FILENO);
 			
+			map<string,string> resources;
+			read_resources_file(tid,resources);
+			
 			// Get task informations
 			if(!QueuePool::GetInstance()->TerminateTask(tid,&workflow_instance,&task))
 			{
@@ -235,9 +270,9 @@ void *ProcessManager::Gather(ProcessManager *pm)
 			}
 			
 			if(stdout_output)
-				workflow_instance->TaskStop(task,retcode,stdout_output,stderr_output,log_output,&workflow_terminated);
+				workflow_instance->TaskStop(task,retcode,stdout_output,stderr_output,log_output,&workflow_terminated,resources);
 			else
-				workflow_instance->TaskStop(task,-1,"[ ProcessManager ] Could not read task log, setting retcode to -1 to block subjobs",stderr_output,log_output,&workflow_terminated);
+				workflow_instance->TaskStop(task,-1,"[ ProcessManager ] Could not read task log, setting retcode to -1 to block subjobs",stderr_output,log_output,&workflow_terminated,resources);
 			
 			if(workflow_terminated)
 				delete workflow_instance;
@@ -264,6 +299,63 @@ void *ProcessManager::Gather(ProcessManager *pm)
 	return 0;
 }
 
+void *ProcessManager::ProgressTimer(ProcessManager *pm)
+{
+	// Block signals
+	sigset_t signal_mask;
+	sigemptyset(&signal_mask);
+	sigaddset(&signal_mask, SIGINT);
+	sigaddset(&signal_mask, SIGTERM);
+	sigaddset(&signal_mask, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &signal_mask, NULL);
+	
+	unique_lock<mutex> llock(pm->progress_timer_lock);
+	
+	while(true)
+	{
+		pm->progress_timer_cond.wait(llock, [pm] { return pm->progress_timer_armed || pm->progress_timer_stop; });
+		if(pm->progress_timer_stop)
+			return 0;
+		
+		pm->progress_timer_cond.wait_until(llock, pm->progress_timer_deadline, [pm] { return pm->progress_timer_stop; });
+		if(pm->progress_timer_stop)
+			return 0;
+		
+		pm->progress_timer_armed = false;
+		
+		st_msgbuf msgbuf;
+		msgbuf.type = 4;
+		memset(&msgbuf.mtext,0,sizeof(st_msgbuf::mtext));
+		msgbuf.mtext.pid = getpid(); // pid 0 is reserved for shutdown
+		msgsnd(pm->msgqid,&msgbuf,sizeof(st_msgbuf::mtext),0);
+	}
+}
+
+void ProcessManager::arm_progress_timer(chrono::steady_clock::time_point deadline)
+{
+	unique_lock<mutex> llock(progress_timer_lock);
+	
+	progress_timer_deadline = deadline;
+	progress_timer_armed = true;
+	progress_timer_cond.notify_one();
+}
+
+void ProcessManager::flush_progress(map<pid_t,int> &pending_progress)
+{
+	WorkflowInstance *workflow_instance;
+	DOMElement task;
+	
+	for(auto it=pending_progress.begin();it!=pending_progress.end();++it)
+	{
+		if(!QueuePool::GetInstance()->GetTask(it->first,&workflow_instance,&task))
+			continue;
+		
+		workflow_instance->TaskUpdateProgression(task,it->second);
+	}
+	
+	pending_progress.clear();
+}
+
 void ProcessManager::Shutdown(void)
 {
 	is_shutting_down = true;
@@ -275,12 +367,17 @@ void ProcessManager::Shutdown(void)
 	msgbuf.type = 1;
 	memset(&msgbuf.mtext,0,sizeof(st_msgbuf::mtext));
 	msgsnd(msgqid,&msgbuf,sizeof(st_msgbuf::mtext),0); // Shutdown gatherer
+	
+	unique_lock<mutex> llock(progress_timer_lock);
+	progress_timer_stop = true;
+	progress_timer_cond.notify_one();
 }
 
 void ProcessManager::WaitForShutdown(void)
 {
 	forker_thread_handle.join();
 	gatherer_thread_handle.join();
+	progress_timer_thread_handle.join();
 }
 
 pid_t ProcessManager::ExecuteTask(
@@ -335,6 +432,20 @@ pid_t ProcessManager::ExecuteTask(
 	monitor_config["monitor.merge_stderr"] = task.GetMergeStderr()?"yes":"no";
 	monitor_config["monitor.task.type"] = task.GetTypeStr();
 	
+	// Resources limits and accounting, only available for local tasks
+	monitor_config["monitor.cgroup.name"] = "";
+	if(ConfigurationEvQueue::GetInstance()->GetBool("processmanager.cgroup.enable") && task.GetHost()=="")
+	{
+		// Queue names may be '.' or '..', the prefix keeps them a single component below the base group
+		if(!Queue::CheckQueueName(task.GetQueue()))
+			throw Exception("WorkflowInstance", "Invalid queue name for cgroup : '"+task.GetQueue()+"'");
+		
+		monitor_config["monitor.cgroup.name"] = "queue_"+task.GetQueue()+"/task_"+to_string(tid);
+	}
+	monitor_config["monitor.cgroup.memory.max"] = task.GetCgroupLimit("memory-max");
+	monitor_config["monitor.cgroup.cpu.max"] = task.GetCgroupLimit("cpu-max");
+	monitor_config["monitor.cgroup.pids.max"] = task.GetCgroupLimit("pids-max");
+	
 	// Serialize all data beforore sending to the monitor
 	string data;
 	data += DataSerializer::Serialize(task_filename);
@@ -454,6 +565,31 @@ char *ProcessManager::read_log_file(pid_t pid,pid_t tid,int log_fileno)
 	return output;
 }
 
+void ProcessManager::read_resources_file(pid_t tid,map<string,string> &resources)
+{
+	string filename = logs_directory+"/"+to_string(tid)+".resources";
+	
+	FILE *f = fopen(filename.c_str(),"r");
+	if(!f)
+		return; // Accounting is not enabled for this task
+	
+	char line[256];
+	while(fgets(line,256,f))
+	{
+		char *sep = strchr(line,'=');
+		if(!sep)
+			continue;
+		
+		*sep = '\0';
+		resources[line] = string(sep+1,strcspn(sep+1,"\n"));
+	}
+	
+	fclose(f);
+	
+	if(logs_delete)
+		unlink(filename.c_str());
+}
+
 string ProcessManager::tail_log_file(pid_t tid,int log_fileno)
 {
 	string log_filename;
@@ -0,0 +1,82 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+#include <Process/ProgressThrottle.h>
+#include <Process/tools_ipc.h>
+
+#include <syslog.h>
+
+using namespace std;
+
+ProgressThrottle::ProgressThrottle(int msgqid, pid_t tid, int interval_ms):
+	interval(interval_ms)
+{
+	this->msgqid = msgqid;
+	this->tid = tid;
+}
+
+bool ProgressThrottle::Handle(const char *line)
+{
+	int prct = ipc_parse_progress(line);
+	if(prct<0)
+		return false; // Not a progress line
+	
+	if(pending==-1 && prct==last_sent)
+		return true; // Nothing new
+	
+	if(chrono::steady_clock::now()-last_send_time>=interval)
+		send(prct);
+	else
+		pending = prct; // Too early, keep only the latest value
+	
+	return true;
+}
+
+int ProgressThrottle::GetTimeout() const
+{
+	if(pending==-1)
+		return -1;
+	
+	auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now()-last_send_time);
+	if(elapsed>=interval)
+		return 0;
+	
+	return (interval-elapsed).count();
+}
+
+void ProgressThrottle::Flush()
+{
+	if(pending==-1)
+		return;
+	
+	if(pending!=last_sent)
+		send(pending);
+	
+	pending = -1;
+}
+
+void ProgressThrottle::send(int prct)
+{
+	if(ipc_send_progress(msgqid,tid,prct)!=0)
+		syslog(LOG_WARNING, "evq_monitor: failed to send progress notification");
+	
+	last_sent = prct;
+	last_send_time = chrono::steady_clock::now();
+	pending = -1;
+}
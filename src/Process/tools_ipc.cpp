@@ -113,10 +113,10 @@ int ipc_send_exit_msg(const char *qid_str,int type,int tid,char retcode)
 	return msgsnd(msgqid,&msgbuf,sizeof(st_msgbuf::mtext),0);
 }
 
-bool ipc_send_progress_message(int msgqid,const char* buf,pid_t tid)
+int ipc_parse_progress(const char *buf)
 {
 	if(buf[0]!='%' || buf[1]=='%')
-		return  false;
+		return -1;
 	
 	int prct = atoi(buf+1);
 	if(prct<0)
@@ -124,13 +124,17 @@ bool ipc_send_progress_message(int msgqid,const char* buf,pid_t tid)
 	else if(prct>100)
 		prct = 100;
 	
+	return prct;
+}
+
+int ipc_send_progress(int msgqid,pid_t tid,int prct)
+{
 	st_msgbuf msgbuf_progress;
 	msgbuf_progress.type = 3;
+	memset(&msgbuf_progress.mtext,0,sizeof(st_msgbuf::mtext));
 	msgbuf_progress.mtext.pid = getpid();
 	msgbuf_progress.mtext.tid = tid;
 	msgbuf_progress.mtext.retcode = prct;
 	
-	msgsnd(msgqid,&msgbuf_progress,sizeof(st_msgbuf::mtext),0);
-	
-	return  true;
+	return msgsnd(msgqid,&msgbuf_progress,sizeof(st_msgbuf::mtext),0);
 }
@@ -30,11 +30,15 @@
 #include <DOM/DOMDocument.h>
 #include <WS/Events.h>
 #include <API/QueryHandlers.h>
+#include <Configuration/ConfigurationEvQueue.h>
 
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
 
+#include <chrono>
+#include <vector>
+
 static auto init = QueryHandlers::GetInstance()->RegisterInit([](QueryHandlers *qh) {
 	qh->RegisterHandler("queue",Queue::HandleQuery);
 	Events::GetInstance()->RegisterEvents({"QUEUE_CREATED","QUEUE_MODIFIED","QUEUE_REMOVED"});
@@ -59,6 +63,10 @@ Queue::Queue(unsigned int id,const string &name, int concurrency, int scheduler,
 	running_tasks = 0;
 	
 	removed = false;
+	
+	ConfigurationEvQueue *config = ConfigurationEvQueue::GetInstance();
+	weighted_horizon = 1000LL*config->GetInt("queuepool.weighted.horizon");
+	weighted_priority_step = 1000LL*config->GetInt("queuepool.weighted.priority_step");
 }
 
 Queue::~Queue()
@@ -73,6 +81,11 @@ Queue::~Queue()
 		for(auto it=prio_queue.begin();it!=prio_queue.end();it++)
 			delete it->second;
 	}
+	else if(scheduler==QUEUE_SCHEDULER_WEIGHTED)
+	{
+		for(auto it=weighted_queue.begin();it!=weighted_queue.end();it++)
+			delete it->second;
+	}
 }
 
 bool Queue::CheckQueueName(const string &queue_name)
@@ -94,10 +107,23 @@ void Queue::EnqueueTask(WorkflowInstance *workflow_instance,DOMElement task)
 {
 	Task *new_task = new Task(workflow_instance,task);
 	
+	// Weighted scheduler orders tasks on a virtual deadline : waiting tasks age at the same rate so the key never changes
+	// Higher priorities get an earlier virtual deadline, explicit deadlines are honoured if they are earlier
+	int priority;
+	long long deadline;
+	workflow_instance->GetSchedulingHints(task,&priority,&deadline);
+	
+	new_task->enqueue_time = now();
+	new_task->weight_key = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count() + weighted_horizon - priority*weighted_priority_step;
+	if(deadline && deadline<new_task->weight_key)
+		new_task->weight_key = deadline;
+	
 	if(scheduler==QUEUE_SCHEDULER_FIFO)
 		queue.push_back(new_task);
 	else if(scheduler==QUEUE_SCHEDULER_PRIO)
 		prio_queue.insert(std::pair<unsigned int,Task *>(workflow_instance->GetInstanceID(),new_task));
+	else if(scheduler==QUEUE_SCHEDULER_WEIGHTED)
+		weighted_queue.insert(std::pair<long long,Task *>(new_task->weight_key,new_task));
 	
 	size++;
 }
@@ -131,8 +157,20 @@ bool Queue::DequeueTask(WorkflowInstance **p_workflow_instance,DOMElement *p_tas
 			tmp = it->second;
 			prio_queue.erase(it);
 		}
+		else if(scheduler==QUEUE_SCHEDULER_WEIGHTED)
+		{
+			auto it = weighted_queue.begin();
+			tmp = it->second;
+			weighted_queue.erase(it);
+		}
 		
 		size--;
+		
+		unsigned long long wait = now()-tmp->enqueue_time;
+		wait_count++;
+		wait_total += wait;
+		if(wait>wait_max)
+			wait_max = wait;
 	}
 	
 	// Retreive task data
@@ -189,10 +227,54 @@ bool Queue::CancelTasks(unsigned int workflow_instance_id)
 				++it;
 		}
 	}
+	else if(scheduler==QUEUE_SCHEDULER_WEIGHTED)
+	{
+		for(auto it=weighted_queue.begin();it!=weighted_queue.end();)
+		{
+			if(it->second->workflow_instance->GetInstanceID()==workflow_instance_id)
+			{
+				cancelled_tasks.push(it->second);
+				it = weighted_queue.erase(it);
+				
+				size--;
+			}
+			else
+				++it;
+		}
+	}
 	
 	return true;
 }
 
+void Queue::GetWaitStatistics(unsigned long long *count, unsigned long long *avg, unsigned long long *max, unsigned long long *oldest)
+{
+	*count = wait_count;
+	*avg = wait_count?wait_total/wait_count:0;
+	*max = wait_max;
+	
+	// Age of the oldest waiting task, this is what shows starvation
+	long long oldest_time = 0;
+	if(scheduler==QUEUE_SCHEDULER_FIFO)
+	{
+		if(queue.size())
+			oldest_time = queue.front()->enqueue_time;
+	}
+	else if(scheduler==QUEUE_SCHEDULER_PRIO)
+	{
+		for(auto it=prio_queue.begin();it!=prio_queue.end();++it)
+			if(oldest_time==0 || it->second->enqueue_time<oldest_time)
+				oldest_time = it->second->enqueue_time;
+	}
+	else if(scheduler==QUEUE_SCHEDULER_WEIGHTED)
+	{
+		for(auto it=weighted_queue.begin();it!=weighted_queue.end();++it)
+			if(oldest_time==0 || it->second->enqueue_time<oldest_time)
+				oldest_time = it->second->enqueue_time;
+	}
+	
+	*oldest = oldest_time?now()-oldest_time:0;
+}
+
 void Queue::SetConcurrency(unsigned int concurrency)
 {
 	this->concurrency = concurrency;
@@ -212,18 +294,33 @@ void Queue::SetScheduler(unsigned int new_scheduler)
 	
 	Logger::Log(LOG_NOTICE,"[ Queue ] "+name+" : migrating scheduler to "+QueuePool::get_scheduler_from_int(new_scheduler));
 	
-	if(new_scheduler==QUEUE_SCHEDULER_FIFO)
+	// Gather all waiting tasks
+	vector<Task *> tasks;
+	if(scheduler==QUEUE_SCHEDULER_FIFO)
+		tasks.insert(tasks.end(),queue.begin(),queue.end());
+	else if(scheduler==QUEUE_SCHEDULER_PRIO)
 	{
 		for(auto it=prio_queue.begin();it!=prio_queue.end();it++)
-			queue.push_back(it->second);
-		prio_queue.clear();
+			tasks.push_back(it->second);
+	}
+	else if(scheduler==QUEUE_SCHEDULER_WEIGHTED)
+	{
+		for(auto it=weighted_queue.begin();it!=weighted_queue.end();it++)
+			tasks.push_back(it->second);
 	}
 	
-	if(new_scheduler==QUEUE_SCHEDULER_PRIO)
+	queue.clear();
+	prio_queue.clear();
+	weighted_queue.clear();
+	
+	for(size_t i=0;i<tasks.size();i++)
 	{
-		for(auto it=queue.begin();it!=queue.end();it++)
-			prio_queue.insert(std::pair<unsigned int,Task *>((*it)->workflow_instance->GetInstanceID(),(*it)));
-		queue.clear();
+		if(new_scheduler==QUEUE_SCHEDULER_FIFO)
+			queue.push_back(tasks[i]);
+		else if(new_scheduler==QUEUE_SCHEDULER_PRIO)
+			prio_queue.insert(std::pair<unsigned int,Task *>(tasks[i]->workflow_instance->GetInstanceID(),tasks[i]));
+		else if(new_scheduler==QUEUE_SCHEDULER_WEIGHTED)
+			weighted_queue.insert(std::pair<long long,Task *>(tasks[i]->weight_key,tasks[i]));
 	}
 	
 	scheduler = new_scheduler;
@@ -280,8 +377,14 @@ void Queue::create_edit_check(const std::string &name, int concurrency, const st
 	if(concurrency<=0)
 		throw Exception("Queue","Invalid concurrency, must be greater than 0","INVALID_PARAMETER");
 	
-	if(scheduler!="prio" && scheduler!="fifo" && scheduler!="default")
-		throw Exception("Queue","Invalid scheduler name, must be 'prio', 'fifo' or 'default'","INVALID_PARAMETER");
+	if(scheduler!="prio" && scheduler!="fifo" && scheduler!="weighted" && scheduler!="default")
+		throw Exception("Queue","Invalid scheduler name, must be 'prio', 'fifo', 'weighted' or 'default'","INVALID_PARAMETER");
+}
+
+long long Queue::now()
+{
+	// Monotonic, wait times must not be affected by wall clock changes
+	return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 bool Queue::HandleQuery(const User &user, XMLQuery *query, QueryResponse *response)
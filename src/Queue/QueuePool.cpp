@@ -393,6 +393,13 @@ void QueuePool::SendStatistics(QueryResponse *response)
 		queue_node.setAttribute("running_tasks",to_string(it->second->GetRunningTasks()));
 		queue_node.setAttribute("scheduler",get_scheduler_from_int(it->second->GetScheduler()));
 		
+		unsigned long long wait_count, wait_avg, wait_max, wait_oldest;
+		it->second->GetWaitStatistics(&wait_count,&wait_avg,&wait_max,&wait_oldest);
+		queue_node.setAttribute("dequeued_tasks",to_string(wait_count));
+		queue_node.setAttribute("wait_avg",to_string(wait_avg));
+		queue_node.setAttribute("wait_max",to_string(wait_max));
+		queue_node.setAttribute("wait_oldest",to_string(wait_oldest));
+		
 		statistics_node.appendChild(queue_node);
 	}
 }
@@ -495,8 +502,10 @@ int QueuePool::get_scheduler_from_string(std::string scheduler_str)
 		return QUEUE_SCHEDULER_FIFO;
 	else if(scheduler_str=="prio")
 		return QUEUE_SCHEDULER_PRIO;
+	else if(scheduler_str=="weighted")
+		return QUEUE_SCHEDULER_WEIGHTED;
 	else
-		throw Exception("QueuePool","Invalid scheduler name, allowed values are 'fifo' or 'prio'");
+		throw Exception("QueuePool","Invalid scheduler name, allowed values are 'fifo', 'prio' or 'weighted'");
 }
 
 std::string QueuePool::get_scheduler_from_int(int scheduler)
@@ -505,6 +514,8 @@ std::string QueuePool::get_scheduler_from_int(int scheduler)
 		return "fifo";
 	else if(scheduler==QUEUE_SCHEDULER_PRIO)
 		return "prio";
+	else if(scheduler==QUEUE_SCHEDULER_WEIGHTED)
+		return "weighted";
 	else
 		return "";
 }
@@ -33,9 +33,25 @@ void ConsumerThread::main(ConsumerThread *consumer, ProducerThread *producer)
 	
 	unique_lock<mutex> llock(producer->lock);
 	
+	auto is_ready = [consumer, producer] { return (producer->data_available() || consumer->is_shutting_down); };
+	
 	while(true)
 	{
-		producer->cond.wait(llock, [consumer, producer] { return (producer->data_available() || consumer->is_shutting_down); });
+		if(consumer->idle_timeout>0)
+		{
+			if(!producer->cond.wait_for(llock, chrono::seconds(consumer->idle_timeout), is_ready))
+			{
+				llock.unlock();
+				
+				consumer->idle();
+				
+				llock.lock();
+				
+				continue;
+			}
+		}
+		else
+			producer->cond.wait(llock, is_ready);
 		
 		if(consumer->is_shutting_down)
 		{
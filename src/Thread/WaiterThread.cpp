@@ -33,21 +33,33 @@ bool WaiterThread::wait(int seconds)
 		unique_lock<mutex> llock(wait_lock);
 			
 		cv_status ret;
-		if(!is_shutting_down)
+		if(!is_shutting_down && !is_woken_up)
 			ret = shutdown_requested.wait_for(llock, chrono::seconds(seconds));
 		
+		bool woken_up = is_woken_up;
+		is_woken_up = false;
+		
 		llock.unlock();
 		
 		if(is_shutting_down)
 			return false;
 		
-		if(ret==cv_status::timeout)
+		if(woken_up || ret==cv_status::timeout)
 			return true;
 		
 		// Suprious interrupt, continue waiting
 	}
 }
 
+void WaiterThread::wakeup()
+{
+	// Interrupt current wait, or next one if thread is busy
+	wait_lock.lock();
+	is_woken_up = true;
+	shutdown_requested.notify_one();
+	wait_lock.unlock();
+}
+
 void WaiterThread::thread_main(WaiterThread *ptr)
 {
 	ptr->main();
@@ -240,6 +240,10 @@ int WSServer::callback_evq(struct lws *wsi, enum lws_callback_reasons reason, vo
 				// Message has been received
 				string input_xml((char *)in,len);
 				
+				// Do not buffer large messages from clients that are not authenticated
+				if(context->session->GetStatus()==APISession::en_status::WAITING_CHALLENGE_RESPONSE && context->cmd_buffer->length()+len>XMLMESSAGE_JSON_MAXSIZE_UNAUTHENTICATED)
+					throw Exception("Websocket","Challenge response is too big");
+				
 				// Handle multi packets messages
 				if(lws_remaining_packet_payload(wsi)>0)
 				{
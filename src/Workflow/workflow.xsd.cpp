@@ -37,6 +37,8 @@ std::string workflow_xsd_str = "<?xml version=\"1.0\" encoding=\"UTF-8\"?> \
 			<xs:element name=\"subjobs\" type=\"subjobsType\" /> \
 		</xs:sequence> \
 		<xs:attribute name=\"version\" type=\"xs:string\" use=\"optional\" /> \
+		<xs:attribute name=\"priority\" type=\"xs:integer\" use=\"optional\" /> \
+		<xs:attribute name=\"deadline\" type=\"xs:positiveInteger\" use=\"optional\" /> \
 	</xs:complexType> \
 	 \
 	 \
@@ -112,10 +114,15 @@ std::string workflow_xsd_str = "<?xml version=\"1.0\" encoding=\"UTF-8\"?> \
 		<xs:attribute name=\"output-method\" type=\"xs:string\" use=\"optional\" /> \
 		<xs:attribute name=\"merge-stderr\" type=\"xs:string\" use=\"optional\" /> \
 		<xs:attribute name=\"use-agent\" type=\"xs:string\" use=\"optional\" /> \
+		<xs:attribute name=\"cgroup-memory-max\" type=\"xs:string\" use=\"optional\" /> \
+		<xs:attribute name=\"cgroup-cpu-max\" type=\"xs:string\" use=\"optional\" /> \
+		<xs:attribute name=\"cgroup-pids-max\" type=\"xs:string\" use=\"optional\" /> \
 		<xs:attribute name=\"queue\" type=\"xs:string\" use=\"required\" /> \
 		<xs:attribute name=\"user\" type=\"xs:string\" use=\"optional\" /> \
 		<xs:attribute name=\"host\" type=\"xs:string\" use=\"optional\" /> \
 		<xs:attribute name=\"queue_host\" type=\"xs:string\" use=\"optional\" /> \
+		<xs:attribute name=\"priority\" type=\"xs:integer\" use=\"optional\" /> \
+		<xs:attribute name=\"deadline\" type=\"xs:positiveInteger\" use=\"optional\" /> \
 		<xs:attribute name=\"retry_retval\" type=\"xs:integer\" use=\"optional\" /> \
 		<xs:attribute name=\"retry_delay\" type=\"xs:positiveInteger\" use=\"optional\" /> \
 		<xs:attribute name=\"retry_times\" type=\"xs:positiveInteger\" use=\"optional\" /> \
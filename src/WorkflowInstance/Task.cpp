@@ -164,6 +164,21 @@ string Task::GetHost() const
 	return host;
 }
 
+string Task::GetQueue() const
+{
+	return task_node.getAttribute("queue");
+}
+
+string Task::GetCgroupLimit(const string &name) const
+{
+	// Task limit overrides default configuration
+	if(task_node.hasAttribute("cgroup-"+name))
+		return task_node.getAttribute("cgroup-"+name);
+	
+	string config_name = name;
+	config_name[config_name.find('-')] = '.';
+	return ConfigurationEvQueue::GetInstance()->Get("processmanager.cgroup."+config_name);
+}
 
 string Task::GetTypeStr() const
 {
@@ -98,7 +98,8 @@ WorkflowInstance::WorkflowInstance(const string &workflow_name,WorkflowParameter
 
 	// Load workflow XML
 	xmldoc = DOMDocument::Parse(workflow.GetXML());
-	xmldoc->getXPath()->RegisterFunction("evqGetWorkflowParameter",{WorkflowXPathFunctions::evqGetWorkflowParameter,0});
+	xmldoc->getXPath()->SetCustomContext(&xpath_context);
+	register_indexes();
 	
 	// Set workflow name for front-office display
 	xmldoc->getDocumentElement().setAttribute("name",workflow_name);
@@ -190,8 +191,9 @@ WorkflowInstance::WorkflowInstance(const string &workflow_name,WorkflowParameter
 
 	if(savepoint_level>=2)
 	{
-		// Insert workflow instance in DB
+		// Insert workflow instance in DB, along with its parameters
 		string node_name = ConfigurationEvQueue::GetInstance()->Get("cluster.node.name");
+		db.StartTransaction();
 		db.QueryPrintf(
 			"INSERT INTO t_workflow_instance(node_name,workflow_id,workflow_schedule_id,workflow_instance_host,workflow_instance_status,workflow_instance_start,workflow_instance_comment, workflow_instance_savepoint, workflow_instance_errors) VALUES(%s,%i,%i,%s,'EXECUTING',NOW(),%s,'',0)",
 			{&node_name, &workflow_id, workflow_schedule_id?&workflow_schedule_id:0, &workflow_host, &workflow_comment});
@@ -200,10 +202,20 @@ WorkflowInstance::WorkflowInstance(const string &workflow_name,WorkflowParameter
 		// Save workflow parameters
 		if(saveparameters)
 		{
+			db.BulkStart(WORKFLOWINSTANCE_BULK_PARAMETERS,"t_workflow_instance_parameters","workflow_instance_id,workflow_instance_parameter,workflow_instance_parameter_value",3);
+			
 			parameters->SeekStart();
 			while(parameters->Get(parameter_name,parameter_value))
-				db.QueryPrintf("INSERT INTO t_workflow_instance_parameters VALUES(%i,%s,%s)",{&this->workflow_instance_id,&parameter_name,&parameter_value});
+			{
+				db.BulkDataInt(WORKFLOWINSTANCE_BULK_PARAMETERS,workflow_instance_id);
+				db.BulkDataString(WORKFLOWINSTANCE_BULK_PARAMETERS,parameter_name);
+				db.BulkDataString(WORKFLOWINSTANCE_BULK_PARAMETERS,parameter_value);
+			}
+			
+			db.BulkExec(WORKFLOWINSTANCE_BULK_PARAMETERS);
 		}
+		
+		db.CommitTransaction();
 	}
 	else
 	{
@@ -243,7 +255,8 @@ WorkflowInstance::WorkflowInstance(unsigned int workflow_instance_id):
 
 	// Load workflow XML
 	xmldoc = DOMDocument::Parse(db.GetField(0));
-	xmldoc->getXPath()->RegisterFunction("evqGetWorkflowParameter",{WorkflowXPathFunctions::evqGetWorkflowParameter,xmldoc->getXPath()});
+	xmldoc->getXPath()->SetCustomContext(&xpath_context);
+	register_indexes();
 	
 	// Upate XML ID (useful after workflows cloning)
 	this->xmldoc->getDocumentElement().setAttribute("id",to_string(workflow_instance_id)); 
@@ -375,6 +388,18 @@ void WorkflowInstance::update_job_statistics(const string &name,int delta,DOMEle
 		update_job_statistics(name,delta,job.getParentNode().getParentNode());
 }
 
+void WorkflowInstance::register_indexes()
+{
+	// Attributes used by engine lookups (task status changes, KillTask, XPath functions)
+	xmldoc->RegisterIndex("task","status");
+	xmldoc->RegisterIndex("task","pid");
+	xmldoc->RegisterIndex("task","tid");
+	xmldoc->RegisterIndex("task","path");
+	xmldoc->RegisterIndex("job","name");
+	xmldoc->RegisterIndex("parameter","name");
+	xmldoc->RegisterIndex("schedule","name");
+}
+
 void WorkflowInstance::clear_statistics()
 {
 	// Clear statistics
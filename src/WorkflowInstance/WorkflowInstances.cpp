@@ -320,16 +320,24 @@ bool WorkflowInstances::HandleQuery(const User &user, XMLQuery *query, QueryResp
 		unsigned int filter_schedule_id = query->GetRootAttributeInt("filter_schedule_id",0);
 		unsigned int limit = query->GetRootAttributeInt("limit",30);
 		unsigned int offset = query->GetRootAttributeInt("offset",0);
+		string cursor = query->GetRootAttribute("cursor","");
+		string count = query->GetRootAttribute("count","exact");
 		string groupby = query->GetRootAttribute("groupby","");
 		
+		if(count!="none" && count!="approximate" && count!="exact")
+			throw Exception("WorkflowInstances","count must be 'none', 'approximate' or 'exact'","INVALID_PARAMETER");
+		
+		if(cursor!="" && groupby!="")
+			throw Exception("WorkflowInstances","cursor can't be used with groupby","INVALID_PARAMETER");
+		
 		// Build query parts
 		string query_select;
 		string query_groupby;
 		if(groupby=="")
-			query_select = "SELECT SQL_CALC_FOUND_ROWS wi.workflow_instance_id, w.workflow_name, wi.node_name, wi.workflow_instance_host, wi.workflow_instance_start, wi.workflow_instance_end, wi.workflow_instance_errors, wi.workflow_instance_status, wi.workflow_schedule_id, wi.workflow_instance_comment";
+			query_select = "SELECT wi.workflow_instance_id, w.workflow_name, wi.node_name, wi.workflow_instance_host, wi.workflow_instance_start, wi.workflow_instance_end, wi.workflow_instance_errors, wi.workflow_instance_status, wi.workflow_schedule_id, wi.workflow_instance_comment";
 		else
 		{
-			query_select = "SELECT SQL_CALC_FOUND_ROWS w.workflow_name, wi.node_name, COUNT(*) AS n";
+			query_select = "SELECT w.workflow_name, wi.node_name, COUNT(*) AS n";
 			query_groupby = "GROUP BY w.workflow_name, wi.node_name";
 			
 			if(groupby=="hour")
@@ -499,9 +507,62 @@ bool WorkflowInstances::HandleQuery(const User &user, XMLQuery *query, QueryResp
 			}
 		}
 		
+		DB db;
+		
+		// Total count is exact by default, clients can opt for no count or an approximate one that stops after WORKFLOWINSTANCES_COUNT_LIMIT rows
+		// It is not restricted to current page, so compute it before cursor conditions are added
+		if(count!="none")
+		{
+			string query_count = "SELECT 1 "+query_from+" "+query_where+" "+query_groupby;
+			if(count=="approximate")
+				query_count += " LIMIT "+to_string(WORKFLOWINSTANCES_COUNT_LIMIT);
+			
+			db.QueryPrintf("SELECT COUNT(*) FROM ("+query_count+") c",query_where_values);
+			db.FetchRow();
+			response->SetAttribute("rows",db.GetField(0));
+			
+			if(count=="approximate" && db.GetFieldInt(0)>=WORKFLOWINSTANCES_COUNT_LIMIT)
+				response->SetAttribute("rows_approximate","yes");
+		}
+		
+		// Keyset pagination : cursor is the end time and ID of the last instance of previous page
+		// workflow_instance_id is the clustered key, so workflow_instance_date_end is already ordered on (end, id)
+		string query_where_page = query_where;
+		string cursor_end;
+		unsigned int cursor_id = 0;
+		if(cursor!="")
+		{
+			size_t sep = cursor.rfind(',');
+			try
+			{
+				if(sep==string::npos)
+					throw 0;
+				
+				cursor_end = cursor.substr(0,sep);
+				cursor_id = stoi(cursor.substr(sep+1));
+			}
+			catch(...)
+			{
+				throw Exception("WorkflowInstances","Invalid cursor","INVALID_PARAMETER");
+			}
+			
+			// NULL end times are sorted last
+			if(cursor_end=="")
+				query_where_page += " AND wi.workflow_instance_end IS NULL AND wi.workflow_instance_id<%i";
+			else
+			{
+				query_where_page += " AND (wi.workflow_instance_end<%s OR (wi.workflow_instance_end=%s AND wi.workflow_instance_id<%i) OR wi.workflow_instance_end IS NULL)";
+				query_where_values.push_back(&cursor_end);
+				query_where_values.push_back(&cursor_end);
+			}
+			query_where_values.push_back(&cursor_id);
+			
+			offset = 0;
+		}
+		
 		string query_order_by;
 		if(groupby=="")
-			query_order_by = "ORDER BY wi.workflow_instance_end DESC";
+			query_order_by = "ORDER BY wi.workflow_instance_end DESC, wi.workflow_instance_id DESC";
 		else
 		{
 			if(groupby=="hour")
@@ -514,103 +575,102 @@ bool WorkflowInstances::HandleQuery(const User &user, XMLQuery *query, QueryResp
 				query_order_by = "ORDER BY year DESC";
 		}
 		
+		// Rows are streamed, so the next cursor must be known before : it is the key of the last row of a full page
+		if(groupby=="" && limit>0)
+		{
+			db.QueryPrintf("SELECT wi.workflow_instance_end, wi.workflow_instance_id "+query_from+" "+query_where_page+" "+query_order_by+" LIMIT "+to_string(offset+limit-1)+",1",query_where_values);
+			if(db.FetchRow())
+				response->SetAttribute("next_cursor",db.GetField(0)+","+db.GetField(1)); // end_time is empty for NULL values
+		}
+		
 		string query_limit = "LIMIT "+to_string(offset)+","+to_string(limit);
 		
-		string query = query_select+" "+query_from+" "+query_where+" "+query_groupby+" "+query_order_by+" "+query_limit;
+		string query = query_select+" "+query_from+" "+query_where_page+" "+query_groupby+" "+query_order_by+" "+query_limit;
+		
+		// Instances tags are joined to the page, tags of an instance are on consecutive rows
+		if(groupby=="")
+			query = "SELECT p.*, t.tag_id, t.tag_label FROM ("+query+") p LEFT JOIN t_workflow_instance_tag wit ON wit.workflow_instance_id=p.workflow_instance_id LEFT JOIN t_tag t ON t.tag_id=wit.tag_id ORDER BY p.workflow_instance_end DESC, p.workflow_instance_id DESC";
 		
-		DB db;
 		db.QueryPrintf(query,query_where_values);
-		map<unsigned int,DOMNode> instance_id_tags_node;
+		
+		QueryResponseWriter *writer = response->Stream();
+		unsigned int current_id = 0;
 		while(db.FetchRow())
 		{
-			DOMElement node = (DOMElement)response->AppendXML("<workflow />");
-			
 			if(groupby=="")
 			{
-				node.setAttribute("id",to_string(db.GetFieldInt(0)));
-				node.setAttribute("name",db.GetField(1));
-				node.setAttribute("node_name",db.GetField(2));
-				if(!db.GetFieldIsNULL(3))
-					node.setAttribute("host",db.GetField(3));
-				node.setAttribute("start_time",db.GetField(4));
-				node.setAttribute("end_time",db.GetField(5));
-				node.setAttribute("errors",db.GetField(6));
-				node.setAttribute("status",db.GetField(7));
-				if(!db.GetFieldIsNULL(8))
-					node.setAttribute("schedule_id",db.GetField(8));
-				node.setAttribute("comment",db.GetField(9));
+				unsigned int id = db.GetFieldInt(0);
+				if(id!=current_id)
+				{
+					if(current_id!=0)
+					{
+						writer->EndElement(); // tags
+						writer->EndElement(); // workflow
+					}
+					
+					current_id = id;
+					
+					writer->StartElement("workflow");
+					writer->SetAttribute("id",to_string(id));
+					writer->SetAttribute("name",db.GetField(1));
+					writer->SetAttribute("node_name",db.GetField(2));
+					if(!db.GetFieldIsNULL(3))
+						writer->SetAttribute("host",db.GetField(3));
+					writer->SetAttribute("start_time",db.GetField(4));
+					writer->SetAttribute("end_time",db.GetField(5));
+					writer->SetAttribute("errors",db.GetField(6));
+					writer->SetAttribute("status",db.GetField(7));
+					if(!db.GetFieldIsNULL(8))
+						writer->SetAttribute("schedule_id",db.GetField(8));
+					writer->SetAttribute("comment",db.GetField(9));
+					
+					writer->StartElement("tags");
+				}
 				
-				DOMNode tags_node = response->GetDOM()->createElement("tags");
-				node.appendChild(tags_node);
-				instance_id_tags_node.insert(pair<unsigned int,DOMNode>(db.GetFieldInt(0),tags_node));
+				if(!db.GetFieldIsNULL(10))
+				{
+					writer->StartElement("tag");
+					writer->SetAttribute("id",db.GetField(10));
+					writer->SetAttribute("label",db.GetField(11));
+					writer->EndElement();
+				}
 			}
 			else
 			{
-				node.setAttribute("name",db.GetField(0));
-				node.setAttribute("node_name",db.GetField(1));
-				node.setAttribute("count",to_string(db.GetFieldInt(2)));
+				writer->StartElement("workflow");
+				writer->SetAttribute("name",db.GetField(0));
+				writer->SetAttribute("node_name",db.GetField(1));
+				writer->SetAttribute("count",to_string(db.GetFieldInt(2)));
 				if(groupby=="hour")
 				{
-					node.setAttribute("hour",to_string(db.GetFieldInt(3)));
-					node.setAttribute("day",to_string(db.GetFieldInt(4)));
-					node.setAttribute("month",to_string(db.GetFieldInt(5)));
-					node.setAttribute("year",to_string(db.GetFieldInt(6)));
+					writer->SetAttribute("hour",to_string(db.GetFieldInt(3)));
+					writer->SetAttribute("day",to_string(db.GetFieldInt(4)));
+					writer->SetAttribute("month",to_string(db.GetFieldInt(5)));
+					writer->SetAttribute("year",to_string(db.GetFieldInt(6)));
 				}
 				if(groupby=="day")
 				{
-					node.setAttribute("day",to_string(db.GetFieldInt(3)));
-					node.setAttribute("month",to_string(db.GetFieldInt(4)));
-					node.setAttribute("year",to_string(db.GetFieldInt(5)));
+					writer->SetAttribute("day",to_string(db.GetFieldInt(3)));
+					writer->SetAttribute("month",to_string(db.GetFieldInt(4)));
+					writer->SetAttribute("year",to_string(db.GetFieldInt(5)));
 				}
 				if(groupby=="month")
 				{
-					node.setAttribute("month",to_string(db.GetFieldInt(3)));
-					node.setAttribute("year",to_string(db.GetFieldInt(4)));
+					writer->SetAttribute("month",to_string(db.GetFieldInt(3)));
+					writer->SetAttribute("year",to_string(db.GetFieldInt(4)));
 				}
 				if(groupby=="year")
-					node.setAttribute("year",to_string(db.GetFieldInt(3)));
+					writer->SetAttribute("year",to_string(db.GetFieldInt(3)));
+				writer->EndElement();
 			}
 		}
 		
-		db.Query("SELECT FOUND_ROWS()");
-		db.FetchRow();
-		response->GetDOM()->getDocumentElement().setAttribute("rows",db.GetField(0));
-		
-		// Fetch instances associated tags
-		string query_in="";
-		int i=0;
-		for(auto it = instance_id_tags_node.begin(); it!=instance_id_tags_node.end(); ++it)
-		{
-			if(i==0)
-				query_in += "IN(";
-			else if(i>0)
-				query_in += ", ";
-			
-			query_in += to_string(it->first);
-			
-			i++;
-		}
-		
-		if(i>0)
-			query_in += ")";
-		
-		if(i>0)
+		if(current_id!=0)
 		{
-			db.Query("SELECT wit.workflow_instance_id, t.tag_id, t.tag_label FROM t_workflow_instance_tag wit, t_tag t WHERE t.tag_id=wit.tag_id AND wit.workflow_instance_id "+query_in);
-			while(db.FetchRow())
-			{
-				auto it = instance_id_tags_node.find(db.GetFieldInt(0));
-				if(it==instance_id_tags_node.end())
-					continue; // Should not happend
-				
-				DOMElement tag_node = response->GetDOM()->createElement("tag");
-				tag_node.setAttribute("id",db.GetField(1));
-				tag_node.setAttribute("label",db.GetField(2));
-				it->second.appendChild(tag_node);
-			}
+			writer->EndElement(); // tags
+			writer->EndElement(); // workflow
 		}
 		
-		
 		return true;
 	}
 	
@@ -18,7 +18,6 @@
  */
 
 #include <WorkflowInstance/WorkflowInstance.h>
-#include <WorkflowInstance/WorkflowInstanceAPI.h>
 #include <Exception/Exception.h>
 #include <WorkflowInstance/ExceptionWorkflowContext.h>
 #include <XPath/WorkflowXPathFunctions.h>
@@ -31,16 +30,17 @@
 #include <unistd.h>
 
 #include <memory>
+#include <set>
 
 using namespace std;
 
-void WorkflowInstance::fill_automatic_tags()
+// Rows are only queued on db, caller is responsible for executing the bulk query
+// Returns the number of tags applied to the instance
+int WorkflowInstance::fill_automatic_tags(DB *db)
 {
-	DB db;
+	db->BulkStart(WORKFLOWINSTANCE_BULK_TAGS,"t_workflow_instance_tag","workflow_instance_id,tag_id",2);
 	
-	
-	DOMElement root = xmldoc->getDocumentElement();
-	xmldoc->getXPath()->RegisterFunction("evqGetJob",{WorkflowXPathFunctions::evqGetJob,&root});
+	set<unsigned int> tag_ids;
 	
 	try
 	{
@@ -49,16 +49,36 @@ void WorkflowInstance::fill_automatic_tags()
 		while(filters->snapshotItem(filters_index++))
 		{
 			DOMElement filter = (DOMElement)filters->getNodeValue();
-
-			// This is unchecked user input. We have to try evaluation
 			string name = filter.getAttribute("name");
-			string condition = filter.getAttribute("condition");
-			unique_ptr<DOMXPathResult> test_expr(xmldoc->evaluate(condition,xmldoc->getDocumentElement(),DOMXPathResult::BOOLEAN_TYPE));
 			
-			if(test_expr->getBooleanValue())
+			// One faulty tag must not prevent the others from being applied
+			try
 			{
-				unsigned int tag_id = Tag::Create(name);
-				WorkflowInstanceAPI::Tag(workflow_instance_id, tag_id);
+				// This is unchecked user input. We have to try evaluation
+				string condition = filter.getAttribute("condition");
+				unique_ptr<DOMXPathResult> test_expr(xmldoc->evaluate(condition,xmldoc->getDocumentElement(),DOMXPathResult::BOOLEAN_TYPE));
+				
+				if(!test_expr->getBooleanValue())
+					continue;
+				
+				// Tags are usually known, only create missing ones (Create() returns the existing ID if the tag is not loaded yet)
+				Tag tag;
+				unsigned int tag_id;
+				if(Tags::GetInstance()->Get(name,&tag))
+					tag_id = tag.GetID();
+				else
+					tag_id = Tag::Create(name);
+				
+				// Several automatic tags can share the same label
+				if(!tag_ids.insert(tag_id).second)
+					continue;
+				
+				db->BulkDataInt(WORKFLOWINSTANCE_BULK_TAGS,workflow_instance_id);
+				db->BulkDataInt(WORKFLOWINSTANCE_BULK_TAGS,tag_id);
+			}
+			catch(Exception &e)
+			{
+				Logger::Log(LOG_WARNING,"[WID "+to_string(workflow_instance_id)+"] Could not process automatic tag '"+name+"' : "+e.error);
 			}
 		}
 	}
@@ -66,4 +86,6 @@ void WorkflowInstance::fill_automatic_tags()
 	{
 		Logger::Log(LOG_WARNING,"[WID "+to_string(workflow_instance_id)+"] Could not process automatic tagging : "+e.error);
 	}
+	
+	return tag_ids.size();
 }
@@ -33,8 +33,7 @@ bool WorkflowInstance::handle_condition(DOMElement node,DOMElement context_node,
 
 	ExceptionWorkflowContext ctx(node,"Error evaluating condition");
 	
-	bool needs_wait = false;
-	xmldoc->getXPath()->RegisterFunction("evqWait",{WorkflowXPathFunctions::evqWait,&needs_wait});
+	xpath_context.needs_wait = false;
 	
 	try
 	{
@@ -54,7 +53,7 @@ bool WorkflowInstance::handle_condition(DOMElement node,DOMElement context_node,
 	}
 	catch(Exception &e)
 	{
-		if(needs_wait)
+		if(xpath_context.needs_wait)
 		{
 			if(!can_wait)
 				throw;
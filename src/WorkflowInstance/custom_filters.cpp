@@ -30,13 +30,10 @@
 
 using namespace std;
 
-void WorkflowInstance::fill_custom_filters()
+// Rows are only queued on db, caller is responsible for executing the bulk query
+void WorkflowInstance::fill_custom_filters(DB *db)
 {
-	DB db;
-	
-	
-	DOMElement root = xmldoc->getDocumentElement();
-	xmldoc->getXPath()->RegisterFunction("evqGetJob",{WorkflowXPathFunctions::evqGetJob,&root});
+	db->BulkStart(WORKFLOWINSTANCE_BULK_FILTERS,"t_workflow_instance_filters","workflow_instance_id,workflow_instance_filter,workflow_instance_filter_value",3);
 	
 	try
 	{
@@ -57,10 +54,9 @@ void WorkflowInstance::fill_custom_filters()
 				DOMElement value_node = (DOMElement)value_nodes->getNodeValue();
 				string value = value_node.getTextContent();
 				
-				db.QueryPrintf(
-					"INSERT INTO t_workflow_instance_filters(workflow_instance_id,workflow_instance_filter,workflow_instance_filter_value) VALUES(%i,%s,%s)",
-					{&workflow_instance_id,&name,&value}
-				);
+				db->BulkDataInt(WORKFLOWINSTANCE_BULK_FILTERS,workflow_instance_id);
+				db->BulkDataString(WORKFLOWINSTANCE_BULK_FILTERS,name);
+				db->BulkDataString(WORKFLOWINSTANCE_BULK_FILTERS,value);
 			}
 		}
 	}
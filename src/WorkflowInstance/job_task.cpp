@@ -28,6 +28,8 @@
 #include <WS/Events.h>
 
 #include <signal.h>
+#include <string.h>
+#include <time.h>
 
 #include <memory>
 
@@ -46,7 +48,7 @@ void WorkflowInstance::TaskRestart(DOMElement task, bool *workflow_terminated)
 	record_savepoint();
 }
 
-bool WorkflowInstance::TaskStop(DOMElement task_node,int retval,const char *stdout_output,const char *stderr_output,const char *log_output,bool *workflow_terminated)
+bool WorkflowInstance::TaskStop(DOMElement task_node,int retval,const char *stdout_output,const char *stderr_output,const char *log_output,bool *workflow_terminated,const map<string,string> &resources)
 {
 	unique_lock<recursive_mutex> llock(lock);
 	
@@ -66,6 +68,10 @@ bool WorkflowInstance::TaskStop(DOMElement task_node,int retval,const char *stdo
 	output_element.setAttribute("retval",to_string(retval));
 	output_element.setAttribute("execution_time",task_node.getAttribute("execution_time"));
 	output_element.setAttribute("exit_time",format_datetime());
+	
+	// Resources accounting (cgroup), if enabled
+	for(auto it=resources.begin();it!=resources.end();++it)
+		output_element.setAttribute(it->first,it->second);
 
 	if(retval==0)
 	{
@@ -267,25 +273,59 @@ void WorkflowInstance::TaskUpdateProgression(DOMElement task, int prct)
 {
 	unique_lock<recursive_mutex> llock(lock);
 	
-	task.setAttribute("progression",to_string(prct));
+	string prct_str = to_string(prct);
+	if(task.getAttribute("progression")==prct_str)
+		return; // Unchanged, do not notify subscribers
+	
+	task.setAttribute("progression",prct_str);
 	
 	Events::GetInstance()->Create("TASK_PROGRESS", workflow_instance_id);
 }
 
+void WorkflowInstance::GetSchedulingHints(DOMElement task, int *priority, long long *deadline)
+{
+	// Called from enqueue path, instance is already locked
+	DOMElement workflow = xmldoc->getDocumentElement();
+	
+	*priority = 0;
+	*deadline = 0;
+	
+	try
+	{
+		// Task priority overrides workflow priority
+		if(task.hasAttribute("priority"))
+			*priority = stoi(task.getAttribute("priority"));
+		else if(workflow.hasAttribute("priority"))
+			*priority = stoi(workflow.getAttribute("priority"));
+		
+		// Task deadline is relative to enqueue time, workflow deadline is relative to instance start
+		if(task.hasAttribute("deadline"))
+			*deadline = 1000LL * (time(0) + stoll(task.getAttribute("deadline")));
+		else if(workflow.hasAttribute("deadline"))
+		{
+			struct tm start_t;
+			memset(&start_t, 0, sizeof(struct tm));
+			if(strptime(workflow.getAttribute("start_time").c_str(), "%Y-%m-%d %H:%M:%S", &start_t))
+			{
+				start_t.tm_isdst = -1;
+				*deadline = 1000LL * (mktime(&start_t) + stoll(workflow.getAttribute("deadline")));
+			}
+		}
+	}
+	catch(...)
+	{
+		Logger::Log(LOG_WARNING,"[WID %d] Invalid priority or deadline on task %s, ignoring",workflow_instance_id,task.getAttribute("name").c_str());
+	}
+}
+
 void WorkflowInstance::register_job_functions(DOMElement node)
 {
 	if(node.getNodeName()=="task")
-		context_job = node.getParentNode().getParentNode();
+		xpath_context.current_job = node.getParentNode().getParentNode();
 	else
-		context_job = node;
-	
-	xmldoc->getXPath()->RegisterFunction("evqGetCurrentJob",{WorkflowXPathFunctions::evqGetCurrentJob,&context_job});
+		xpath_context.current_job = node;
 	
-	context_parent_job = context_job.getParentNode().getParentNode();
-	xmldoc->getXPath()->RegisterFunction("evqGetParentJob",{WorkflowXPathFunctions::evqGetParentJob,&context_parent_job});
-	xmldoc->getXPath()->RegisterFunction("evqGetOutput",{WorkflowXPathFunctions::evqGetOutput,&context_parent_job});
-	xmldoc->getXPath()->RegisterFunction("evqGetInput",{WorkflowXPathFunctions::evqGetInput,&context_parent_job});
-	xmldoc->getXPath()->RegisterFunction("evqGetContext",{WorkflowXPathFunctions::evqGetContext,&context_parent_job});
+	xpath_context.parent_job = xpath_context.current_job.getParentNode().getParentNode();
 }
 
 bool WorkflowInstance::KillTask(pid_t pid)
@@ -371,8 +411,7 @@ bool WorkflowInstance::run_subjob(DOMElement subjob,DOMElement context_node)
 			xmldoc->getNodeEvqID(jobs.at(i));
 		}
 		
-		DOMElement current_job = jobs.at(i);
-		xmldoc->getXPath()->RegisterFunction("evqGetCurrentJob",{WorkflowXPathFunctions::evqGetCurrentJob,&current_job});
+		xpath_context.current_job = jobs.at(i);
 		if(!handle_condition(jobs.at(i),contexts.at(i)))
 					continue;
 		
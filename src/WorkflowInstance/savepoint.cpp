@@ -22,6 +22,7 @@
 #include <WorkflowInstance/ExceptionWorkflowContext.h>
 #include <Logger/Logger.h>
 #include <DB/DB.h>
+#include <WS/Events.h>
 
 #include <unistd.h>
 
@@ -96,8 +97,7 @@ void WorkflowInstance::record_savepoint(bool force)
 						{&savepoint,&error_tasks,&workflow_instance_id}
 					);
 					
-					fill_custom_filters();
-					fill_automatic_tags();
+					record_filters_and_tags(&db);
 				}
 			}
 			else
@@ -128,3 +128,28 @@ void WorkflowInstance::record_savepoint(bool force)
 
 	} while(savepoint_retry && (savepoint_retry_times==0 || tries<=savepoint_retry_times));
 }
+
+void WorkflowInstance::record_filters_and_tags(DB *db)
+{
+	// Custom filters and tags are best effort, a faulty row must not leave the instance EXECUTING in database
+	int ntags = 0;
+	try
+	{
+		fill_custom_filters(db);
+		ntags = fill_automatic_tags(db);
+		
+		db->StartTransaction();
+		db->BulkExec(WORKFLOWINSTANCE_BULK_FILTERS);
+		db->BulkExec(WORKFLOWINSTANCE_BULK_TAGS);
+		db->CommitTransaction();
+	}
+	catch(Exception &e)
+	{
+		// Transaction has been rolled back by DB
+		Logger::Log(LOG_WARNING,"[WID "+to_string(workflow_instance_id)+"] Could not record custom filters and tags : "+e.error);
+		return;
+	}
+	
+	if(ntags>0)
+		Events::GetInstance()->Create("INSTANCE_TAGGED",workflow_instance_id);
+}
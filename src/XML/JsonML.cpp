@@ -0,0 +1,181 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#include <XML/JsonML.h>
+#include <DOM/DOMNamedNodeMap.h>
+#include <Exception/Exception.h>
+
+#include <nlohmann/json.hpp>
+
+#include <stdio.h>
+
+using namespace std;
+using nlohmann::json;
+
+static string json_scalar(const json &j)
+{
+	if(j.is_string())
+		return j.get<string>();
+	else if(j.is_boolean())
+		return j.get<bool>()?"yes":"no";
+	else if(j.is_number() || j.is_null())
+		return j.is_null()?"":j.dump();
+	
+	throw Exception("JsonML","Attribute values must be scalars","INVALID_JSON");
+}
+
+static DOMElement json_element(DOMDocument *xmldoc, const json &j, int depth)
+{
+	if(depth>JSONML_MAX_DEPTH)
+		throw Exception("JsonML","Maximum nesting depth exceeded","INVALID_JSON");
+	
+	if(!j.is_array() || j.size()==0 || !j[0].is_string())
+		throw Exception("JsonML","Elements must be arrays starting with the element name","INVALID_JSON");
+	
+	DOMElement node = xmldoc->createElement(j[0].get<string>());
+	
+	for(int i=1;i<j.size();i++)
+	{
+		const json &child = j[i];
+		
+		if(i==1 && child.is_object())
+		{
+			for(auto it = child.begin(); it!=child.end(); ++it)
+				node.setAttribute(it.key(), json_scalar(it.value()));
+		}
+		else if(child.is_array())
+			node.appendChild(json_element(xmldoc, child, depth+1));
+		else
+			node.appendChild(xmldoc->createTextNode(json_scalar(child)));
+	}
+	
+	return node;
+}
+
+DOMDocument *JsonML::Parse(const string &json_str)
+{
+	json j;
+	try
+	{
+		// Message comes from the client, do not let it build a value too deep to be destroyed recursively
+		j = json::parse(json_str, [](int depth, json::parse_event_t event, json &parsed) {
+			if(depth>=JSONML_MAX_DEPTH && (event==json::parse_event_t::array_start || event==json::parse_event_t::object_start))
+				throw Exception("JsonML","Maximum nesting depth exceeded","INVALID_JSON");
+			return true;
+		});
+	}
+	catch(json::exception &e)
+	{
+		throw Exception("JsonML",string("Invalid JSON : ")+e.what(),"INVALID_JSON");
+	}
+	
+	DOMDocument *xmldoc = new DOMDocument();
+	try
+	{
+		xmldoc->appendChild(json_element(xmldoc, j, 1));
+	}
+	catch(Exception &e)
+	{
+		delete xmldoc;
+		throw e;
+	}
+	
+	return xmldoc;
+}
+
+void JsonML::Serialize(DOMNode node, string &out)
+{
+	if(node.getNodeType()==DOMNode::TEXT_NODE || node.getNodeType()==DOMNode::CDATA_SECTION_NODE)
+	{
+		out += '"';
+		Escape(node.getNodeValue(), out);
+		out += '"';
+		return;
+	}
+	
+	if(node.getNodeType()!=DOMNode::ELEMENT_NODE)
+		return;
+	
+	out += "[\"";
+	Escape(node.getNodeName(), out);
+	out += '"';
+	
+	DOMNamedNodeMap attributes = node.getAttributes();
+	if(attributes.getLength())
+	{
+		out += ",{";
+		for(int i=0;i<attributes.getLength();i++)
+		{
+			DOMNode attribute = attributes.item(i);
+			if(i>0)
+				out += ',';
+			
+			out += '"';
+			Escape(attribute.getNodeName(), out);
+			out += "\":\"";
+			Escape(attribute.getNodeValue(), out);
+			out += '"';
+		}
+		out += '}';
+	}
+	
+	for(DOMNode child = node.getFirstChild(); child; child = child.getNextSibling())
+	{
+		if(child.getNodeType()!=DOMNode::ELEMENT_NODE && child.getNodeType()!=DOMNode::TEXT_NODE && child.getNodeType()!=DOMNode::CDATA_SECTION_NODE)
+			continue;
+		
+		out += ',';
+		Serialize(child, out);
+	}
+	
+	out += ']';
+}
+
+void JsonML::Escape(const string &str, string &out)
+{
+	const char *s = str.c_str();
+	size_t len = str.length();
+	size_t start = 0;
+	
+	for(size_t i=0;i<len;i++)
+	{
+		unsigned char c = s[i];
+		if(c!='"' && c!='\\' && c>=0x20)
+			continue;
+		
+		out.append(s+start, i-start);
+		start = i+1;
+		
+		switch(c)
+		{
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				char buf[8];
+				sprintf(buf, "\\u%04x", c);
+				out += buf;
+		}
+	}
+	
+	out.append(s+start, len-start);
+}
@@ -27,6 +27,32 @@
 
 using namespace std;
 
+WorkflowXPathFunctions::workflow_context *WorkflowXPathFunctions::get_workflow_context(XPathEval::func_context context, const string &function)
+{
+	if(!context.custom_context)
+		throw Exception(function,"Only available in workflow instances");
+	
+	return (workflow_context *)context.custom_context;
+}
+
+DOMNode WorkflowXPathFunctions::get_current_job(XPathEval::func_context context, const string &function)
+{
+	DOMNode node = get_workflow_context(context,function)->current_job;
+	if(!node)
+		throw Exception(function,"No current job in this context");
+	
+	return node;
+}
+
+DOMNode WorkflowXPathFunctions::get_parent_job(XPathEval::func_context context, const string &function)
+{
+	DOMNode node = get_workflow_context(context,function)->parent_job;
+	if(!node)
+		throw Exception(function,"No parent job in this context");
+	
+	return node;
+}
+
 Token *WorkflowXPathFunctions::evqGetWorkflowParameter(XPathEval::func_context context, const vector<Token *> &args)
 {
 	if(args.size()!=1)
@@ -42,9 +68,8 @@ Token *WorkflowXPathFunctions::evqGetJob(XPathEval::func_context context, const
 		throw Exception("evqGetOutput()","Expecting 1 parameter");
 	
 	string job_name = (string)(*args.at(0));
-	DOMNode context_node = *((DOMNode *)context.custom_context);
 	
-	return context.eval->Evaluate("//subjobs/job[@name='"+job_name+"']",context_node);
+	return context.eval->Evaluate("//subjobs/job[@name='"+job_name+"']",context.eval->GetXMLDoc()->getDocumentElement());
 }
 
 Token *WorkflowXPathFunctions::evqGetCurrentJob(XPathEval::func_context context, const vector<Token *> &args)
@@ -52,7 +77,7 @@ Token *WorkflowXPathFunctions::evqGetCurrentJob(XPathEval::func_context context,
 	if(args.size()!=0)
 		throw Exception("evqGetCurrentJob()","Expecting 0 parameters");
 	
-	DOMNode node = *((DOMNode *)context.custom_context);
+	DOMNode node = get_current_job(context,"evqGetCurrentJob()");
 	return new TokenSeq(new TokenNode(node));
 }
 
@@ -61,7 +86,7 @@ Token *WorkflowXPathFunctions::evqGetParentJob(XPathEval::func_context context,
 	if(args.size()>1)
 		throw Exception("evqGetParentJob()","Expecting 0 or 1 parameter");
 	
-	DOMNode node = *((DOMNode *)context.custom_context);
+	DOMNode node = get_parent_job(context,"evqGetParentJob()");
 	if(args.size()==0 || args.at(0)->GetType()==LIT_INT)
 	{
 		int nparents = 0;
@@ -106,7 +131,7 @@ Token *WorkflowXPathFunctions::evqGetOutput(XPathEval::func_context context, con
 	if(context.left_context->items.size()>0)
 		context_node = *context.left_context->items.at(0);
 	else
-		context_node = *((DOMNode *)context.custom_context);
+		context_node = get_parent_job(context,"evqGetOutput()");
 	
 	return context.eval->Evaluate("tasks/task[@path='"+task_path+"' or @name='"+task_path+"']/output",context_node);
 }
@@ -123,7 +148,7 @@ Token *WorkflowXPathFunctions::evqGetInput(XPathEval::func_context context, cons
 	if(context.left_context->items.size()>0)
 		context_node = *context.left_context->items.at(0);
 	else
-		context_node = *((DOMNode *)context.custom_context);
+		context_node = get_parent_job(context,"evqGetInput()");
 	
 	return context.eval->Evaluate("tasks/task[@path='"+task_path+"']/input[@name='"+input_name+"']",context_node);
 }
@@ -137,7 +162,7 @@ Token *WorkflowXPathFunctions::evqGetContext(XPathEval::func_context context, co
 	if(context.left_context->items.size()>0)
 		context_node = *context.left_context->items.at(0);
 	else
-		context_node = *((DOMNode *)context.custom_context);
+		context_node = get_parent_job(context,"evqGetContext()");
 	
 	Token *ret = context.eval->Evaluate("@context-id",context_node);
 	string context_id = (string)(*ret);
@@ -151,13 +176,13 @@ Token *WorkflowXPathFunctions::evqWait(XPathEval::func_context context, const ve
 	if(args.size()!=1)
 		throw Exception("evqWait()","Expecting 1 parameter");
 	
-	bool *needs_wait = (bool *)context.custom_context;
+	workflow_context *wf_context = get_workflow_context(context,"evqWait()");
 	if((bool)(*args.at(0)))
 	{
-		*needs_wait = false;
+		wf_context->needs_wait = false;
 		return new TokenBool(true);
 	}
 	
-	*needs_wait = true;
+	wf_context->needs_wait = true;
 	throw Exception("evqWait()","Waiting for condition to become true");
 }
@@ -0,0 +1,146 @@
+/*
+ * This file is part of evQueue
+ * 
+ * evQueue is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * evQueue is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with evQueue. If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Author: Thibault Kummer <bob@coldsource.net>
+ */
+
+
+#include <XPath/XPathArena.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <new>
+
+using namespace std;
+
+// Each allocation is prefixed by a header telling whether it comes from the arena or from the heap
+#define XPATHARENA_HEADER_SIZE 16
+#define XPATHARENA_HEAP 0
+#define XPATHARENA_ARENA 1
+
+thread_local XPathArena *XPathArena::active = 0;
+
+XPathArena::~XPathArena()
+{
+	for(size_t i=0;i<blocks.size();i++)
+		free(blocks[i].data);
+}
+
+void *XPathArena::allocate(size_t size)
+{
+	size = (size+XPATHARENA_HEADER_SIZE-1) & ~(size_t)(XPATHARENA_HEADER_SIZE-1);
+	
+	if(blocks.size()==0 || current_offset+size>blocks[current_block].size)
+	{
+		// Move to next block, reuse it if it is big enough
+		if(blocks.size()>0)
+			current_block++;
+		
+		if(current_block>=blocks.size() || blocks[current_block].size<size)
+		{
+			size_t block_size = size>XPATHARENA_BLOCK_SIZE?size:XPATHARENA_BLOCK_SIZE;
+			char *data = (char *)malloc(block_size);
+			if(!data)
+				throw bad_alloc();
+			
+			blocks.insert(blocks.begin()+current_block,{data,block_size});
+		}
+		
+		current_offset = 0;
+	}
+	
+	void *ptr = blocks[current_block].data+current_offset;
+	current_offset += size;
+	return ptr;
+}
+
+void XPathArena::release(size_t block, size_t offset)
+{
+	current_block = block;
+	current_offset = offset;
+	
+	if(depth==0 && blocks.size()>1)
+	{
+		// Outermost scope has ended, only keep first block
+		for(size_t i=1;i<blocks.size();i++)
+			free(blocks[i].data);
+		blocks.resize(1);
+		
+		current_block = 0;
+		current_offset = 0;
+	}
+}
+
+XPathArena::Scope::Scope(XPathArena *arena)
+{
+	this->arena = arena;
+	previous = active;
+	block = arena->current_block;
+	offset = arena->current_offset;
+	
+	arena->depth++;
+	active = arena;
+}
+
+XPathArena::Scope::~Scope()
+{
+	arena->depth--;
+	arena->release(block,offset);
+	
+	active = previous;
+}
+
+XPathArena::Suspend::Suspend()
+{
+	previous = active;
+	active = 0;
+}
+
+XPathArena::Suspend::~Suspend()
+{
+	active = previous;
+}
+
+void *XPathArena::Allocate(size_t size)
+{
+	char *ptr;
+	if(active)
+	{
+		ptr = (char *)active->allocate(size+XPATHARENA_HEADER_SIZE);
+		*(uint64_t *)ptr = XPATHARENA_ARENA;
+	}
+	else
+	{
+		ptr = (char *)malloc(size+XPATHARENA_HEADER_SIZE);
+		if(!ptr)
+			throw bad_alloc();
+		*(uint64_t *)ptr = XPATHARENA_HEAP;
+	}
+	
+	return ptr+XPATHARENA_HEADER_SIZE;
+}
+
+void XPathArena::Free(void *ptr)
+{
+	if(!ptr)
+		return;
+	
+	char *block = (char *)ptr-XPATHARENA_HEADER_SIZE;
+	if(*(uint64_t *)block==XPATHARENA_HEAP)
+		free(block);
+	
+	// Arena allocations are reclaimed when the scope ends
+}
@@ -22,15 +22,33 @@
 #include <XPath/XPathParser.h>
 #include <XPath/XPathOperators.h>
 #include <XPath/XPathFunctions.h>
+#include <XPath/WorkflowXPathFunctions.h>
 #include <DOM/DOMDocument.h>
 #include <DOM/DOMNamedNodeMap.h>
 #include <DOM/DOMNode.h>
 #include <Exception/Exception.h>
 
 #include <memory>
+#include <map>
+#include <set>
+#include <algorithm>
 
 using namespace std;
 
+// Order nodes as get_child_nodes() returns them : document order, descendants before their ancestors
+// Keys are positions among siblings from the document down to the node, they are computed once per node before sorting
+static bool node_before(const vector<size_t> &key_a,const vector<size_t> &key_b)
+{
+	size_t len = min(key_a.size(),key_b.size());
+	for(size_t i=0;i<len;i++)
+	{
+		if(key_a[i]!=key_b[i])
+			return key_a[i]<key_b[i];
+	}
+	
+	return key_a.size()>key_b.size(); // b is an ancestor of a
+}
+
 // Return child nodes of context node
 TokenSeq *XPathEval::get_child_nodes(const string &name,const eval_context &context,TokenSeq *node_list,bool depth)
 {
@@ -70,6 +88,117 @@ TokenSeq *XPathEval::get_child_nodes(const string &name,const eval_context &cont
 	return node_list;
 }
 
+// Use document indexes to select nodes matching name[@attr='value' and ...]
+// The filter is still applied on returned nodes, so this only needs to be a superset of the result
+bool XPathEval::get_indexed_nodes(const string &name,TokenFilter *filter,const eval_context &context,TokenSeq *node_list,bool depth)
+{
+	if(name=="." || name==".." || name=="*")
+		return false;
+	
+	// Filter must be a conjunction of attribute equalities
+	const vector<Token *> &tokens = filter->filter->expr_tokens;
+	vector<DOMElement> candidates;
+	bool indexed = false;
+	for(size_t i=0;i<tokens.size();i+=4)
+	{
+		if(i+2>=tokens.size())
+			return false;
+		
+		if(i+3<tokens.size() && (tokens.at(i+3)->GetType()!=OP || ((TokenOP *)tokens.at(i+3))->op!=AND))
+			return false;
+		
+		if(tokens.at(i+1)->GetType()!=OP || ((TokenOP *)tokens.at(i+1))->op!=EQ)
+			return false;
+		
+		Token *left = tokens.at(i), *right = tokens.at(i+2);
+		if(left->GetType()==LIT_STR)
+			swap(left,right);
+		
+		if(left->GetType()!=ATTRNAME || right->GetType()!=LIT_STR)
+			return false;
+		
+		// Keep the most selective index
+		vector<DOMElement> values;
+		if(!xmldoc->LookupIndex(name,((TokenAttrName *)left)->name,((TokenString *)right)->s,values))
+			continue;
+		
+		if(!indexed || values.size()<candidates.size())
+			candidates = values;
+		indexed = true;
+	}
+	
+	if(!indexed)
+		return false;
+	
+	// Context nodes must belong to the indexed document
+	vector<DOMNode> context_nodes;
+	for(size_t i=0;i<context->items.size();i++)
+	{
+		DOMNode node = *context->items.at(i);
+		
+		DOMNode root = node;
+		while(root.getParentNode())
+			root = root.getParentNode();
+		
+		if(!root.isSameNode(*xmldoc))
+			return false;
+		
+		context_nodes.push_back(node);
+	}
+	
+	// Keep children (or descendants) of context nodes
+	vector<DOMNode> nodes;
+	for(size_t i=0;i<candidates.size();i++)
+	{
+		bool found = false;
+		DOMNode parent = candidates.at(i).getParentNode();
+		while(parent && !found)
+		{
+			for(size_t j=0;j<context_nodes.size() && !found;j++)
+				found = parent.isSameNode(context_nodes.at(j));
+			
+			if(!depth)
+				break;
+			
+			parent = parent.getParentNode();
+		}
+		
+		if(found)
+			nodes.push_back(candidates.at(i));
+	}
+	
+	// Children of each parent are numbered once, so many candidates under the same parent stay cheap to order
+	map<DOMNode,size_t> positions;
+	set<DOMNode> numbered;
+	vector<vector<size_t>> keys(nodes.size());
+	vector<size_t> order(nodes.size());
+	for(size_t i=0;i<nodes.size();i++)
+	{
+		for(DOMNode node=nodes.at(i);node.getParentNode();node=node.getParentNode())
+		{
+			DOMNode parent = node.getParentNode();
+			if(numbered.insert(parent).second)
+			{
+				size_t position = 0;
+				for(DOMNode child=parent.getFirstChild();child;child=child.getNextSibling())
+					positions[child] = position++;
+			}
+			
+			keys[i].push_back(positions[node]);
+		}
+		
+		reverse(keys[i].begin(),keys[i].end());
+		order[i] = i;
+	}
+	
+	sort(order.begin(),order.end(),[&keys](size_t a,size_t b) { return node_before(keys[a],keys[b]); });
+	
+	for(size_t i=0;i<order.size();i++)
+		node_list->items.push_back(new TokenNode(nodes.at(order[i])));
+	
+	return true;
+}
+
 // Return attributes of context node
 TokenSeq *XPathEval::get_child_attributes(const string &name,const eval_context &context,TokenSeq *node_list,bool depth)
 {
@@ -208,12 +337,13 @@ void XPathEval::get_nth_token_node_list(TokenSeq *list,int n)
 
 Token *XPathEval::evaluate_func(const std::vector<Token *> &expr_tokens, int i,const eval_context &current_context,TokenSeq *left_context)
 {
-	// Lookup funcion name
+	// Function has been resolved by the parser
 	TokenFunc *func = (TokenFunc *)expr_tokens.at(i);
-	auto it = funcs_desc.find(func->name);
-	if(it==funcs_desc.end())
+	if(func->id<0)
 		throw Exception("XPath Eval","Unknown function : "+func->name+func->LogInitialPosition());
 	
+	const func_desc &desc = get_functions().at(func->id);
+	
 	Token *ret;
 	vector<Token *>args;
 	try
@@ -226,7 +356,7 @@ Token *XPathEval::evaluate_func(const std::vector<Token *> &expr_tokens, int i,c
 		}
 		
 		// Call function implementation
-		ret = it->second.impl({current_context,left_context,it->second.custom_context,this},args);
+		ret = desc.impl({current_context,left_context,current_node,custom_context,this},args);
 		
 		for(int j=0;j<args.size();j++)
 			delete args.at(j);
@@ -254,6 +384,13 @@ Token *XPathEval::evaluate_node(const std::vector<Token *> &expr_tokens, int i,c
 	
 	try
 	{
+		// Node followed by a filter might be answered by an index
+		if(i+1<expr_tokens.size() && expr_tokens.at(i+1)->GetType()==FILTER)
+		{
+			if(get_indexed_nodes(node_name->name,(TokenFilter *)expr_tokens.at(i+1),context,ret,depth))
+				return ret;
+		}
+		
 		return get_child_nodes(node_name->name,context,ret,depth);
 	}
 	catch(Exception &e)
@@ -505,6 +642,8 @@ Token *XPathEval::evaluate_expr(Token *token,const eval_context &context)
 XPathEval::XPathEval(DOMDocument *xmldoc)
 {
 	this->xmldoc = xmldoc;
+	custom_context = 0;
+	current_node = 0;
 	
 	// Initialize operators
 	ops_desc.insert(ops_desc.begin()+OPERATOR::MULT,{0,XPathOperators::Operator_MULT});
@@ -521,52 +660,114 @@ XPathEval::XPathEval(DOMDocument *xmldoc)
 	ops_desc.insert(ops_desc.begin()+OPERATOR::AND,{4,XPathOperators::Operator_AND});
 	ops_desc.insert(ops_desc.begin()+OPERATOR::OR,{5,XPathOperators::Operator_OR});
 	ops_desc.insert(ops_desc.begin()+OPERATOR::PIPE,{5,XPathOperators::Operator_PIPE});
+}
+
+const vector<XPathEval::func_desc> &XPathEval::get_functions()
+{
+	// Built once and never modified, so it can be shared by all evaluators without locking
+	static const vector<func_desc> functions = {
+		{"true",XPathFunctions::fntrue},
+		{"false",XPathFunctions::fnfalse},
+		{"not",XPathFunctions::fnnot},
+		{"name",XPathFunctions::name},
+		{"count",XPathFunctions::count},
+		{"min",XPathFunctions::min},
+		{"max",XPathFunctions::max},
+		{"position",XPathFunctions::position},
+		{"last",XPathFunctions::last},
+		{"string-length",XPathFunctions::string_length},
+		{"substring",XPathFunctions::substring},
+		{"contains",XPathFunctions::contains},
+		{"string-join",XPathFunctions::string_join},
+		{"current",XPathFunctions::current},
+		
+		// Workflow functions, they rely on the custom context set by the workflow instance
+		{"evqGetWorkflowParameter",WorkflowXPathFunctions::evqGetWorkflowParameter},
+		{"evqGetJob",WorkflowXPathFunctions::evqGetJob},
+		{"evqGetCurrentJob",WorkflowXPathFunctions::evqGetCurrentJob},
+		{"evqGetParentJob",WorkflowXPathFunctions::evqGetParentJob},
+		{"evqGetOutput",WorkflowXPathFunctions::evqGetOutput},
+		{"evqGetInput",WorkflowXPathFunctions::evqGetInput},
+		{"evqGetContext",WorkflowXPathFunctions::evqGetContext},
+		{"evqWait",WorkflowXPathFunctions::evqWait}
+	};
 	
-	// Initialize functions
-	funcs_desc.insert(pair<string,func_desc>("true",{XPathFunctions::fntrue,0}));
-	funcs_desc.insert(pair<string,func_desc>("false",{XPathFunctions::fnfalse,0}));
-	funcs_desc.insert(pair<string,func_desc>("not",{XPathFunctions::fnnot,0}));
-	funcs_desc.insert(pair<string,func_desc>("name",{XPathFunctions::name,0}));
-	funcs_desc.insert(pair<string,func_desc>("count",{XPathFunctions::count,0}));
-	funcs_desc.insert(pair<string,func_desc>("min",{XPathFunctions::min,0}));
-	funcs_desc.insert(pair<string,func_desc>("max",{XPathFunctions::max,0}));
-	funcs_desc.insert(pair<string,func_desc>("position",{XPathFunctions::position,0}));
-	funcs_desc.insert(pair<string,func_desc>("last",{XPathFunctions::last,0}));
-	funcs_desc.insert(pair<string,func_desc>("string-length",{XPathFunctions::string_length,0}));
-	funcs_desc.insert(pair<string,func_desc>("substring",{XPathFunctions::substring,0}));
-	funcs_desc.insert(pair<string,func_desc>("contains",{XPathFunctions::contains,0}));
-	funcs_desc.insert(pair<string,func_desc>("string-join",{XPathFunctions::string_join,0}));
+	return functions;
 }
 
-void XPathEval::RegisterFunction(string name,func_desc f)
+int XPathEval::LookupFunction(const string &name)
 {
-	funcs_desc.erase(name);
-	funcs_desc.insert(pair<string,func_desc>(name,f));
+	const vector<func_desc> &functions = get_functions();
+	for(int i=0;i<functions.size();i++)
+		if(functions.at(i).name==name)
+			return i;
+	
+	return -1;
 }
 
-Token *XPathEval::Evaluate(const string &xpath,DOMNode context)
+// Evaluate a parsed expression, which is consumed. Must be called within an arena scope
+Token *XPathEval::evaluate(TokenExpr *parsed_expr,DOMNode context)
 {
 	unique_ptr<TokenSeq> current_context_seq(new TokenSeq(new TokenNode(context)));
 	eval_context current_context(current_context_seq.get());
-	RegisterFunction("current",{XPathFunctions::current,current_context_seq.get()});
 	
-	XPathParser parser;
-	TokenExpr *parsed_expr = 0;
+	// Functions may evaluate nested expressions, current() must be restored when they return
+	const TokenSeq *parent_current_node = current_node;
+	current_node = current_context_seq.get();
+	
 	try
 	{
-		parsed_expr = parser.Parse(xpath);
-		return evaluate_expr(parsed_expr,current_context);
+		Token *result = evaluate_expr(parsed_expr,current_context);
+		current_node = parent_current_node;
+		
+		// Result is returned to the caller, so it must be copied outside the arena
+		Token *ret;
+		{
+			XPathArena::Suspend suspend;
+			ret = result->clone();
+		}
+		
+		delete result;
+		return ret;
 	}
 	catch(Exception &e)
 	{
-		if(parsed_expr)
-			delete parsed_expr;
+		current_node = parent_current_node;
+		delete parsed_expr;
 		throw e;
 	}
 }
 
+Token *XPathEval::Evaluate(const string &xpath,DOMNode context)
+{
+	// Intermediate tokens live in the arena, they are released when the scope ends
+	XPathArena::Scope scope(&arena);
+	
+	XPathParser parser;
+	return evaluate(parser.Parse(xpath),context);
+}
+
+Token *XPathEval::Evaluate(const TokenExpr *expr,DOMNode context)
+{
+	XPathArena::Scope scope(&arena);
+	
+	// Evaluation consumes the expression, so work on a copy
+	return evaluate(new TokenExpr(*expr),context);
+}
+
+TokenExpr *XPathEval::Compile(const string &xpath)
+{
+	// Compiled expressions outlive evaluations, so they are allocated on the heap
+	XPathArena::Suspend suspend;
+	
+	XPathParser parser;
+	return parser.Parse(xpath);
+}
+
 void XPathEval::Parse(const std::string &xpath)
 {
+	XPathArena::Scope scope(&arena);
+	
 	XPathParser parser;
 	TokenExpr *parsed_expr = 0;
 	try
@@ -208,5 +208,5 @@ Token *XPathFunctions::current(XPathEval::func_context context, const vector<Tok
 	if(args.size()!=0)
 		throw Exception("current()","Expecting no parameters");
 	
-	return new TokenSeq(*((TokenSeq *)context.custom_context));
+	return new TokenSeq(*context.current_node);
 }
\ No newline at end of file
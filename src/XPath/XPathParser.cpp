@@ -19,6 +19,7 @@
 
 #include <XPath/XPathParser.h>
 #include <XPath/XPathTokens.h>
+#include <XPath/XPathEval.h>
 #include <Exception/Exception.h>
 #include <DOM/DOMNode.h>
 
@@ -262,7 +263,7 @@ Token *XPathParser::parse_token(const string &s, int *pos)
 	else if(is_axis)
 		return (new TokenAxis(buf,buf2))->SetInitialPosition(base_pos);
 	else if(s[i]=='(')
-		return (new TokenFunc(buf))->SetInitialPosition(base_pos);
+		return (new TokenFunc(buf,XPathEval::LookupFunction(buf)))->SetInitialPosition(base_pos);
 	else
 		return (new TokenNodeName(buf))->SetInitialPosition(base_pos);
 }
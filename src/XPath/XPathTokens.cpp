@@ -245,7 +245,7 @@ TokenAxis::TokenAxis(const TokenAxis &axis):Token(axis)
 
 TokenFilter::TokenFilter(const TokenFilter &tf):Token(tf)
 {
-	if(filter)
+	if(tf.filter)
 		filter = new TokenExpr(*(tf.filter));
 	else
 		filter = 0;
@@ -260,6 +260,7 @@ TokenFilter::~TokenFilter()
 TokenFunc::TokenFunc(const TokenFunc &f):Token(f)
 {
 	name = f.name;
+	id = f.id;
 	for(int i=0;i<f.args.size();i++)
 		args.push_back(new TokenExpr(*f.args.at(i)));
 }
@@ -31,6 +31,7 @@
 #include <Configuration/Configuration.h>
 #include <Exception/Exception.h>
 #include <Process/ProcessExec.h>
+#include <Process/AgentProtocol.h>
 
 #include <map>
 #include <string>
@@ -98,6 +99,25 @@ int main(int argc,char ** argv)
 		else if(pid==0)
 			throw Exception("evqueue_agent","Unable to execute command '"+string(argv[1])+"', execv() returned error");
 		
+		// Monitors supporting the binary protocol request it, older ones get the legacy ASCII format
+		int version = 1;
+		if(config_map.count("agent.protocol") && atoi(config_map["agent.protocol"].c_str())>=AGENT_PROTOCOL_VERSION)
+			version = AGENT_PROTOCOL_VERSION;
+		
+		AgentProtocolWriter writer(STDOUT_FILENO, version);
+		
+		if(version>=AGENT_PROTOCOL_VERSION && config_map.count("agent.compress") && config->GetBool("agent.compress"))
+		{
+			writer.EnableCompression(STDOUT_FILENO);
+			writer.EnableCompression(STDERR_FILENO);
+		}
+		
+		AgentProtocolWriter::GrowPipe(STDOUT_FILENO);
+		for(int i=0;i<MAXFD_FORWARD;i++)
+			AgentProtocolWriter::GrowPipe(fd_pipe[i]);
+		
+		writer.Handshake();
+		
 		fd_set rfds;
 		
 		// Multiplex Data to stdout
@@ -126,25 +146,15 @@ int main(int argc,char ** argv)
 			if(re<=0)
 				break;
 			
-			char buf[4096];
-			int read_size;
-			int read_pipe_index = -1;
-			
 			for(int i=0;i<MAXFD_FORWARD;i++)
 			{
 				if(fd_pipe[i]!=-1 && FD_ISSET(fd_pipe[i], &rfds))
 				{
-					read_size = read(fd_pipe[i],buf,4096);
-					if(read_size==0)
+					if(!writer.Forward(STDOUT_FILENO+i,fd_pipe[i]))
 					{
 						close(fd_pipe[i]);
 						fd_pipe[i] = -1;
-						continue;
 					}
-					
-					printf("%02d%09d",STDOUT_FILENO+i,read_size);
-					fwrite(buf,1,read_size,stdout);
-					fflush(stdout);
 				}
 			}
 		}